@@ -0,0 +1,279 @@
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mh/3d/mesh.h"
+#include "mh/base/parallel.h"
+#include "mh/io/io.h"
+#include "mh/util/bvh.h"
+#include "mh/util/flat_bvh.h"
+
+using namespace mh;
+
+// Compares the FlatBVH builders and constructBVHFromMesh on the meshes
+// given as OBJ files, or on a generated one: build time, SAH cost and
+// throughput of collision queries with small triangles placed near the
+// surface and of rays cast at it from all around. Files with several meshes also time building one hierarchy per
+// mesh, one after the other and as a batch. OMP_NUM_THREADS sets the
+// number of threads to build with.
+//
+//   bvhbench [mesh.obj ...]
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Height field whose samples crowd into one corner, like a scan with one
+// closely captured detail: triangles there are orders of magnitude smaller.
+std::vector<Eigen::Vector3f> unevenSurface(int n)
+{
+    std::vector<Eigen::Vector3f> grid((n + 1) * (n + 1));
+    for (int y = 0; y <= n; ++y)
+    {
+        for (int x = 0; x <= n; ++x)
+        {
+            float u = std::pow(static_cast<float>(x) / n, 3.0f);
+            float v = std::pow(static_cast<float>(y) / n, 3.0f);
+            grid[y * (n + 1) + x] = Eigen::Vector3f(u, v, 0.05f * std::sin(20.0f * u) * std::cos(20.0f * v));
+        }
+    }
+
+    std::vector<Eigen::Vector3f> corners;
+    corners.reserve(6 * n * n);
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            const Eigen::Vector3f & a = grid[y * (n + 1) + x];
+            const Eigen::Vector3f & b = grid[y * (n + 1) + x + 1];
+            const Eigen::Vector3f & c = grid[(y + 1) * (n + 1) + x];
+            const Eigen::Vector3f & d = grid[(y + 1) * (n + 1) + x + 1];
+
+            corners.insert(corners.end(), { a, b, d, a, d, c });
+        }
+    }
+
+    return corners;
+}
+
+// one vertex per corner, enough for constructBVHFromMesh
+std::shared_ptr<Mesh> meshFromCorners(const std::vector<Eigen::Vector3f> & corners)
+{
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    mesh->reserve(corners.size(), corners.size() / 3);
+
+    for (size_t i = 0; i + 2 < corners.size(); i += 3)
+    {
+        Vertex * a = mesh->addVertex(corners[i + 0], static_cast<int>(i + 0));
+        Vertex * b = mesh->addVertex(corners[i + 1], static_cast<int>(i + 1));
+        Vertex * c = mesh->addVertex(corners[i + 2], static_cast<int>(i + 2));
+        mesh->addFace(a, b, c, static_cast<int>(i / 3));
+    }
+
+    return mesh;
+}
+
+void benchmark(const std::string & name, const std::vector<Eigen::Vector3f> & corners)
+{
+    const size_t nTriangles = corners.size() / 3;
+    printf("%s: %zu triangles\n", name.c_str(), nTriangles);
+    if (nTriangles == 0) return;
+
+    // probes: a small triangle centered on random triangles of the mesh,
+    // moved a little off the surface
+    const int nQueries = 100000;
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<size_t> pick(0, nTriangles - 1);
+    std::normal_distribution<float>       jitter(0.0f, 1.0f);
+
+    FlatBVH reference;
+    reference.build(corners);
+    const float probeSize = 0.002f * (reference.getMax() - reference.getMin()).norm();
+
+    FlatBVH probe;
+    probe.build({ Eigen::Vector3f(-probeSize, -probeSize, 0.0f),
+                  Eigen::Vector3f( probeSize, -probeSize, 0.0f),
+                  Eigen::Vector3f( 0.0f,       probeSize, probeSize) });
+
+    std::vector<Eigen::Affine3f> placements(nQueries);
+    for (Eigen::Affine3f & placement : placements)
+    {
+        const Eigen::Vector3f * t      = &corners[3 * pick(rng)];
+        const Eigen::Vector3f   center = (t[0] + t[1] + t[2]) / 3.0f;
+        const Eigen::Vector3f   offset = probeSize * Eigen::Vector3f(jitter(rng), jitter(rng), jitter(rng));
+
+        placement = Eigen::Translation3f(center + offset) *
+                    Eigen::AngleAxisf(jitter(rng), Eigen::Vector3f(jitter(rng), jitter(rng), jitter(rng)).normalized());
+    }
+
+    // rays from random points around the mesh to random triangles, cast
+    // on all threads
+    const int nRays = 200000;
+
+    const Eigen::Vector3f center = (reference.getMin() + reference.getMax()) / 2.0f;
+    const float           radius = (reference.getMax() - reference.getMin()).norm();
+
+    std::vector<Ray> rays(nRays);
+    for (Ray & ray : rays)
+    {
+        const Eigen::Vector3f * t      = &corners[3 * pick(rng)];
+        const Eigen::Vector3f   origin = center + radius * Eigen::Vector3f(jitter(rng), jitter(rng), jitter(rng)).normalized();
+
+        ray = Ray(origin, (t[0] + t[1] + t[2]) / 3.0f - origin);
+    }
+
+    printf("  %-13s %12s %10s %10s %14s %8s %14s %14s\n", "builder", "build (ms)", "nodes", "SAH cost", "queries/s", "hits",
+           "closest Mray/s", "any Mray/s");
+
+    struct Builder
+    {
+        const char *   name;
+        BVHBuildMethod method;
+        bool           treelets;
+    };
+
+    const Builder builders[] =
+    {
+        { "median",        BVHBuildMethod::MEDIAN, false },
+        { "SAH",           BVHBuildMethod::SAH,    false },
+        { "LBVH",          BVHBuildMethod::LBVH,   false },
+        { "LBVH+treelets", BVHBuildMethod::LBVH,   true  }
+    };
+
+    for (const Builder & builder : builders)
+    {
+        FlatBVH bvh;
+        bvh.setBuildMethod(builder.method);
+        bvh.setTreelets(builder.treelets);
+
+        double buildTime = std::numeric_limits<double>::max();
+        for (int run = 0; run < 3; ++run)
+        {
+            Clock::time_point start = Clock::now();
+            bvh.build(corners);
+            buildTime = std::min(buildTime, millisecondsSince(start));
+        }
+
+        size_t hits      = 0;
+        double queryTime = std::numeric_limits<double>::max();
+        for (int run = 0; run < 3; ++run)
+        {
+            hits = 0;
+
+            Clock::time_point start = Clock::now();
+            for (const Eigen::Affine3f & placement : placements)
+            {
+                hits += intersect_bvh(bvh, probe, Eigen::Affine3f::Identity(), placement);
+            }
+            queryTime = std::min(queryTime, millisecondsSince(start));
+        }
+
+        std::vector<Intersection<const Face> > closest;
+        std::vector<uint8_t>                   any;
+
+        double closestTime = std::numeric_limits<double>::max();
+        double anyTime     = std::numeric_limits<double>::max();
+        for (int run = 0; run < 3; ++run)
+        {
+            Clock::time_point start = Clock::now();
+            closestHit(bvh, rays, closest);
+            closestTime = std::min(closestTime, millisecondsSince(start));
+
+            start = Clock::now();
+            anyHit(bvh, rays, any);
+            anyTime = std::min(anyTime, millisecondsSince(start));
+        }
+
+        printf("  %-13s %12.1f %10zu %10.2f %14.0f %8zu %14.2f %14.2f\n", builder.name,
+               buildTime, bvh.getNodes().size(), bvh.sahCost(), nQueries / (queryTime / 1000.0), hits,
+               nRays / (closestTime * 1000.0), nRays / (anyTime * 1000.0));
+    }
+
+    // the pointer based hierarchy, one node per face and one per split
+    std::shared_ptr<Mesh> mesh      = meshFromCorners(corners);
+    std::shared_ptr<Mesh> probeMesh = meshFromCorners({ probe.getTriangle(0)[0], probe.getTriangle(0)[1], probe.getTriangle(0)[2] });
+
+    std::unique_ptr<BVH> bvh;
+    double buildTime = std::numeric_limits<double>::max();
+    for (int run = 0; run < 3; ++run)
+    {
+        Clock::time_point start = Clock::now();
+        bvh = constructBVHFromMesh(mesh.get());
+        buildTime = std::min(buildTime, millisecondsSince(start));
+    }
+    std::unique_ptr<BVH> probeBVH = constructBVHFromMesh(probeMesh.get());
+
+    size_t hits = 0;
+    Clock::time_point start = Clock::now();
+    for (const Eigen::Affine3f & placement : placements)
+    {
+        hits += intersect_bvh(bvh.get(), probeBVH.get(), Eigen::Matrix4f::Identity(), placement.matrix());
+    }
+    const double queryTime = millisecondsSince(start);
+
+    printf("  %-13s %12.1f %10zu %10s %14.0f %8zu %14s %14s\n", "BVH", buildTime, 2 * nTriangles - 1, "-",
+           nQueries / (queryTime / 1000.0), hits, "-", "-");
+}
+
+void benchmarkBatch(const std::vector<std::shared_ptr<Mesh> > & meshes)
+{
+    double serialTime = std::numeric_limits<double>::max();
+    double batchTime  = std::numeric_limits<double>::max();
+    for (int run = 0; run < 3; ++run)
+    {
+        Clock::time_point start = Clock::now();
+        std::vector<FlatBVH> bvhs(meshes.size());
+        for (size_t i = 0; i < meshes.size(); ++i) bvhs[i].build(*meshes[i]);
+        serialTime = std::min(serialTime, millisecondsSince(start));
+
+        start = Clock::now();
+        bvhs = buildFlatBVHs(meshes);
+        batchTime = std::min(batchTime, millisecondsSince(start));
+    }
+
+    printf("  %zu meshes: %.1f ms one by one, %.1f ms as a batch\n", meshes.size(), serialTime, batchTime);
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    printf("%d threads\n", maxThreads());
+
+    if (argc < 2)
+    {
+        benchmark("uneven surface", unevenSurface(700));
+        return 0;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::vector<std::shared_ptr<Mesh> > meshes = loadMeshesFromOBJ(argv[i]);
+
+        std::vector<Eigen::Vector3f> corners;
+        for (const std::shared_ptr<Mesh> & mesh : meshes)
+        {
+            const Eigen::Affine3f modelToWorld = transform_to_mtw(mesh->getTransform());
+            for (const auto & face : mesh->getFaces())
+            {
+                for (int c = 0; c < 3; ++c) corners.push_back(modelToWorld * face->getVertex(c)->getPosition());
+            }
+        }
+
+        benchmark(argv[i], corners);
+        if (meshes.size() > 1) benchmarkBatch(meshes);
+    }
+
+    return 0;
+}
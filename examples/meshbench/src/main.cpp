@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "mh/3d/compact_mesh.h"
+#include "mh/3d/mesh.h"
+#include "mh/3d/topology.h"
+#include "mh/io/io.h"
+
+using namespace mh;
+
+// Compares the pointer based Mesh with CompactMesh on the meshes given as
+// OBJ files, or on a generated grid: bytes held per triangle and the time
+// of sweeps over face positions, corner normals and halfedge twins. Reports
+// the best of three runs of ten sweeps each.
+//
+//   meshbench [mesh.obj ...]
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+const int N_SWEEPS = 10;
+const int N_RUNS   = 3;
+
+double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// n x n quads split into two triangles each
+std::shared_ptr<Mesh> gridMesh(int n)
+{
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    mesh->reserve((n + 1) * (n + 1), 2 * n * n);
+
+    for (int y = 0; y <= n; ++y)
+    {
+        for (int x = 0; x <= n; ++x)
+        {
+            mesh->addVertex(Eigen::Vector3f(x, y, 0.1f * ((x * y) % 7)), y * (n + 1) + x);
+        }
+    }
+
+    const auto & verts = mesh->getVerts();
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            Vertex * a = verts[y * (n + 1) + x].get();
+            Vertex * b = verts[y * (n + 1) + x + 1].get();
+            Vertex * c = verts[(y + 1) * (n + 1) + x].get();
+            Vertex * d = verts[(y + 1) * (n + 1) + x + 1].get();
+
+            mesh->addFace(a, b, d, 2 * (y * n + x));
+            mesh->addFace(a, d, c, 2 * (y * n + x) + 1);
+        }
+    }
+
+    recomputeNormalsMesh(*mesh);
+    return mesh;
+}
+
+// best time of N_RUNS runs of sweep, which adds to checksum
+template <class TSweep>
+double bestOf(TSweep sweep, double & checksum)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < N_RUNS; ++run)
+    {
+        Clock::time_point start = Clock::now();
+        for (int s = 0; s < N_SWEEPS; ++s) checksum += sweep();
+        best = std::min(best, millisecondsSince(start));
+    }
+
+    return best;
+}
+
+void benchmark(const std::string & name, Mesh & mesh)
+{
+    printf("%s: %zu vertices, %zu faces\n", name.c_str(), mesh.nVerts(), mesh.nFaces());
+    if (mesh.nFaces() == 0) return;
+
+    finalizeTopology(mesh);
+
+    Clock::time_point start = Clock::now();
+    CompactMesh compact = toCompactMesh(mesh);
+    const double convertTime = millisecondsSince(start);
+
+    const Mesh & constMesh = mesh;
+    double       checksum  = 0.0;
+
+    // twice the area of every face
+    const double meshFaceTime = bestOf([&constMesh]()
+    {
+        double sum = 0.0;
+        for (const auto & face : constMesh.getFaces())
+        {
+            const Eigen::Vector3f & a = face->getVertex<0>()->getPosition();
+            const Eigen::Vector3f & b = face->getVertex<1>()->getPosition();
+            const Eigen::Vector3f & c = face->getVertex<2>()->getPosition();
+            sum += (b - a).cross(c - a).norm();
+        }
+        return sum;
+    }, checksum);
+
+    const double compactFaceTime = bestOf([&compact]()
+    {
+        const std::vector<Eigen::Vector3f> & positions = compact.getPositions();
+
+        double sum = 0.0;
+        for (size_t f = 0; f < compact.nFaces(); ++f)
+        {
+            const Eigen::Vector3f & a = positions[compact.faceVertex(f, 0)];
+            const Eigen::Vector3f & b = positions[compact.faceVertex(f, 1)];
+            const Eigen::Vector3f & c = positions[compact.faceVertex(f, 2)];
+            sum += (b - a).cross(c - a).norm();
+        }
+        return sum;
+    }, checksum);
+
+    const double meshWedgeTime = bestOf([&constMesh]()
+    {
+        double sum = 0.0;
+        for (const auto & face : constMesh.getFaces())
+        {
+            for (const Wedge * wedge : face->getWedges()) sum += wedge->getNormal().z();
+        }
+        return sum;
+    }, checksum);
+
+    const double compactWedgeTime = bestOf([&compact]()
+    {
+        double sum = 0.0;
+        for (const Eigen::Vector3f & normal : compact.getNormals()) sum += normal.z();
+        return sum;
+    }, checksum);
+
+    // boundary halfedges
+    const double meshTwinTime = bestOf([&constMesh]()
+    {
+        double sum = 0.0;
+        for (const auto & he : constMesh.getHalfEdges()) sum += he->getTwin() == nullptr;
+        return sum;
+    }, checksum);
+
+    const double compactTwinTime = bestOf([&compact]()
+    {
+        double sum = 0.0;
+        for (uint32_t twin : compact.getHalfEdgeTwins()) sum += twin == CompactMesh::INVALID_INDEX;
+        return sum;
+    }, checksum);
+
+    const double nFaces = static_cast<double>(mesh.nFaces());
+
+    printf("  converted in %.1f ms, %d sweeps each (checksum %.0f)\n", convertTime, N_SWEEPS, checksum);
+    printf("  %-12s %14s %12s %12s %12s\n", "", "bytes/tri", "faces ms", "wedges ms", "twins ms");
+    printf("  %-12s %14.1f %12.1f %12.1f %12.1f\n", "Mesh",        meshMemoryUsage(mesh) / nFaces,
+           meshFaceTime, meshWedgeTime, meshTwinTime);
+    printf("  %-12s %14.1f %12.1f %12.1f %12.1f\n", "CompactMesh", compact.memoryUsage() / nFaces,
+           compactFaceTime, compactWedgeTime, compactTwinTime);
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        benchmark("grid", *gridMesh(500));
+        return 0;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        for (const std::shared_ptr<Mesh> & mesh : loadMeshesFromOBJ(argv[i]))
+        {
+            benchmark(argv[i], *mesh);
+        }
+    }
+
+    return 0;
+}
@@ -6,6 +6,7 @@
 
 #include "mh/3d/camera.h"
 #include "mh/gui/sceneviewer.h"
+#include "mh/gui/widgets/profiler_widget.h"
 
 namespace mh 
 {
@@ -26,6 +27,8 @@ protected:
 private:
     std::shared_ptr<Camera> m_camera;
 
+    ProfilerWidget          m_profilerWidget;
+
 }; // class MeshViewer
 
 } // namespace mh
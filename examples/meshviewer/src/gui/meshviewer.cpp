@@ -6,6 +6,7 @@
 
 #include "mh/io/meshio.h"
 
+#include "mh/gpu/profiler.h"
 #include "mh/gpu/shader.h"
 
 namespace
@@ -23,9 +24,8 @@ std::shared_ptr<Shader> compileDefaultShader()
          layout(location = 1) in vec3 vertexNormal;
          layout(location = 2) in vec3 vertexColor;
 
-         uniform mat4 cameraToClip;
-         uniform mat4 worldToCamera;
-         uniform mat4 modelToWorld;
+         layout(std140) uniform MhCamera { mat4 worldToCamera; mat4 cameraToClip; };
+         layout(std140) uniform MhModel  { mat4 modelToWorld; vec3 diffuse; float shininess; vec3 specular; };
 
          out vec3 position;
          out vec3 normal;
@@ -101,6 +101,8 @@ int MeshViewer::init(void)
 
 void MeshViewer::mainLoop()
 {
+    Profiler::get_instance().beginFrame();
+
     glfwPollEvents();
 
     ImGui_ImplGlfw_NewFrame();
@@ -131,6 +133,8 @@ void MeshViewer::mainLoop()
         }
     }
 
+    m_profilerWidget.draw();
+
     //// Draw calls
     glViewport(0, 0, m_width, m_height);
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
@@ -147,6 +151,8 @@ void MeshViewer::mainLoop()
 
     glDisable(GL_DEPTH_TEST);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    ProfileScope profile("imgui");
     ImGui::Render();
 }
 
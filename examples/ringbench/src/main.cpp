@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "mh/3d/compact_mesh.h"
+#include "mh/3d/mesh.h"
+#include "mh/3d/neighborhood.h"
+#include "mh/3d/topology.h"
+#include "mh/io/io.h"
+
+using namespace mh;
+
+// Compares one-ring sweeps over all vertices through the halfedge
+// iterators of Mesh and CompactMesh with the adjacency lists built from
+// meshToFVI as std::vector<std::vector<int> >, on the meshes given as OBJ
+// files or on a generated grid. Reports the best of three runs of ten
+// sweeps each, the time to build the adjacency lists and the bytes they
+// hold.
+//
+//   ringbench [mesh.obj ...]
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+const int N_SWEEPS = 10;
+const int N_RUNS   = 3;
+
+double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// n x n quads split into two triangles each
+std::shared_ptr<Mesh> gridMesh(int n)
+{
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    mesh->reserve((n + 1) * (n + 1), 2 * n * n);
+
+    for (int y = 0; y <= n; ++y)
+    {
+        for (int x = 0; x <= n; ++x)
+        {
+            mesh->addVertex(Eigen::Vector3f(x, y, 0.1f * ((x * y) % 7)), y * (n + 1) + x);
+        }
+    }
+
+    const auto & verts = mesh->getVerts();
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            Vertex * a = verts[y * (n + 1) + x].get();
+            Vertex * b = verts[y * (n + 1) + x + 1].get();
+            Vertex * c = verts[(y + 1) * (n + 1) + x].get();
+            Vertex * d = verts[(y + 1) * (n + 1) + x + 1].get();
+
+            mesh->addFace(a, b, d, 2 * (y * n + x));
+            mesh->addFace(a, d, c, 2 * (y * n + x) + 1);
+        }
+    }
+
+    return mesh;
+}
+
+// how adjacency used to be gathered, one list per vertex
+std::vector<std::vector<int> > adjacencyLists(const Mesh & mesh)
+{
+    std::vector<std::vector<int> > adjacency(mesh.nVerts());
+
+    for (const Eigen::Vector3i & face : meshToFVI(mesh))
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            std::vector<int> & list     = adjacency[face(c)];
+            const int          neighbor = face((c + 1) % 3);
+            if (std::find(list.begin(), list.end(), neighbor) == list.end()) list.push_back(neighbor);
+
+            std::vector<int> & back     = adjacency[neighbor];
+            if (std::find(back.begin(), back.end(), face(c)) == back.end()) back.push_back(face(c));
+        }
+    }
+
+    return adjacency;
+}
+
+// best time of N_RUNS runs of sweep, which adds to checksum
+template <class TSweep>
+double bestOf(TSweep sweep, size_t & checksum)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < N_RUNS; ++run)
+    {
+        Clock::time_point start = Clock::now();
+        for (int s = 0; s < N_SWEEPS; ++s) checksum += sweep();
+        best = std::min(best, millisecondsSince(start));
+    }
+
+    return best;
+}
+
+void benchmark(const std::string & name, Mesh & mesh)
+{
+    printf("%s: %zu vertices, %zu faces\n", name.c_str(), mesh.nVerts(), mesh.nFaces());
+    if (mesh.nFaces() == 0) return;
+
+    finalizeTopology(mesh);
+    CompactMesh compact = toCompactMesh(mesh);
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::vector<int> > adjacency = adjacencyLists(mesh);
+    const double adjacencyTime = millisecondsSince(start);
+
+    size_t adjacencyBytes = sizeof(std::vector<int>) * adjacency.capacity();
+    for (const std::vector<int> & list : adjacency) adjacencyBytes += sizeof(int) * list.capacity();
+
+    const Mesh & constMesh = mesh;
+    size_t       checksum  = 0;
+
+    const double meshTime = bestOf([&constMesh]()
+    {
+        size_t sum = 0;
+        for (const auto & v : constMesh.getVerts())
+        {
+            for (const Vertex * neighbor : vertexNeighbors(constMesh, v.get())) sum += neighbor->idx();
+        }
+        return sum;
+    }, checksum);
+
+    const double compactTime = bestOf([&compact]()
+    {
+        size_t sum = 0;
+        for (uint32_t v = 0; v < compact.nVerts(); ++v)
+        {
+            for (uint32_t neighbor : vertexNeighbors(compact, v)) sum += neighbor;
+        }
+        return sum;
+    }, checksum);
+
+    const double adjacencySweepTime = bestOf([&adjacency]()
+    {
+        size_t sum = 0;
+        for (const std::vector<int> & list : adjacency)
+        {
+            for (int neighbor : list) sum += neighbor;
+        }
+        return sum;
+    }, checksum);
+
+    printf("  %d one-ring sweeps (checksum %zu)\n", N_SWEEPS, checksum);
+    printf("  %-22s %8.1f ms\n", "Mesh iterators",        meshTime);
+    printf("  %-22s %8.1f ms\n", "CompactMesh iterators", compactTime);
+    printf("  %-22s %8.1f ms, built in %.1f ms, %.1f MB\n", "adjacency lists", adjacencySweepTime, adjacencyTime,
+           adjacencyBytes / (1024.0 * 1024.0));
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        benchmark("grid", *gridMesh(300));
+        return 0;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        for (const std::shared_ptr<Mesh> & mesh : loadMeshesFromOBJ(argv[i]))
+        {
+            benchmark(argv[i], *mesh);
+        }
+    }
+
+    return 0;
+}
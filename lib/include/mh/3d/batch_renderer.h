@@ -0,0 +1,142 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <memory>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/ext/gl3w/gl3w.h"
+
+#include "mh/gpu/vertex_format.h"
+
+namespace mh
+{
+
+class Mesh;
+class Texture;
+
+// GLSL (430) for vertex shaders drawn by BatchRenderer. Declares the draw
+// ID attribute and the per draw storage buffer and defines modelToWorld,
+// diffuse, shininess and specular as the values of the current draw. A
+// vertex shader written against the uniforms of Scene::draw works once it
+// drops their declarations, its version is 430 and this follows the
+// #version line. Fragment shaders get material values through flat
+// varyings.
+extern const char * const BATCH_GLSL;
+
+// Draws many meshes with few calls. Meshes with the same vertex format and
+// diffuse texture share one vertex and one index buffer (a batch), and
+// every batch goes out with a single glMultiDrawElementsIndirect whose
+// commands select the ranges of its meshes. Transform and material of every
+// mesh are stored in a shader storage buffer, indexed by a per draw
+// attribute sourced through the base instance of the command.
+//
+// The buffers are copies: batches holding a mesh whose glGeneration()
+// changed are rebuilt on the next draw, the meshes' own GL state is not
+// used. Suits many static meshes, such as the per material parts of an OBJ
+// file; positions are stored unquantized.
+class BatchRenderer
+{
+public:
+    static constexpr GLuint DRAW_ID_LOCATION = 7;
+    static constexpr GLuint DRAWS_BINDING    = 2;
+
+    // one element of the MhDraws buffer, std430
+    struct DrawData
+    {
+        Eigen::Matrix4f modelToWorld;
+        Eigen::Vector3f diffuse;
+        float           shininess;
+        Eigen::Vector3f specular;
+        float           padding;
+    }; // struct DrawData
+
+    BatchRenderer();
+    ~BatchRenderer();
+
+    // needs GL 4.3 for indirect multi draws and shader storage buffers;
+    // draw per mesh otherwise, as Scene::draw does
+    static bool isSupported();
+
+    // Draws meshes with the program in use, after bringing the batches up
+    // to date. Meshes with a zero in visible keep their command with an
+    // instance count of 0; only batches whose visibility changed upload
+    // their commands again. The texture of a batch is bound to the active
+    // unit before its draw, when it differs from the one of the previous
+    // batch.
+    void   draw(const std::vector<std::shared_ptr<Mesh> > & meshes, const std::vector<uint8_t> * visible = nullptr);
+
+    // drops all buffers
+    void   clear();
+
+    size_t nBatches() const { return m_batches.size(); }
+    size_t nDraws()   const;
+
+    // of the last draw: batches drawn, texture binds and the texture left
+    // bound (null when nothing was drawn or the last batch is untextured)
+    size_t          nDrawnBatches()   const { return m_nDrawnBatches; }
+    size_t          nTextureChanges() const { return m_nTextureChanges; }
+    const Texture * boundTexture()    const { return m_boundTexture; }
+
+private:
+    BatchRenderer(const BatchRenderer &);
+    void operator=(const BatchRenderer &);
+
+    // what glMultiDrawElementsIndirect reads per draw
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    }; // struct DrawCommand
+
+    struct Batch
+    {
+        bool                hasTexture;
+        // diffuse texture, null without texture coordinates
+        std::shared_ptr<const Texture> texture;
+        VertexFormat        format;
+        // indices into the mesh list
+        std::vector<size_t> meshes;
+
+        GLuint              vaoID;
+        GLuint              vertexVboID;
+        GLuint              faceVboID;
+        GLuint              commandBufferID;
+        GLsizei             nCommands;
+        // as in the command buffer
+        std::vector<DrawCommand> commands;
+    }; // struct Batch
+
+    // regroups all meshes
+    void rebuild(const std::vector<std::shared_ptr<Mesh> > & meshes);
+    void buildBatch(Batch & batch, const std::vector<std::shared_ptr<Mesh> > & meshes);
+    void deleteBatch(Batch & batch);
+
+    void uploadDraws(const std::vector<std::shared_ptr<Mesh> > & meshes);
+    void updateVisibility(Batch & batch, const std::vector<uint8_t> * visible);
+
+    std::vector<Batch>        m_batches;
+
+    // state of the meshes at the last build
+    std::vector<const Mesh *> m_meshes;
+    std::vector<size_t>       m_generations;
+    std::vector<size_t>       m_meshBatches;
+
+    GLuint                    m_drawIDBufferID;
+    GLuint                    m_drawBufferID;
+    std::vector<DrawData>     m_draws;
+
+    size_t                    m_nDrawnBatches;
+    size_t                    m_nTextureChanges;
+    const Texture *           m_boundTexture;
+
+}; // class BatchRenderer
+
+} // namespace mh
+
+#endif /* BATCH_RENDERER_H */
@@ -0,0 +1,47 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <limits>
+#include <memory>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "Eigen/Geometry"
+
+namespace mh
+{
+
+class Vertex;
+
+// Axis-aligned bounding box reductions. An empty input yields the empty box
+// min = +inf, max = -inf, which leaves any box it is merged with unchanged.
+
+// bounds of n packed points; reduced four points per step with SSE and
+// split across threads for large inputs
+void computeBounds(const Eigen::Vector3f * points, size_t n, Eigen::Vector3f & min, Eigen::Vector3f & max);
+
+// bounds of the positions of n vertices
+void computeBounds(const std::shared_ptr<Vertex> * verts, size_t n, Eigen::Vector3f & min, Eigen::Vector3f & max);
+
+inline void setEmptyBounds(Eigen::Vector3f & min, Eigen::Vector3f & max)
+{
+    min.setConstant( std::numeric_limits<float>::infinity());
+    max.setConstant(-std::numeric_limits<float>::infinity());
+}
+
+inline void mergeBounds(const Eigen::Vector3f & otherMin, const Eigen::Vector3f & otherMax,
+                        Eigen::Vector3f & min, Eigen::Vector3f & max)
+{
+    min = min.cwiseMin(otherMin);
+    max = max.cwiseMax(otherMax);
+}
+
+// box around [min, max] after transform (Arvo); empty boxes stay empty
+void transformBounds(const Eigen::Affine3f & transform,
+                     const Eigen::Vector3f & min, const Eigen::Vector3f & max,
+                     Eigen::Vector3f & transformedMin, Eigen::Vector3f & transformedMax);
+
+} // namespace mh
+
+#endif /* BOUNDS_H */
@@ -0,0 +1,144 @@
+#ifndef COMPACT_MESH_H
+#define COMPACT_MESH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/3d/halfedge.h"
+#include "mh/3d/material.h"
+#include "mh/3d/transform.h"
+#include "mh/3d/meshglstate.h"
+
+namespace mh
+{
+
+class Mesh;
+
+// Structure-of-arrays triangle mesh. Vertex attributes live in contiguous
+// per-vertex arrays, wedge attributes (normals, texture coordinates) in
+// per-corner arrays of 3 * nFaces() entries. Topology is a halfedge table
+// indexed with 32-bit integers: halfedge 3 * f + c belongs to face f, points
+// to corner c of that face and starts at corner (c + 2) % 3, which matches
+// the layout the loaders build for Mesh. Face and next/prev links are
+// implicit in the index, so only target vertex and twin are stored.
+//
+// A separate class next to Mesh, not a replacement of its storage: Mesh
+// keeps its shared_ptr elements and the loaders, BVH and GL paths still
+// work on Mesh. Code that wants the compact layout converts with
+// toCompactMesh and back with toMesh.
+class CompactMesh
+{
+public:
+    static constexpr uint32_t INVALID_INDEX = 0xffffffffu;
+
+    CompactMesh(size_t idx=0) : m_idx(idx), m_hasTextureCoords(false) {}
+
+          void                                 setName(std::string name)                  { m_name = std::move(name); }
+    const std::string                        & getName()                            const { return m_name; }
+
+          void                                 reserve(size_t nVerts, size_t nFaces);
+
+          uint32_t                             addVertex(const Eigen::Vector3f & position);
+          uint32_t                             addFace(uint32_t v0, uint32_t v1, uint32_t v2);
+
+          size_t                               nVerts()                             const { return m_positions.size(); }
+          size_t                               nFaces()                             const { return m_heVertex.size() / 3; }
+          size_t                               nHalfEdges()                         const { return m_heVertex.size(); }
+
+    // per-vertex attributes
+    const std::vector<Eigen::Vector3f>       & getPositions()                       const { return m_positions; }
+          std::vector<Eigen::Vector3f>       & getPositions()                             { return m_positions; }
+    const std::vector<Eigen::Vector3f>       & getColors()                          const { return m_colors; }
+          std::vector<Eigen::Vector3f>       & getColors()                                { return m_colors; }
+    const std::vector<int>                   & getCustomInts()                      const { return m_customInts; }
+          std::vector<int>                   & getCustomInts()                            { return m_customInts; }
+    const std::vector<Eigen::Vector3f>       & getCustomVecs()                      const { return m_customVecs; }
+          std::vector<Eigen::Vector3f>       & getCustomVecs()                            { return m_customVecs; }
+    const std::vector<uint32_t>              & getVertexHalfEdges()                 const { return m_vertHalfEdge; }
+          std::vector<uint32_t>              & getVertexHalfEdges()                       { return m_vertHalfEdge; }
+
+    // per-corner (wedge) attributes, indexed by halfedge
+    const std::vector<Eigen::Vector3f>       & getNormals()                         const { return m_normals; }
+          std::vector<Eigen::Vector3f>       & getNormals()                               { return m_normals; }
+    const std::vector<float2>                & getTextureCoords()                   const { return m_textureCoords; }
+          std::vector<float2>                & getTextureCoords()                         { return m_textureCoords; }
+          void                                 setHasTextureCoords(bool has)              { m_hasTextureCoords = has; }
+          bool                                 hasTextureCoords()                   const { return m_hasTextureCoords; }
+
+    // halfedge table
+    const std::vector<uint32_t>              & getHalfEdgeVertices()                const { return m_heVertex; }
+          std::vector<uint32_t>              & getHalfEdgeVertices()                      { return m_heVertex; }
+    const std::vector<uint32_t>              & getHalfEdgeTwins()                   const { return m_heTwin; }
+          std::vector<uint32_t>              & getHalfEdgeTwins()                         { return m_heTwin; }
+    // HalfEdge::Flags per halfedge
+    const std::vector<uint8_t>               & getHalfEdgeFlags()                   const { return m_heFlags; }
+          std::vector<uint8_t>               & getHalfEdgeFlags()                         { return m_heFlags; }
+
+    static uint32_t                            heFace(uint32_t he)                        { return he / 3; }
+    static uint32_t                            heNext(uint32_t he)                        { return (he % 3 == 2) ? he - 2 : he + 1; }
+    static uint32_t                            hePrev(uint32_t he)                        { return (he % 3 == 0) ? he + 2 : he - 1; }
+           uint32_t                            heTarget(uint32_t he)                const { return m_heVertex[he]; }
+           uint32_t                            heSource(uint32_t he)                const { return m_heVertex[hePrev(he)]; }
+           uint32_t                            heTwin(uint32_t he)                  const { return m_heTwin[he]; }
+
+           uint32_t                            faceVertex(size_t face, size_t corner) const { return m_heVertex[3 * face + corner]; }
+
+          void                                 setMaterial(std::shared_ptr<Material> material) { m_material = material; }
+    const std::shared_ptr<Material>          & getMaterial()                        const { return m_material; }
+
+    const Transform                          & getTransform()                       const { return m_transform; }
+          Transform                          & getTransform()                             { return m_transform; }
+
+          void                                 setIdx(size_t idx)                         { m_idx = idx; }
+          size_t                               idx()                                const { return m_idx; }
+
+          // bounding box of the positions, reduced on every call
+          void                                 getBounds(Eigen::Vector3f & min, Eigen::Vector3f & max) const;
+
+          // bytes held by all attribute and topology arrays
+          size_t                               memoryUsage()                        const;
+
+protected:
+
+private:
+    size_t                       m_idx;
+    std::string                  m_name;
+
+    std::vector<Eigen::Vector3f> m_positions;
+    std::vector<Eigen::Vector3f> m_colors;
+    std::vector<int>             m_customInts;
+    std::vector<Eigen::Vector3f> m_customVecs;
+    std::vector<uint32_t>        m_vertHalfEdge; // one outgoing halfedge per vertex
+
+    std::vector<Eigen::Vector3f> m_normals;
+    std::vector<float2>          m_textureCoords;
+    bool                         m_hasTextureCoords;
+
+    std::vector<uint32_t>        m_heVertex;
+    std::vector<uint32_t>        m_heTwin;
+    std::vector<uint8_t>         m_heFlags;
+
+    std::shared_ptr<Material>    m_material;
+    Transform                    m_transform;
+
+}; // class CompactMesh
+
+// conversion between the pointer-based Mesh and the compact layout; vertex
+// order is preserved, so positions in Mesh::getVerts() are compact indices
+// (Vertex::idx() only where the loader numbered vertices by position)
+CompactMesh           toCompactMesh(const Mesh & mesh);
+std::unique_ptr<Mesh> toMesh(const CompactMesh & mesh);
+
+MeshGLData            getMeshGLData(const CompactMesh & mesh);
+
+// approximate heap footprint of the pointer-based layout, including the
+// shared_ptr control blocks and allocator headers of every element
+size_t                meshMemoryUsage(const Mesh & mesh);
+
+} // namespace mh
+
+#endif /* COMPACT_MESH_H */
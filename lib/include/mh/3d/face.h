@@ -1,6 +1,8 @@
 #ifndef FACE_H
 #define FACE_H 
 
+#include <array>
+
 #include "mh/base/defs.h"
 #include "mh/base/imports.h"
 
@@ -16,17 +18,27 @@ class Vertex;
 class Face
 {
 public:
-    Face(int idx) : m_idx(idx) {}
+    Face(int idx) : m_idx(idx), m_halfedge(nullptr), m_verts{{nullptr, nullptr, nullptr}}, m_wedges{{nullptr, nullptr, nullptr}} {}
 
     EXPOSE_PTR(HalfEdge, HalfEdge, m_halfedge)
 
     int                                          idx()                 const { return m_idx; }
 
-    const Vertex * getVertex(size_t idx) const;
-          Vertex * getVertex(size_t idx);
+    // corner i is the target of the i-th halfedge; the vertices are cached
+    // on the face so corner lookups don't chase the halfedge ring
+    const Vertex * getVertex(size_t idx) const { MH_ASSERT(idx < 3); return m_verts[idx]; }
+          Vertex * getVertex(size_t idx)       { MH_ASSERT(idx < 3); return m_verts[idx]; }
+
+    template <size_t I> const Vertex * getVertex() const { static_assert(I < 3, "faces are triangles"); return std::get<I>(m_verts); }
+    template <size_t I>       Vertex * getVertex()       { static_assert(I < 3, "faces are triangles"); return std::get<I>(m_verts); }
+
+    const std::array<Vertex *, 3> & getVertices() const { return m_verts; }
+
+    // must match the halfedge ring; Mesh::addFace takes care of this
+    void setVertices(Vertex * v0, Vertex * v1, Vertex * v2) { m_verts = {{v0, v1, v2}}; }
 
-    const std::vector<Wedge *> & getWedges() const { return m_wedges; }
-          std::vector<Wedge *> & getWedges()       { return m_wedges; }
+    const std::array<Wedge *, 3> & getWedges() const { return m_wedges; }
+          std::array<Wedge *, 3> & getWedges()       { return m_wedges; }
 
     Eigen::Vector3f               getEdge        (size_t idx)          const;
     Eigen::Vector3f               getFaceNormal  (void)                const;
@@ -34,10 +46,11 @@ public:
 protected:
 
 private:
-    int                  m_idx; // index in mesh
+    int                     m_idx; // index in mesh
 
-    HalfEdge *           m_halfedge;
-    std::vector<Wedge *> m_wedges;
+    HalfEdge *              m_halfedge;
+    std::array<Vertex *, 3> m_verts;
+    std::array<Wedge *, 3>  m_wedges;
 
 }; // class Face
 
@@ -0,0 +1,58 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <array>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "Eigen/Geometry"
+
+namespace mh
+{
+
+class Camera;
+
+enum class FrustumTest
+{
+    OUTSIDE,
+    INTERSECTS,
+    INSIDE
+};
+
+// The six planes bounding the volume a clip space transform maps into the
+// view. Tests are conservative: a volume reported outside is invisible,
+// one reported inside may still be invisible near the frustum corners.
+class Frustum
+{
+public:
+    // contains everything
+    Frustum();
+
+    // Planes of clip = cameraToClip * worldToCamera [* modelToWorld],
+    // in the space the matrix starts from.
+    static Frustum fromMatrix(const Eigen::Matrix4f & clip);
+    // world space planes of camera
+    static Frustum fromCamera(const Camera & camera);
+
+    bool intersectsSphere(const Eigen::Vector3f & center, float radius) const;
+    bool intersectsBox   (const Eigen::Vector3f & min, const Eigen::Vector3f & max) const;
+    // INSIDE lets hierarchies skip testing the contents of a box
+    FrustumTest classifyBox(const Eigen::Vector3f & min, const Eigen::Vector3f & max) const;
+
+    // a x + b y + c z + d >= 0 inside, (a, b, c) unit length;
+    // left, right, bottom, top, near, far
+    const Eigen::Vector4f & plane(int i) const { return m_planes[i]; }
+
+private:
+    std::array<Eigen::Vector4f, 6> m_planes;
+
+}; // class Frustum
+
+// bounding sphere of the box [min, max] after transform
+void transformBoundingSphere(const Eigen::Affine3f & transform, const Eigen::Vector3f & min, const Eigen::Vector3f & max,
+                             Eigen::Vector3f & center, float & radius);
+
+} // namespace mh
+
+#endif /* FRUSTUM_H */
@@ -13,13 +13,25 @@ class Vertex;
 class HalfEdge
 {
 public:
-    HalfEdge() {}
+    // edge classification, set by finalizeTopology
+    enum Flags : uint8_t
+    {
+        BOUNDARY     = 1 << 0, // no opposite halfedge
+        NON_MANIFOLD = 1 << 1  // shared by more than two faces or inconsistently oriented
+    };
+
+    HalfEdge() : m_vertex(nullptr), m_face(nullptr), m_next(nullptr), m_twin(nullptr), m_flags(0) {}
 
     EXPOSE_PTR(Vertex,   Vertex, m_vertex);
     EXPOSE_PTR(Face,     Face,   m_face);
     EXPOSE_PTR(HalfEdge, Next,   m_next);
     EXPOSE_PTR(HalfEdge, Twin,   m_twin);
 
+    EXPOSE    (uint8_t,  Flags,  m_flags);
+
+    bool isBoundary    (void) const { return m_flags & BOUNDARY; }
+    bool isNonManifold (void) const { return m_flags & NON_MANIFOLD; }
+
 protected:
 
 private:
@@ -27,6 +39,7 @@ private:
     Face *     m_face;
     HalfEdge * m_next;
     HalfEdge * m_twin;
+    uint8_t    m_flags;
 
 }; // class HalfEdge
 
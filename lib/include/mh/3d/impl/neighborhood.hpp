@@ -0,0 +1,110 @@
+#include <algorithm>
+
+namespace mh
+{
+
+template <class TMeshType>
+IteratorRange<OutgoingHalfEdgeIterator<TMeshType> >
+outgoingHalfEdges(const TMeshType & mesh, typename HalfEdgeTraits<TMeshType>::VertexHandle v)
+{
+    typedef HalfEdgeTraits<TMeshType> Traits;
+    Traits traits(mesh);
+
+    return IteratorRange<OutgoingHalfEdgeIterator<TMeshType> >(
+        OutgoingHalfEdgeIterator<TMeshType>(traits, traits.outgoing(v)),
+        OutgoingHalfEdgeIterator<TMeshType>(traits, Traits::invalidHalfEdge()));
+}
+
+template <class TMeshType>
+IteratorRange<VertexRingIterator<TMeshType> >
+vertexNeighbors(const TMeshType & mesh, typename HalfEdgeTraits<TMeshType>::VertexHandle v)
+{
+    typedef HalfEdgeTraits<TMeshType> Traits;
+    Traits traits(mesh);
+
+    return IteratorRange<VertexRingIterator<TMeshType> >(
+        VertexRingIterator<TMeshType>(traits, traits.outgoing(v)),
+        VertexRingIterator<TMeshType>(traits, Traits::invalidHalfEdge()));
+}
+
+template <class TMeshType>
+IteratorRange<VertexFaceIterator<TMeshType> >
+vertexFaces(const TMeshType & mesh, typename HalfEdgeTraits<TMeshType>::VertexHandle v)
+{
+    typedef HalfEdgeTraits<TMeshType> Traits;
+    Traits traits(mesh);
+
+    return IteratorRange<VertexFaceIterator<TMeshType> >(
+        VertexFaceIterator<TMeshType>(traits, traits.outgoing(v)),
+        VertexFaceIterator<TMeshType>(traits, Traits::invalidHalfEdge()));
+}
+
+template <class TMeshType>
+IteratorRange<FaceNeighborIterator<TMeshType> >
+faceNeighbors(const TMeshType & mesh, typename HalfEdgeTraits<TMeshType>::FaceHandle f)
+{
+    typedef HalfEdgeTraits<TMeshType> Traits;
+    Traits traits(mesh);
+
+    return IteratorRange<FaceNeighborIterator<TMeshType> >(
+        FaceNeighborIterator<TMeshType>(traits, traits.halfEdge(f), 0),
+        FaceNeighborIterator<TMeshType>(traits, traits.halfEdge(f), 3));
+}
+
+template <class TMeshType>
+bool KRing<TMeshType>::visit(VertexHandle v)
+{
+    size_t idx = m_traits.index(v);
+    if (idx >= m_stamps.size())
+    {
+        m_stamps.resize(std::max(idx + 1, 2 * m_stamps.size()), 0);
+    }
+
+    if (m_stamps[idx] == m_stamp)
+    {
+        return false;
+    }
+
+    m_stamps[idx] = m_stamp;
+    m_result.push_back(v);
+
+    return true;
+}
+
+template <class TMeshType>
+const std::vector<typename KRing<TMeshType>::VertexHandle> & KRing<TMeshType>::collect(VertexHandle seed, int k)
+{
+    // a new stamp invalidates all previous marks at once; on wrap-around
+    // the buffer has to be cleared for real
+    if (++m_stamp == 0)
+    {
+        std::fill(m_stamps.begin(), m_stamps.end(), 0);
+        m_stamp = 1;
+    }
+
+    m_result.clear();
+    visit(seed);
+
+    size_t ring_begin = 0;
+    for (int ring = 0; ring < k; ++ring)
+    {
+        size_t ring_end = m_result.size();
+        for (size_t i = ring_begin; i < ring_end; ++i)
+        {
+            for (VertexHandle neighbor : vertexNeighbors(m_mesh, m_result[i]))
+            {
+                visit(neighbor);
+            }
+        }
+
+        if (ring_end == m_result.size())
+        {
+            break;
+        }
+        ring_begin = ring_end;
+    }
+
+    return m_result;
+}
+
+} // namespace mh
@@ -1,6 +1,11 @@
 #ifndef INTERSECTION_H
 #define INTERSECTION_H 
 
+#include <limits>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
 namespace mh
 {
 
@@ -11,22 +16,26 @@ public:
     typedef TObjectType ObjectType;
 
     Intersection() 
-        : m_hit(false), m_t(std::numeric_limits<float>::max()), m_object(nullptr) {}
-    Intersection(bool hit, float t, ObjectType * object)
-        : m_hit(hit), m_t(t), m_object(object) {}
+        : m_hit(false), m_t(std::numeric_limits<float>::max()), m_object(nullptr), m_barycentrics(Eigen::Vector3f::Zero()) {}
+    Intersection(bool hit, float t, ObjectType * object, const Eigen::Vector3f & barycentrics=Eigen::Vector3f::Zero())
+        : m_hit(hit), m_t(t), m_object(object), m_barycentrics(barycentrics) {}
 
     operator     bool()      const { return m_hit; }
 
     bool         getHit()    const { return m_hit; }
     float        getT()      const { return m_t; }
-    ObjectType * getObject()       { return m_object; }
-    
+    ObjectType * getObject() const { return m_object; }
+
+    // weights of the three corners of a hit triangle, summing to one
+    const Eigen::Vector3f & getBarycentrics() const { return m_barycentrics; }
+
 protected:
 
 private:
-    bool         m_hit;
-    float        m_t;
-    ObjectType * m_object;
+    bool            m_hit;
+    float           m_t;
+    ObjectType *    m_object;
+    Eigen::Vector3f m_barycentrics;
 
 }; // class Intersection
 
@@ -12,19 +12,36 @@
 #include "mh/3d/halfedge.h"
 #include "mh/3d/wedge.h"
 #include "mh/3d/material.h"
+#include "mh/3d/mesh_changes.h"
 #include "mh/3d/transform.h"
 #include "mh/3d/meshglstate.h"
 #include "mh/3d/pointcloudglstate.h"
 
+#include "mh/util/object_pool.h"
+
 namespace mh
 {
 
 class BVH;
 
+// Backing storage for the topology objects of a mesh. The shared_ptrs handed
+// out by Mesh alias the arena's control block, so elements cost no separate
+// allocation, the arena is freed in one go once the last element reference
+// is gone, and the raw pointers linking elements stay stable.
+struct MeshArena
+{
+    ObjectPool<Vertex>   verts;
+    ObjectPool<Face>     faces;
+    ObjectPool<HalfEdge> halfedges;
+    ObjectPool<Wedge>    wedges;
+}; // struct MeshArena
+
 class Mesh
 {
 public:
-    Mesh(size_t idx=0) : m_idx(idx), m_dirtyGL(true), m_gl_state(*this), m_pointcloud_gl_state(*this) {}
+    Mesh(size_t idx=0)
+        : m_idx(idx), m_arena(std::make_shared<MeshArena>()), m_dirtyBB(true),
+          m_gl_state(*this), m_pointcloud_gl_state(*this) {}
 
     Mesh(const Mesh & mesh);
 
@@ -35,17 +52,32 @@ public:
           std::vector<std::shared_ptr<Vertex> >   & getVerts()               { dirty(); return m_verts; }
 
     const std::vector<std::shared_ptr<Face> >     & getFaces()         const { return m_faces; }
-          std::vector<std::shared_ptr<Face> >     & getFaces()               { dirty(); return m_faces; }
+          std::vector<std::shared_ptr<Face> >     & getFaces()               { dirtyGL(); return m_faces; }
 
     const std::vector<std::shared_ptr<HalfEdge> > & getHalfEdges()     const { return m_halfedges; }
-          std::vector<std::shared_ptr<HalfEdge> > & getHalfEdges()           { dirty(); return m_halfedges; }
+          std::vector<std::shared_ptr<HalfEdge> > & getHalfEdges()           { dirtyGL(); return m_halfedges; }
 
     const std::vector<std::shared_ptr<Wedge> >    & getWedges()        const { return m_wedges; }
-          std::vector<std::shared_ptr<Wedge> >    & getWedges()              { dirty(); return m_wedges; }
+          std::vector<std::shared_ptr<Wedge> >    & getWedges()              { dirtyGL(); return m_wedges; }
+
+          // arena allocation of topology objects
+          std::shared_ptr<Vertex>                   createVertex(const Eigen::Vector3f & position, int idx);
+          std::shared_ptr<Face>                     createFace(int idx);
+          std::shared_ptr<HalfEdge>                 createHalfEdge();
+          std::shared_ptr<Wedge>                    createWedge(Vertex * vertex, Face * face);
+
+          // creates a vertex and appends it to the mesh
+          Vertex *                                  addVertex(const Eigen::Vector3f & position, int idx);
+          // creates a triangle with its three halfedges and wedges and
+          // appends all of them to the mesh
+          Face *                                    addFace(Vertex * v0, Vertex * v1, Vertex * v2, int idx);
+          void                                      reserve(size_t nVerts, size_t nFaces);
+
+    const std::shared_ptr<MeshArena>              & getArena()         const { return m_arena; }
 
           void                                      setMaterial(std::shared_ptr<Material> material) { dirtyGL(); m_material = material; }
     const std::shared_ptr<Material>               & getMaterial()      const { return m_material; }
-          std::shared_ptr<Material>               & getMaterial()            { dirtyGL(); return m_material; }
+          std::shared_ptr<Material>               & getMaterial()            { return m_material; }
 
     const Transform                               & getTransform()     const { return m_transform; }
           Transform                               & getTransform()           { return m_transform; }
@@ -56,7 +88,7 @@ public:
           std::shared_ptr<BVH>                    & getBVH()                 { return m_bvh; }   
 
           // TODO: make this more robust
-          bool                                      hasTextureCoords() const { return m_wedges[0]->hasTextureCoords(); }
+          bool                                      hasTextureCoords() const { return !m_wedges.empty() && m_wedges[0]->hasTextureCoords(); }
         
           size_t                                    nVerts()           const { return m_verts.size(); }
           size_t                                    nFaces()           const { return m_faces.size(); }
@@ -64,16 +96,49 @@ public:
           Eigen::Vector3f                           getMin()           const { updateMinMax(); return m_min; }
           Eigen::Vector3f                           getMax()           const { updateMinMax(); return m_max; }
           Eigen::Vector3f                           getCenter()        const { updateMinMax(); return (m_min + m_max) / 2.0f; }
+
+          // moves a subset of vertices; the bounding box is cached per block
+          // of vertices and only the blocks holding moved vertices are
+          // reduced again, so the box grows and shrinks without a full scan
+          void                                      setVertexPositions(const std::vector<size_t> & indices,
+                                                                       const std::vector<Eigen::Vector3f> & positions);
+
+          // Records attribute changes made through the element pointers, for
+          // vertices (or faces, for wedge attributes) in [begin, end). The
+          // next draw uploads only these ranges, and only position changes
+          // invalidate the bounding box. The non-const container accessors
+          // instead mark everything for a rebuild; getVerts() also drops the
+          // bounds.
+          void                                      markChanged(MeshAttribute attribute, size_t begin, size_t end);
+          void                                      markChanged(MeshAttribute attribute, size_t index) { markChanged(attribute, index, index + 1); }
           
           void                                      setIdx(size_t idx)       { m_idx = idx; }
           size_t                                    idx()              const { return m_idx; }
 
+          // Rebuilds pack and upload the GL buffers in the background and
+          // keep drawing the previous ones until the new ones are complete.
+          // The worker reads the mesh, so every mutator waits for it first;
+          // writes through element pointers obtained earlier have to call
+          // waitGL() themselves.
+          void                                      setAsyncGL(bool async)   { m_gl_state.setAsync(async); m_pointcloud_gl_state.setAsync(async); }
+          void                                      waitGL()           const { m_gl_state.waitForPreparation(); m_pointcloud_gl_state.waitForPreparation(); }
+          // streams the vertices of a mesh animated every frame, see
+          // MeshGLState::setDynamic
+          void                                      setDynamicGL(bool dynamic) { m_gl_state.setDynamic(dynamic); }
+
+          // changes with every modification that reaches the GL state, for
+          // renderers keeping their own copy of the buffers
+          size_t                                    glGeneration()     const { return m_glGeneration; }
+
           void                                      draw()             const { updateGL(); m_gl_state.draw(); }
+          // see MeshGLState::setInstanceBuffer
+          void                                      setInstanceBufferGL(GLuint bufferID, const VertexFormat & format) const { m_gl_state.setInstanceBuffer(bufferID, format); }
+          void                                      drawInstanced(GLsizei nInstances) const { updateGL(); m_gl_state.drawInstanced(nInstances); }
           void                                      draw_cloud()       const { updateGL(); m_pointcloud_gl_state.draw(); }
     
 protected:
     void dirty()   const { dirtyGL(); dirtyBB(); }
-    void dirtyGL() const { m_dirtyGL = true; }
+    void dirtyGL() const { waitGL(); m_glChanges.topology = true; ++m_glGeneration; }
     void dirtyBB() const { m_dirtyBB = true; }
 
     void updateMinMax() const;
@@ -84,6 +149,8 @@ private:
 
     std::string                             m_name;
 
+    std::shared_ptr<MeshArena>              m_arena;
+
     std::vector<std::shared_ptr<Vertex> >   m_verts;
     std::vector<std::shared_ptr<Face> >     m_faces;
     std::vector<std::shared_ptr<HalfEdge> > m_halfedges;
@@ -99,15 +166,30 @@ private:
     mutable bool                            m_dirtyBB;
     mutable Eigen::Vector3f                 m_min;
     mutable Eigen::Vector3f                 m_max;
+    mutable std::vector<Eigen::Vector3f>    m_blockMin;
+    mutable std::vector<Eigen::Vector3f>    m_blockMax;
+    mutable std::vector<size_t>             m_dirtyBlocks;
 
-    mutable bool                            m_dirtyGL;
+    mutable MeshChanges                     m_glChanges;
+    mutable size_t                          m_glGeneration = 0;
     mutable MeshGLState                     m_gl_state;
     mutable PointcloudGLState               m_pointcloud_gl_state;
 
 }; // class Mesh
 
 std::vector<Eigen::Vector3i> meshToFVI(const Mesh & mesh);
+// Index in getVerts() of the vertex at every corner, corner c of face f at
+// 3 * f + c. Unlike Vertex::idx(), which binary files and callers of
+// addVertex may set to anything, these always index getVerts(); per vertex
+// tables are sized nVerts() and keyed with them.
+std::vector<uint32_t> meshCornerVertices(const Mesh & mesh);
 std::unique_ptr<Mesh> getSubMesh(const Mesh & mesh, const std::vector<size_t> & faceIndices);
+
+// Splits mesh into one submesh per face label, in a single pass over the
+// faces; the submeshes are built in parallel. Submesh i holds the faces
+// labelled i in their original order and has idx i. Faces with a negative
+// label are dropped.
+std::vector<std::unique_ptr<Mesh> > splitIntoSubMeshes(const Mesh & mesh, const std::vector<int> & labels);
 void recomputeNormalsMesh(Mesh & mesh);
 
 } // namespace mh
@@ -0,0 +1,74 @@
+#ifndef MESH_CHANGES_H
+#define MESH_CHANGES_H
+
+#include <array>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/util/dirty_ranges.h"
+
+namespace mh
+{
+
+// attributes whose changes are tracked for partial GPU uploads; vertex
+// attributes are indexed by vertex, wedge attributes (normals, texture
+// coordinates) by face
+enum class MeshAttribute
+{
+    POSITION,
+    COLOR,
+    CUSTOM_INT,
+    CUSTOM_VEC,
+    NORMAL,
+    TEXTURE_COORDS,
+    COUNT
+};
+
+// Everything that changed on a mesh since its GL buffers were last synced.
+// Topology changes, and changes that can't be pinned down, force a full
+// rebuild; attribute changes are uploaded range by range.
+struct MeshChanges
+{
+    bool                                                                 topology = true;
+    std::array<DirtyRanges, static_cast<size_t>(MeshAttribute::COUNT)> attributes;
+
+    const DirtyRanges & operator[](MeshAttribute attribute) const { return attributes[static_cast<size_t>(attribute)]; }
+          DirtyRanges & operator[](MeshAttribute attribute)       { return attributes[static_cast<size_t>(attribute)]; }
+
+    bool any() const
+    {
+        if (topology) return true;
+        for (const DirtyRanges & ranges : attributes)
+        {
+            if (!ranges.empty()) return true;
+        }
+        return false;
+    }
+
+    // adds the changes of rhs to these
+    void merge(const MeshChanges & rhs)
+    {
+        topology = topology || rhs.topology;
+        for (size_t i = 0; i < attributes.size(); ++i)
+        {
+            for (const IndexRange & range : rhs.attributes[i].get())
+            {
+                attributes[i].add(range.begin, range.end);
+            }
+        }
+    }
+
+    void clear()
+    {
+        topology = false;
+        for (DirtyRanges & ranges : attributes)
+        {
+            ranges.clear();
+        }
+    }
+}; // struct MeshChanges
+
+} // namespace mh
+
+#endif /* MESH_CHANGES_H */
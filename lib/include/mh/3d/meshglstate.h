@@ -6,11 +6,54 @@
 
 #include "mh/ext/gl3w/gl3w.h"
 
+#include "mh/3d/mesh_changes.h"
+#include "mh/3d/normals.h"
+
+#include "mh/gpu/stream_buffer.h"
+#include "mh/gpu/upload_scheduler.h"
+#include "mh/gpu/vertex_format.h"
+
+#include "mh/util/worker_pool.h"
+
 namespace mh
 {
 
 class Mesh;
 
+// How mesh corners become GL vertices.
+enum class GLVertexMode
+{
+    // every corner is its own GL vertex, 3 * nFaces() in total; needed
+    // for flat shading, where no two faces share a normal anyway
+    DUPLICATED,
+    // corners of a vertex that agree on normal and texture coordinates
+    // share one GL vertex, referenced through a real index buffer
+    INDEXED
+};
+
+// CPU side of a full rebuild: the settings it was made with, the GL vertex
+// layout and the packed buffer contents. Filled without GL calls, so it can
+// be prepared on a worker thread.
+struct MeshGLBuild
+{
+    GLVertexMode                 vertexMode;
+    VertexFormat                 format;
+    VertexQuantization           quantization;
+    bool                         hasTexture;
+    bool                         dynamic;
+    size_t                       nFaces;
+    size_t                       nGLVertices;
+
+    std::vector<uint32_t>        glVertexCorners;
+    std::vector<uint32_t>        vertexGLOffsets;
+    std::vector<uint8_t>         vertexData;
+    std::vector<Eigen::Vector3i> faceData;
+}; // struct MeshGLBuild
+
+// Fills layout and buffer contents of build, whose settings are set. Reads
+// the mesh only, so it runs on any thread; checks cancelled in between.
+void prepareMeshGLBuild(const Mesh & mesh, MeshGLBuild & build, const std::atomic<bool> * cancelled = nullptr);
+
 class MeshGLState
 {
 public:
@@ -22,36 +65,173 @@ public:
     static constexpr int CUSTOM_VEC_LOCATION = 5;
     static constexpr int TEXTURE_LOCATION    = 6;
 
-    MeshGLState(Mesh & mesh) : m_mesh(mesh), m_vboCreated(false) {}
+    MeshGLState(Mesh & mesh)
+        : m_mesh(mesh)
+        , m_vertexMode(GLVertexMode::INDEXED)
+        , m_builtVertexMode(GLVertexMode::INDEXED)
+        , m_nGLVertices(0)
+        , m_nDrawFaces(0)
+        , m_async(false)
+        , m_dynamic(false)
+        , m_baseVertex(0)
+        , m_vboCreated(false)
+        , m_hasTexture(false)
+        , m_instanceVboID(0) { m_deferred.clear(); }
     MeshGLState(MeshGLState & rhs)
         : m_mesh(rhs.m_mesh)
-        , m_vboCreated(false) {}
+        , m_vertexMode(rhs.m_vertexMode)
+        , m_builtVertexMode(rhs.m_vertexMode)
+        , m_nGLVertices(0)
+        , m_nDrawFaces(0)
+        , m_async(rhs.m_async)
+        , m_dynamic(rhs.m_dynamic)
+        , m_baseVertex(0)
+        , m_requestedFormat(rhs.m_requestedFormat)
+        , m_vboCreated(false)
+        , m_hasTexture(false)
+        , m_instanceVboID(0) { m_deferred.clear(); }
     ~MeshGLState();
 
     void createVBO();
     void deleteVBO();
 
+    // Brings the buffers up to date. Topology changes rebuild everything;
+    // attribute changes are written into the existing buffer, repacking
+    // only the GL vertices of the changed vertices or faces. In indexed
+    // mode wedge changes rebuild too, since they can split or merge GL
+    // vertices.
+    void update(const MeshChanges & changes);
+
+    // Asynchronous rebuilds: the buffer contents are packed on a worker
+    // thread and uploaded in chunks within the frame budget of
+    // UploadScheduler, meanwhile draw() keeps using the previous buffers.
+    // The worker reads the mesh, so it must not change until the rebuild
+    // is prepared; Mesh's mutators call waitForPreparation(). Topology,
+    // vertex mode, texture or format changes restart a pending rebuild,
+    // attribute changes are collected and applied once it is installed.
+    void                 setAsync(bool async)                           { m_async = async; }
+    bool                 isAsync()                                const { return m_async; }
+    // a rebuild is being prepared or uploaded
+    bool                 isPending()                              const { return m_pending != nullptr; }
+    void                 waitForPreparation()                           { if (m_pendingJob.valid()) m_pendingJob.wait(); }
+
+    // Dynamic meshes change their attributes every frame. The vertices
+    // live in a StreamBuffer and every update with changes repacks all of
+    // them into its next region, straight into GPU visible memory; index
+    // buffer and layout stay. Rebuilds are only needed for topology changes
+    // and wedge changes that split GL vertices, and always run synchronously.
+    // Quantized positions follow the bounds, so set the decode uniforms
+    // from getPositionQuantization() every frame.
+    void                 setDynamic(bool dynamic)                       { m_dynamic = dynamic; }
+    bool                 isDynamic()                              const { return m_dynamic; }
+    // nullptr unless a dynamic mesh was built
+    const StreamBuffer * getStreamBuffer()                        const { return m_stream.get(); }
+
+    // take effect on the next update; an empty format selects
+    // defaultVertexFormat()
+    void                 setVertexMode(GLVertexMode mode)               { m_vertexMode = mode; }
+    GLVertexMode         getVertexMode()                          const { return m_vertexMode; }
+    void                 setVertexFormat(const VertexFormat & format)   { m_requestedFormat = format; }
+    const VertexFormat & getVertexFormat()                        const { return m_requestedFormat; }
+
+    // all attributes as 32 bit values at the *_LOCATION slots
+    static VertexFormat  defaultVertexFormat(bool withTextureCoords);
+    // same slots with quantized positions, octahedral normals, RGBA8 colors
+    // and half float texture coordinates; custom attributes stay 32 bit.
+    // Shaders decode with VERTEX_DECODE_GLSL (mh/gpu/vertex_decode.h).
+    static VertexFormat  compactVertexFormat(bool withTextureCoords);
+
+    // bounds positions are quantized over, for setVertexDecodeUniforms
+    const VertexQuantization & getPositionQuantization() const { return m_quantization; }
+
+    size_t       nGLVertices()                    const { return m_nGLVertices; }
+    // bytes held by the vertex and index buffer
+    size_t       gpuMemoryUsage()                 const;
+
+    // Per instance attributes for drawInstanced(), read from buffer with a
+    // divisor of 1; the buffer stays owned by the caller and attached
+    // across rebuilds. 0 detaches.
+    void setInstanceBuffer(GLuint bufferID, const VertexFormat & format);
+
     void draw();
+    void drawInstanced(GLsizei nInstances);
 
     Mesh & mesh() { return m_mesh; }
 
 protected:
 
 private:
+    VertexFormat activeFormat(bool hasTexture) const;
+
+    // settings of a new build, taken on the GL thread
+    std::shared_ptr<MeshGLBuild> beginBuild() const;
+    // makes the build and the given buffers current, creating the VAO
+    void install(MeshGLBuild & build, GLuint vertexVboID, GLuint faceVboID);
+
+    bool needsRebuild(const MeshChanges & changes, bool hasTexture) const;
+    void uploadChanges(const MeshChanges & changes);
+
+    // dynamic meshes: whether the changed wedges still fit their GL vertices
+    bool layoutHolds(const MeshChanges & changes) const;
+    // dynamic meshes: packs all GL vertices into the next stream region
+    void streamVertices(const MeshChanges & changes);
+
+    void startPreparation();
+    void cancelPending();
+    // uploads the prepared build within the budget, installs it once done
+    void stepPending();
+
+    // GL vertex runs holding the given vertices
+    std::vector<IndexRange> vertexSlots(const DirtyRanges & verts);
+    // GL vertex runs of the given faces
+    std::vector<IndexRange> faceSlots(const DirtyRanges & faces);
+
     Mesh & m_mesh;
 
+    GLVertexMode          m_vertexMode;
+    GLVertexMode          m_builtVertexMode;
+    size_t                m_nGLVertices;
+    // faces in the current buffers, which may lag behind the mesh
+    size_t                m_nDrawFaces;
+    bool                  m_async;
+    bool                  m_dynamic;
+    // first GL vertex of the current stream region
+    GLint                 m_baseVertex;
+
+    VertexFormat          m_requestedFormat;
+    // layout of the current buffer
+    VertexFormat          m_format;
+    VertexQuantization    m_quantization;
+
+    // duplicated mode: corners of every vertex, built on the first partial
+    // vertex update
+    VertexCorners         m_vertexCorners;
+    // indexed mode: the corner every GL vertex was taken from, and the
+    // range of GL vertices of every mesh vertex by position
+    std::vector<uint32_t> m_glVertexCorners;
+    std::vector<uint32_t> m_vertexGLOffsets;
+    // dynamic indexed meshes: GL vertices of every face, for layoutHolds()
+    std::vector<Eigen::Vector3i> m_glFaces;
+
     bool   m_vboCreated;
     bool   m_hasTexture;
 
     GLuint m_vaoID;
     GLuint m_faceVboID;
-    GLuint m_posVboID;
-    GLuint m_normalVboID;
-    GLuint m_colorVboID;
-    GLuint m_indexVboID;
-    GLuint m_customIntVboID;
-    GLuint m_customVecVboID;
-    GLuint m_textureVboID;
+    GLuint m_vertexVboID;
+
+    GLuint       m_instanceVboID;
+    VertexFormat m_instanceFormat;
+
+    // owns m_vertexVboID of dynamic meshes
+    std::unique_ptr<StreamBuffer>  m_stream;
+
+    std::shared_ptr<MeshGLBuild>   m_pending;
+    BackgroundJob                  m_pendingJob;
+    std::unique_ptr<ChunkedUpload> m_pendingVertices;
+    std::unique_ptr<ChunkedUpload> m_pendingFaces;
+    // attribute changes made after the pending rebuild was prepared
+    MeshChanges                    m_deferred;
 
 }; // class MeshGLState
 
@@ -67,9 +247,22 @@ struct MeshGLData
     std::vector<Eigen::Vector3i> faceData;
 
     std::vector<float2>          textureCoordsData;
+
+    // indexed data only: source corner of every GL vertex, and the GL
+    // vertices of mesh vertex v in [vertexGLOffsets[v], vertexGLOffsets[v + 1]),
+    // v being the position in Mesh::getVerts()
+    std::vector<uint32_t>        glVertexCorners;
+    std::vector<uint32_t>        vertexGLOffsets;
 }; // struct MeshGLData
 
+// one GL vertex per corner, faceData is the identity
 MeshGLData getMeshGLData(const Mesh & mesh);
+// One GL vertex per distinct (vertex, normal, texture coordinates) among
+// the corners of every vertex. Corners are grouped by vertex and compared by
+// a hash of their wedge attributes, exact comparison only on hash hits, so
+// vertices are processed in parallel. GL vertices are laid out in vertex
+// order, which keeps the index buffer friendly to the vertex cache.
+MeshGLData getIndexedMeshGLData(const Mesh & mesh);
 
 } // namespace mh
 
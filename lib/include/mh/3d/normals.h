@@ -0,0 +1,66 @@
+#ifndef NORMALS_H
+#define NORMALS_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+namespace mh
+{
+
+class Mesh;
+class CompactMesh;
+
+// how the normals of the faces around a vertex are weighted
+enum class NormalWeighting
+{
+    UNIFORM, // every face counts the same
+    AREA,    // by face area
+    ANGLE    // by the interior angle of the face at the vertex
+};
+
+// Corners incident to every vertex in compressed row form: the corners
+// (3 * face + corner) of vertex v are corners[offsets[v] .. offsets[v + 1]).
+// Vertices are numbered by position in the mesh, not by Vertex::idx().
+struct VertexCorners
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> corners;
+}; // struct VertexCorners
+
+// Builds the incidence with a parallel radix sort of the corners by vertex.
+// It only depends on topology, so deforming meshes build it once and pass it
+// to every normal update.
+VertexCorners buildVertexCorners(const Mesh & mesh);
+VertexCorners buildVertexCorners(const CompactMesh & mesh);
+
+// Smooth normals, written to every wedge. Each vertex gathers the weighted
+// normals of its incident faces, so vertices are processed in parallel
+// without atomics or scattered writes. With a creaseAngle (radians) below
+// pi, every corner only averages the faces of its vertex whose normal is
+// within creaseAngle of its own face normal. That is a per corner cone, not
+// a split into connected smooth sectors: faces on the far side of a crease
+// count when their normals happen to be close. The default of pi smooths
+// across every edge.
+void computeSmoothNormals(Mesh & mesh,
+                          NormalWeighting weighting = NormalWeighting::AREA,
+                          float creaseAngle = M_PI);
+void computeSmoothNormals(Mesh & mesh,
+                          const VertexCorners & incidence,
+                          NormalWeighting weighting = NormalWeighting::AREA,
+                          float creaseAngle = M_PI);
+
+void computeSmoothNormals(CompactMesh & mesh,
+                          NormalWeighting weighting = NormalWeighting::AREA,
+                          float creaseAngle = M_PI);
+void computeSmoothNormals(CompactMesh & mesh,
+                          const VertexCorners & incidence,
+                          NormalWeighting weighting = NormalWeighting::AREA,
+                          float creaseAngle = M_PI);
+
+} // namespace mh
+
+#endif /* NORMALS_H */
@@ -6,11 +6,28 @@
 
 #include "mh/ext/gl3w/gl3w.h"
 
+#include "mh/3d/mesh_changes.h"
+
+#include "mh/gpu/upload_scheduler.h"
+#include "mh/gpu/vertex_format.h"
+
+#include "mh/util/worker_pool.h"
+
 namespace mh
 {
 
 class Mesh;
 
+// CPU side of a full rebuild, see MeshGLBuild
+struct PointcloudGLBuild
+{
+    VertexFormat         format;
+    VertexQuantization   quantization;
+    size_t               nVerts;
+
+    std::vector<uint8_t> vertexData;
+}; // struct PointcloudGLBuild
+
 class PointcloudGLState
 {
 public:
@@ -20,15 +37,46 @@ public:
     static constexpr int CUSTOM_INT_LOCATION = 4;
     static constexpr int CUSTOM_VEC_LOCATION = 5;
 
-    PointcloudGLState(Mesh & mesh) : m_pointcloud(mesh), m_vboCreated(false) {}
+    PointcloudGLState(Mesh & mesh)
+        : m_pointcloud(mesh)
+        , m_defaultFormat(defaultVertexFormat())
+        , m_nDrawVerts(0)
+        , m_async(false)
+        , m_vboCreated(false) {}
     PointcloudGLState(PointcloudGLState & rhs)
         : m_pointcloud(rhs.m_pointcloud)
+        , m_requestedFormat(rhs.m_requestedFormat)
+        , m_defaultFormat(rhs.m_defaultFormat)
+        , m_nDrawVerts(0)
+        , m_async(rhs.m_async)
         , m_vboCreated(false) {}
     ~PointcloudGLState();
 
     void createVBO();
     void deleteVBO();
 
+    // rebuilds on topology changes, otherwise repacks the changed vertex
+    // ranges of the existing buffer
+    void update(const MeshChanges & changes);
+
+    // asynchronous rebuilds, see MeshGLState
+    void                 setAsync(bool async)                           { m_async = async; }
+    bool                 isAsync()                                const { return m_async; }
+    bool                 isPending()                              const { return m_pending != nullptr; }
+    void                 waitForPreparation()                           { if (m_pendingJob.valid()) m_pendingJob.wait(); }
+
+    // takes effect on the next update; an empty format selects
+    // defaultVertexFormat()
+    void                 setVertexFormat(const VertexFormat & format)   { m_requestedFormat = format; }
+    const VertexFormat & getVertexFormat()                        const { return m_requestedFormat; }
+
+    // all attributes as 32 bit values at the *_LOCATION slots
+    static VertexFormat  defaultVertexFormat();
+    // quantized positions and RGBA8 colors, see MeshGLState
+    static VertexFormat  compactVertexFormat();
+
+    const VertexQuantization & getPositionQuantization() const { return m_quantization; }
+
     void draw();
 
     Mesh & pointcloud() { return m_pointcloud; }
@@ -36,17 +84,36 @@ public:
 protected:
 
 private:
+    const VertexFormat & activeFormat() const;
+
+    std::shared_ptr<PointcloudGLBuild> beginBuild() const;
+    void install(const PointcloudGLBuild & build, GLuint vertexVboID);
+
+    void uploadChanges(const MeshChanges & changes);
+
+    void startPreparation();
+    void cancelPending();
+    void stepPending();
+
     Mesh & m_pointcloud;
 
+    VertexFormat       m_requestedFormat;
+    VertexFormat       m_defaultFormat;
+    // layout of the current buffer
+    VertexFormat       m_format;
+    VertexQuantization m_quantization;
+    // vertices in the current buffer, which may lag behind the mesh
+    size_t             m_nDrawVerts;
+    bool               m_async;
+
     bool   m_vboCreated;
-    bool   m_hasTexture;
 
     GLuint m_vaoID;
-    GLuint m_posVboID;
-    GLuint m_colorVboID;
-    GLuint m_indexVboID;
-    GLuint m_customIntVboID;
-    GLuint m_customVecVboID;
+    GLuint m_vertexVboID;
+
+    std::shared_ptr<PointcloudGLBuild> m_pending;
+    BackgroundJob                      m_pendingJob;
+    std::unique_ptr<ChunkedUpload>     m_pendingVertices;
 
 }; // class PointcloudGLState
 
@@ -0,0 +1,67 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+namespace mh
+{
+
+// GL state switched between the draws of a frame, see Scene::getRenderStats
+struct RenderStats
+{
+    size_t draws            = 0;
+    size_t programChanges   = 0;
+    size_t textureChanges   = 0;
+    size_t materialChanges  = 0;
+
+    size_t stateChanges() const { return programChanges + textureChanges + materialChanges; }
+}; // struct RenderStats
+
+// Orders the draws of a frame by a 64 bit key, most significant first:
+//
+//   program  8 bits | texture 16 bits | material 16 bits | depth 24 bits
+//
+// so draws sharing a program are contiguous, inside those the ones sharing
+// a texture, and so on; depth only orders draws with identical state, front
+// to back to help early depth rejection. Programs, textures and materials
+// are small ids the caller hands out, e.g. in order of first appearance.
+class RenderQueue
+{
+public:
+    static constexpr int PROGRAM_BITS  = 8;
+    static constexpr int TEXTURE_BITS  = 16;
+    static constexpr int MATERIAL_BITS = 16;
+    static constexpr int DEPTH_BITS    = 24;
+
+    struct Item
+    {
+        uint64_t key;
+        // what the caller draws, e.g. a mesh index
+        uint32_t index;
+    }; // struct Item
+
+    // ids are clamped to their field; depth in [0, 1], 0 nearest
+    static uint64_t makeKey(uint32_t program, uint32_t texture, uint32_t material, float depth);
+
+    void clear(void)                            { m_items.clear(); }
+    void reserve(size_t n)                      { m_items.reserve(n); }
+    void push(uint64_t key, uint32_t index)     { m_items.push_back(Item{key, index}); }
+
+    // stable, so equal keys keep the order they were pushed in
+    void sort(void);
+
+    const std::vector<Item> & items(void) const { return m_items; }
+    size_t                    size (void) const { return m_items.size(); }
+    bool                      empty(void) const { return m_items.empty(); }
+
+private:
+    std::vector<Item> m_items;
+}; // class RenderQueue
+
+} // namespace mh
+
+#endif /* RENDER_QUEUE_H */
@@ -4,18 +4,62 @@
 #include "mh/base/defs.h"
 #include "mh/base/imports.h"
 
+#include "mh/3d/batch_renderer.h"
+#include "mh/3d/frustum.h"
+#include "mh/3d/render_queue.h"
+#include "mh/3d/instanced_mesh.h"
 #include "mh/3d/mesh.h"
 
 #include "mh/gpu/shader.h"
+#include "mh/gpu/uniform_buffer.h"
 
 namespace mh
 {
 
 class Camera;
 
+// Uniform blocks Scene::draw fills for shaders that declare them:
+//
+//   layout(std140) uniform MhCamera { mat4 worldToCamera; mat4 cameraToClip; };
+//   layout(std140) uniform MhModel  { mat4 modelToWorld; vec3 diffuse; float shininess; vec3 specular; };
+//
+// The members are used like plain uniforms. Shaders declaring plain
+// uniforms of the same names instead get them set one by one.
+extern const char * const SCENE_BLOCKS_GLSL;
+
 class Scene
 {
 public:
+    static constexpr GLuint CAMERA_BINDING = 0;
+    static constexpr GLuint MODEL_BINDING  = 1;
+
+    // std140 counterparts of the blocks in SCENE_BLOCKS_GLSL
+    struct CameraBlock
+    {
+        Eigen::Matrix4f worldToCamera;
+        Eigen::Matrix4f cameraToClip;
+    }; // struct CameraBlock
+
+    struct ModelBlock
+    {
+        Eigen::Matrix4f modelToWorld;
+        Eigen::Vector3f diffuse;
+        float           shininess;
+        Eigen::Vector3f specular;
+        float           padding;
+    }; // struct ModelBlock
+
+    // what the last draw() culled
+    struct CullingStats
+    {
+        size_t drawn            = 0;
+        size_t culled           = 0;
+        // frustum tests against hierarchy nodes and mesh boxes
+        size_t boxTests         = 0;
+        size_t instancesDrawn   = 0;
+        size_t instancesCulled  = 0;
+    }; // struct CullingStats
+
     Scene  (void);
     Scene  (const std::vector<std::shared_ptr<Mesh> > & meshes);
 
@@ -25,10 +69,50 @@ public:
     const std::vector<std::shared_ptr<Mesh> > & getMeshes            (void) const { return m_meshes; }
           std::vector<std::shared_ptr<Mesh> > & getMeshes            (void)       { return m_meshes; }
 
+    // drawn after the meshes, with mhInstanced set (see INSTANCE_GLSL) and
+    // their instances culled against the camera frustum
+    void                                        addInstancedMesh     (std::shared_ptr<InstancedMesh> mesh);
+    const std::vector<std::shared_ptr<InstancedMesh> > & getInstancedMeshes(void) const { return m_instancedMeshes; }
+
+    // camera and per mesh transform and material go through the blocks
+    // above where the shader has them; all model blocks are uploaded in one
+    // call, every mesh then only binds its own
     void                                        draw                 (std::shared_ptr<Shader> shader, std::shared_ptr<Camera> camera); 
 
+    // Batched drawing through BatchRenderer where the context supports
+    // it; the shader then has to be written against BATCH_GLSL. Without
+    // support draw() stays per mesh.
+    void                                        setBatching          (bool batching) { m_batching = batching; }
+    bool                                        isBatching           (void) const    { return m_batching && BatchRenderer::isSupported(); }
+
+    // Meshes are submitted sorted by texture, then material, then front to
+    // back, so consecutive meshes sharing state skip rebinding it; on by
+    // default. A shader with a "diffuseTexture" sampler gets the diffuse
+    // texture of each material on unit 0. The stats count changes of the
+    // state the draws require, whether or not the shader uses all of it.
+    void                                        setSorting           (bool sorting)  { m_sorting = sorting; }
+    bool                                        isSorting            (void) const    { return m_sorting; }
+    const RenderStats &                         getRenderStats       (void) const    { return m_renderStats; }
+
+    // Meshes whose world space box misses the camera frustum are skipped
+    // by draw(); on by default.
+    void                                        setCulling           (bool culling)  { m_culling = culling; }
+    bool                                        isCulling            (void) const    { return m_culling; }
+    const CullingStats &                        getCullingStats      (void) const    { return m_cullingStats; }
+
+    // Bounding volume hierarchy over the world space boxes of the meshes,
+    // for static scenes: culling then tests nodes first and skips whole
+    // subtrees outside or inside the frustum. The boxes are taken now;
+    // later changes to transforms or geometry go unnoticed until the next
+    // build. addMesh, addMeshes and reset drop the hierarchy.
+    void                                        buildCullingHierarchy(void);
+    void                                        clearCullingHierarchy(void);
+    bool                                        hasCullingHierarchy  (void) const;
+
     Eigen::Vector3f                             getCenter            (void);
 
+    // union of the cached mesh bounding boxes, in one pass over the meshes
+    void                                        getBounds            (Eigen::Vector3f & min, Eigen::Vector3f & max) const;
     Eigen::Vector3f                             getMin               (void) const;
     Eigen::Vector3f                             getMax               (void) const;
 
@@ -39,11 +123,51 @@ public:
 protected:
 
 private:
+    // node of the culling hierarchy, stored depth first: the left child
+    // follows its parent, leaves have no right child
+    struct CullingNode
+    {
+        Eigen::Vector3f min;
+        Eigen::Vector3f max;
+        // meshes below the node, a range of m_cullingOrder
+        uint32_t        first;
+        uint32_t        count;
+        uint32_t        right;
+    }; // struct CullingNode
+
+    static const uint32_t CULLING_LEAF_SIZE = 4;
+
+    uint32_t buildCullingNode(uint32_t first, uint32_t count);
+    // fills m_renderQueue with the visible meshes
+    void     queueMeshes(const Eigen::Affine3f & worldToCamera);
+    // fills m_visible and m_cullingStats
+    void     cull(const Frustum & frustum);
+
     // meshes
     std::vector<std::shared_ptr<Mesh> > m_meshes;
+    std::vector<std::shared_ptr<InstancedMesh> > m_instancedMeshes;
 
     Eigen::Vector3f                     m_center;
 
+    // created on the first draw with a shader declaring the blocks
+    std::unique_ptr<UniformBuffer>      m_cameraBlock;
+    std::unique_ptr<UniformBuffer>      m_modelBlocks;
+
+    bool                                m_batching;
+    bool                                m_culling;
+    bool                                m_sorting;
+    RenderQueue                         m_renderQueue;
+    RenderStats                         m_renderStats;
+    CullingStats                        m_cullingStats;
+    // per mesh, of the last draw
+    std::vector<uint8_t>                m_visible;
+
+    std::vector<CullingNode>            m_cullingNodes;
+    std::vector<uint32_t>               m_cullingOrder;
+    std::vector<Eigen::Vector3f>        m_cullingMin;
+    std::vector<Eigen::Vector3f>        m_cullingMax;
+    std::unique_ptr<BatchRenderer>      m_batchRenderer;
+
 }; // class Scene
 
 } // namespace mh
@@ -0,0 +1,37 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+namespace mh
+{
+
+class Mesh;
+class CompactMesh;
+
+struct TopologyStats
+{
+    size_t nEdges            = 0;
+    size_t nBoundaryEdges    = 0;
+    size_t nNonManifoldEdges = 0;
+}; // struct TopologyStats
+
+// Links every halfedge to its twin and classifies edges. Halfedges are keyed
+// by their unordered vertex pair, the keys are radix sorted in parallel and
+// runs of equal keys are paired: a run of two oppositely oriented halfedges
+// is a manifold edge, a single halfedge is a boundary, anything else is
+// flagged non-manifold and left without twin. Boundary vertices get the
+// outgoing halfedge that starts their fan, so circulating with
+// twin->next from Vertex::getHalfEdge() visits every incident face.
+//
+// Mesh vertices are told apart by Vertex::idx(), which has to be unique
+// and non-negative but need not be the position in getVerts(); the sort
+// key grows with the largest idx. Code that needs positions uses
+// meshCornerVertices.
+TopologyStats finalizeTopology(Mesh & mesh);
+TopologyStats finalizeTopology(CompactMesh & mesh);
+
+} // namespace mh
+
+#endif /* TOPOLOGY_H */
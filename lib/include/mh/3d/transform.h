@@ -1,3 +1,6 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
 #include "mh/base/defs.h"
 #include "mh/base/imports.h"
 
@@ -35,3 +38,5 @@ Eigen::Affine3f transform_to_mtw(const Transform & transform, bool from_bottom=f
 Eigen::Affine3f mtw_to_transform(const Transform & transform);
 
 } // namespace mh
+
+#endif /* TRANSFORM_H */
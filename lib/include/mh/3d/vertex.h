@@ -19,7 +19,8 @@ public:
     , m_color(0.0f, 0.0f, 0.0f)
     , m_idx(idx)
     , m_custom_int(0)
-    , m_custom_vec(0.0f, 0.0f, 0.0f) {}
+    , m_custom_vec(0.0f, 0.0f, 0.0f)
+    , m_halfedge(nullptr) {}
 
     EXPOSE     (Eigen::Vector3f, Position, m_position)
     EXPOSE     (Eigen::Vector3f, Color,    m_color)
@@ -0,0 +1,44 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <cstdint>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/gpu/vertex_format.h"
+
+namespace mh
+{
+
+class Mesh;
+class Vertex;
+class Wedge;
+struct MeshChanges;
+
+// Batch size for packVertices: large enough to amortize the per-element
+// dispatch, small enough for the written vertices to stay in cache while
+// the next element is filled in.
+const size_t PACK_BATCH_SIZE = 256;
+
+// Writes n interleaved vertices laid out by format to dst, reading vertex
+// attributes from verts[i] and corner attributes from wedges[i]. Without
+// wedges (point clouds) normals and texture coordinates are zero. Elements
+// are written one after another over the whole batch, so callers should
+// hand in batches of about PACK_BATCH_SIZE vertices.
+//
+// Float attributes are converted to the element type: half floats, or
+// unorm/snorm for normalized fixed point types (colors get alpha 1). A
+// normalized position is quantized to [0, 1] over quantization, a normal
+// with two components is octahedral encoded.
+void packVertices(const VertexFormat & format, const Vertex * const * verts, const Wedge * const * wedges, size_t n, uint8_t * dst,
+                  const VertexQuantization & quantization = VertexQuantization());
+
+// False if format quantizes positions and the changed positions of mesh
+// left the box of quantization, which then has to be rebuilt.
+bool quantizationHolds(const VertexFormat & format, const VertexQuantization & quantization,
+                       const Mesh & mesh, const MeshChanges & changes);
+
+} // namespace mh
+
+#endif /* VERTEX_PACKING_H */
@@ -0,0 +1,63 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+// OpenMP directive that vanishes without OpenMP, where a plain #pragma omp
+// would trip -Wunknown-pragmas: MH_OMP(parallel for schedule(static))
+#ifdef _OPENMP
+#   define MH_OMP(...)        _Pragma(MH_OMP_STRING(omp __VA_ARGS__))
+#   define MH_OMP_STRING(...) #__VA_ARGS__
+#else
+#   define MH_OMP(...)
+#endif
+
+namespace mh
+{
+
+// thin wrappers so code parallelized with OpenMP pragmas also compiles and
+// runs serially when the library is built without OpenMP support
+
+inline int maxThreads(void)
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+inline int threadNum(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+inline int numThreads(void)
+{
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+// true inside an active parallel region, where new work should be tasks
+// for the existing team rather than a nested region
+inline bool inParallel(void)
+{
+#ifdef _OPENMP
+    return omp_in_parallel() != 0;
+#else
+    return false;
+#endif
+}
+
+} // namespace mh
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,36 @@
+#ifndef BUFFER_UPLOAD_H
+#define BUFFER_UPLOAD_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/ext/gl3w/gl3w.h"
+
+#include "mh/util/dirty_ranges.h"
+
+namespace mh
+{
+
+// Prepares sorted element runs for upload: runs separated by small gaps are
+// joined, since one bigger copy beats another driver call, and past a
+// limit everything collapses into a single spanning run.
+void coalesceRuns(std::vector<IndexRange> & runs);
+
+// Writes the elements of every run into an allocated buffer with
+// glBufferSubData; get(i) returns element i. The buffer keeps its storage.
+template <class T, class TGetFunc>
+void uploadRuns(GLenum target, GLuint buffer, const std::vector<IndexRange> & runs, TGetFunc get);
+
+// Same for buffers of interleaved records of stride bytes; pack(begin, end,
+// dst) writes records [begin, end) to dst.
+template <class TPackFunc>
+void uploadPackedRuns(GLenum target, GLuint buffer, const std::vector<IndexRange> & runs, size_t stride, TPackFunc pack);
+
+} // namespace mh
+
+#include "impl/buffer_upload.hpp"
+
+#endif /* BUFFER_UPLOAD_H */
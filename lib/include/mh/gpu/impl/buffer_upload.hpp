@@ -0,0 +1,43 @@
+namespace mh
+{
+
+template <class T, class TGetFunc>
+void uploadRuns(GLenum target, GLuint buffer, const std::vector<IndexRange> & runs, TGetFunc get)
+{
+    if (runs.empty()) return;
+
+    std::vector<T> scratch;
+
+    glBindBuffer(target, buffer);
+    for (const IndexRange & run : runs)
+    {
+        scratch.resize(run.end - run.begin);
+        for (size_t i = run.begin; i < run.end; ++i)
+        {
+            scratch[i - run.begin] = get(i);
+        }
+
+        glBufferSubData(target, sizeof(T) * run.begin, sizeof(T) * scratch.size(), scratch.data());
+    }
+    glBindBuffer(target, 0);
+}
+
+template <class TPackFunc>
+void uploadPackedRuns(GLenum target, GLuint buffer, const std::vector<IndexRange> & runs, size_t stride, TPackFunc pack)
+{
+    if (runs.empty()) return;
+
+    std::vector<uint8_t> scratch;
+
+    glBindBuffer(target, buffer);
+    for (const IndexRange & run : runs)
+    {
+        scratch.resize(stride * (run.end - run.begin));
+        pack(run.begin, run.end, scratch.data());
+
+        glBufferSubData(target, stride * run.begin, scratch.size(), scratch.data());
+    }
+    glBindBuffer(target, 0);
+}
+
+} // namespace mh
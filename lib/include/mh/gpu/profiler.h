@@ -0,0 +1,148 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/ext/gl3w/gl3w.h"
+
+namespace mh
+{
+
+// one timed scope of a frame; times in milliseconds, starts relative to
+// the creation of the profiler
+struct ProfileSample
+{
+    std::string name;
+    // nesting level, 0 for top level scopes
+    int         depth;
+    double      cpuStart;
+    double      cpuTime;
+    // -1 if the scope was not timed on the GPU
+    double      gpuTime;
+}; // struct ProfileSample
+
+struct ProfileFrame
+{
+    uint64_t                   index;
+    double                     cpuStart;
+    double                     cpuTime;
+    std::vector<ProfileSample> samples;
+}; // struct ProfileFrame
+
+// CPU and GPU timings of the scopes of every frame. GPU times come from
+// GL_TIME_ELAPSED queries kept in a ring of FRAMES_IN_FLIGHT frames: the
+// results of a frame are read when its slot comes round again, so reading
+// never waits for the GPU. Frames whose results are still not available
+// then are dropped rather than waited for. Elapsed time queries do not
+// nest, so scopes inside a GPU timed scope are timed on the CPU only.
+// GL thread only.
+class Profiler
+{
+public:
+    static const size_t FRAMES_IN_FLIGHT = 4;
+    static const size_t NO_SAMPLE        = size_t(-1);
+
+    static Profiler & get_instance()
+    {
+        static Profiler instance;
+        return instance;
+    }
+
+    // ends the previous frame and reads the GPU results that are due;
+    // scopes outside of frames are ignored
+    void   beginFrame();
+
+    void   setEnabled(bool enabled)   { m_enabled = enabled; }
+    bool   isEnabled()          const { return m_enabled; }
+
+    // number of completed frames kept
+    void   setHistorySize(size_t size);
+    size_t getHistorySize()     const { return m_historySize; }
+
+    // completed frames, oldest first; lags FRAMES_IN_FLIGHT - 1 frames
+    const std::deque<ProfileFrame> & getHistory() const { return m_history; }
+    size_t                           nDropped()   const { return m_dropped; }
+    void                             clear();
+
+    // use ProfileScope instead
+    size_t begin(const char * name, bool gpu);
+    void   end  (size_t sample);
+
+    // one row per sample:
+    //   frame,frame_cpu_ms,name,depth,cpu_start_ms,cpu_ms,gpu_ms
+    // with gpu_ms empty for scopes not timed on the GPU
+    void   exportCsv        (std::ostream & out) const;
+    bool   exportCsv        (const std::string & filename) const;
+
+    // Chrome trace event format, for chrome://tracing and compatible
+    // viewers: CPU scopes on thread 0, GPU scopes on thread 1. Queries only
+    // give durations, so GPU scopes are placed at the CPU start of the scope.
+    void   exportChromeTrace(std::ostream & out) const;
+    bool   exportChromeTrace(const std::string & filename) const;
+
+private:
+    struct InFlightFrame
+    {
+        ProfileFrame        frame;
+        bool                active   = false;
+        // query pool of the slot, the first nQueries are in use
+        std::vector<GLuint> queries;
+        size_t              nQueries = 0;
+        // sample timed by each query in use
+        std::vector<size_t> querySamples;
+    }; // struct InFlightFrame
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler &);
+    void operator=(const Profiler &);
+
+    double now() const;
+    void   collect(InFlightFrame & slot);
+
+    bool                                  m_enabled;
+    size_t                                m_historySize;
+    std::chrono::steady_clock::time_point m_epoch;
+
+    std::array<InFlightFrame, FRAMES_IN_FLIGHT> m_slots;
+    size_t                                      m_current;
+    uint64_t                                    m_frameIndex;
+
+    // open scopes of the current frame
+    std::vector<size_t>                   m_open;
+    // sample owning the running query, NO_SAMPLE if none
+    size_t                                m_gpuSample;
+
+    std::deque<ProfileFrame>              m_history;
+    size_t                                m_dropped;
+
+}; // class Profiler
+
+// Times the enclosing scope:
+//
+//   { ProfileScope scope("scene draw"); ... }
+class ProfileScope
+{
+public:
+    ProfileScope(const char * name, bool gpu = true) : m_sample(Profiler::get_instance().begin(name, gpu)) {}
+    ~ProfileScope() { Profiler::get_instance().end(m_sample); }
+
+private:
+    ProfileScope(const ProfileScope &);
+    void operator=(const ProfileScope &);
+
+    size_t m_sample;
+}; // class ProfileScope
+
+} // namespace mh
+
+#endif /* PROFILER_H */
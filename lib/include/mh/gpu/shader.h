@@ -5,6 +5,7 @@
 #include "mh/base/imports.h"
 
 #include <map>
+#include <unordered_map>
 
 //#include <GL/glew.h>
 #include "mh/ext/gl3w/gl3w.h"
@@ -14,30 +15,52 @@
 
 #define GLSL(version, shader)  std::string("#version " #version "\n" #shader)
 
-#define EXPOSE_UNIFORM_SETTER_MATRIX(TYPE, EXT) \
+// every setter comes twice: by name, looked up in the locations cached at
+// link time, and by a handle resolved once with Shader::uniform<HANDLE>()
+#define EXPOSE_UNIFORM_SETTER_MATRIX(TYPE, HANDLE, EXT) \
 void setUniform(const std::string & name, TYPE value) \
 { \
-    int location = glGetUniformLocation(m_program, name.c_str()); \
-    glUniformMatrix ## EXT(location, 1, GL_FALSE, value.data()); \
+    setUniform(uniform<HANDLE>(name), value); \
+} \
+void setUniform(UniformHandle<HANDLE> handle, TYPE value) \
+{ \
+    glUniformMatrix ## EXT(handle.location, 1, GL_FALSE, value.data()); \
 }
 
-#define EXPOSE_UNIFORM_SETTER_VECTOR(TYPE, EXT) \
+#define EXPOSE_UNIFORM_SETTER_VECTOR(TYPE, HANDLE, EXT) \
 void setUniform(const std::string & name, TYPE value) \
 { \
-    int location = glGetUniformLocation(m_program, name.c_str()); \
-    glUniform ## EXT(location, 1, value.data()); \
+    setUniform(uniform<HANDLE>(name), value); \
+} \
+void setUniform(UniformHandle<HANDLE> handle, TYPE value) \
+{ \
+    glUniform ## EXT(handle.location, 1, value.data()); \
 }
 
 #define EXPOSE_UNIFORM_SETTER_BUILTIN(TYPE, EXT) \
 void setUniform(const std::string & name, TYPE value) \
 { \
-    int location = glGetUniformLocation(m_program, name.c_str()); \
-    glUniform1 ## EXT(location, value); \
+    setUniform(uniform<TYPE>(name), value); \
+} \
+void setUniform(UniformHandle<TYPE> handle, TYPE value) \
+{ \
+    glUniform1 ## EXT(handle.location, value); \
 }
 
 namespace mh
 {
 
+// Location of a uniform of type T in one program. Invalid handles (the
+// uniform does not exist or was optimized away) are ignored by the setters,
+// like unknown names.
+template <class T>
+struct UniformHandle
+{
+    GLint location;
+
+    bool valid() const { return location >= 0; }
+}; // struct UniformHandle
+
 class Shader
 {
 public:
@@ -46,13 +69,13 @@ public:
     { vertexShader(vertexCode); fragmentShader(fragmentCode); }
     ~Shader (void);
     
-    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Matrix2f,  2fv);
-    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Matrix3f&, 3fv);
-    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Matrix4f&, 4fv);
-    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Affine3f&, 4fv);
+    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Matrix2f,  Eigen::Matrix2f, 2fv);
+    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Matrix3f&, Eigen::Matrix3f, 3fv);
+    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Matrix4f&, Eigen::Matrix4f, 4fv);
+    EXPOSE_UNIFORM_SETTER_MATRIX  (const Eigen::Affine3f&, Eigen::Affine3f, 4fv);
 
-    EXPOSE_UNIFORM_SETTER_VECTOR  (const Eigen::Vector3f, 3fv);
-    EXPOSE_UNIFORM_SETTER_VECTOR  (const Eigen::Vector4f, 4fv);
+    EXPOSE_UNIFORM_SETTER_VECTOR  (const Eigen::Vector3f,  Eigen::Vector3f, 3fv);
+    EXPOSE_UNIFORM_SETTER_VECTOR  (const Eigen::Vector4f,  Eigen::Vector4f, 4fv);
 
     EXPOSE_UNIFORM_SETTER_BUILTIN (float, f);
     EXPOSE_UNIFORM_SETTER_BUILTIN (int, i);
@@ -61,16 +84,39 @@ public:
     bool vertexShader   (const std::string & code);
     bool fragmentShader (const std::string & code);
 
+    // also reflects the active uniforms and uniform blocks of the program
     bool link           (void);
     void use            (void) { glUseProgram(m_program); }
 
+    // cached location, -1 for unknown names; arrays answer to both "name"
+    // and "name[0]", names not found by reflection such as "name[3]" are
+    // looked up and cached on first use
+    GLint uniformLocation (const std::string & name) const;
+
+    template <class T>
+    UniformHandle<T> uniform(const std::string & name) const { return UniformHandle<T>{uniformLocation(name)}; }
+
+    // Uniform blocks are found by block name, not instance name. Binding
+    // connects a block to the buffer bound at that uniform buffer binding
+    // point, see UniformBuffer; false if the program has no such block.
+    bool hasUniformBlock  (const std::string & name) const { return m_uniformBlocks.count(name) > 0; }
+    bool bindUniformBlock (const std::string & name, GLuint binding);
+
 protected:
 
 private:
+    void reflect        (void);
+
     GLuint m_vertexShader;
     GLuint m_fragmentShader;
     GLuint m_program;
 
+    // filled by reflect, extended by uniformLocation
+    mutable std::unordered_map<std::string, GLint>  m_uniforms;
+    std::unordered_map<std::string, GLuint>         m_uniformBlocks;
+    // current binding of every block index, to skip redundant calls
+    std::vector<GLuint>                             m_blockBindings;
+
 }; // class Shader
 
 } // namespace mh
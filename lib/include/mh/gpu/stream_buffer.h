@@ -0,0 +1,70 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/ext/gl3w/gl3w.h"
+
+namespace mh
+{
+
+// A vertex buffer rewritten every frame without reallocating it. The
+// storage is split into regions that are written in turn; a region is only
+// handed out again once the GPU passed the fence placed after its last
+// draw, so with three regions the CPU writes two frames ahead of the GPU
+// without waiting. Where glBufferStorage exists (GL 4.4 or
+// ARB_buffer_storage) the regions stay persistently mapped; otherwise every
+// region is mapped unsynchronized on its turn.
+class StreamBuffer
+{
+public:
+    static const size_t DEFAULT_REGIONS = 3;
+
+    // GL thread only, allocates nRegions * regionSize bytes
+    StreamBuffer(size_t regionSize, size_t nRegions = DEFAULT_REGIONS);
+    ~StreamBuffer();
+
+    // Moves on to the next region and returns its memory, waiting for the
+    // GPU if it still reads it. Write-only: the memory is uncached and holds
+    // whatever was written nRegions turns ago.
+    uint8_t * map();
+    // ends writing the current region
+    void      unmap();
+    // after the draws reading the current region, which protects it until
+    // the GPU executed them
+    void      fence();
+
+    GLuint id()           const { return m_buffer; }
+    size_t regionSize()   const { return m_regionSize; }
+    size_t nRegions()     const { return m_fences.size(); }
+    // region last handed out by map()
+    size_t region()       const { return m_region; }
+    size_t regionOffset() const { return m_region * m_regionSize; }
+
+    bool   persistent()   const { return m_persistent != nullptr; }
+    // times map() had to wait for the GPU
+    size_t nStalls()      const { return m_nStalls; }
+
+    // whether the driver offers glBufferStorage
+    static bool persistentMappingSupported();
+
+private:
+    StreamBuffer(const StreamBuffer &);
+    void operator=(const StreamBuffer &);
+
+    void waitForRegion(size_t region);
+
+    GLuint              m_buffer;
+    size_t              m_regionSize;
+    size_t              m_region;
+    bool                m_mapped;
+    uint8_t *           m_persistent;
+    std::vector<GLsync> m_fences;
+    size_t              m_nStalls;
+
+}; // class StreamBuffer
+
+} // namespace mh
+
+#endif /* STREAM_BUFFER_H */
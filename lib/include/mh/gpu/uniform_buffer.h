@@ -0,0 +1,60 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/ext/gl3w/gl3w.h"
+
+namespace mh
+{
+
+// An array of equally sized uniform blocks in one buffer. The blocks are
+// filled in a CPU copy, uploaded together in one call and bound one at a
+// time with glBindBufferRange, so drawing many objects costs one binding
+// per object instead of a glUniform call per value. Every block starts on
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT. The block type has to match the
+// std140 layout of the GLSL block, see Scene::CameraBlock.
+class UniformBuffer
+{
+public:
+    // GL thread only
+    UniformBuffer(size_t blockSize, size_t nBlocks = 1);
+    ~UniformBuffer();
+
+    // contents are lost
+    void resize(size_t nBlocks);
+
+    uint8_t * block(size_t i)       { return m_data.data() + i * m_stride; }
+
+    template <class TBlock>
+    TBlock &  block(size_t i)       { MH_ASSERT(sizeof(TBlock) <= m_blockSize); return *reinterpret_cast<TBlock *>(block(i)); }
+
+    // replaces the buffer contents by the CPU copy; orphans the old storage
+    // instead of waiting for draws still reading it
+    void upload();
+    // binds block i to the uniform buffer binding point
+    void bind(GLuint binding, size_t i) const;
+
+    size_t blockSize() const { return m_blockSize; }
+    size_t stride()    const { return m_stride; }
+    size_t nBlocks()   const { return m_nBlocks; }
+
+private:
+    UniformBuffer(const UniformBuffer &);
+    void operator=(const UniformBuffer &);
+
+    GLuint               m_buffer;
+    size_t               m_blockSize;
+    size_t               m_stride;
+    size_t               m_nBlocks;
+    std::vector<uint8_t> m_data;
+
+}; // class UniformBuffer
+
+} // namespace mh
+
+#endif /* UNIFORM_BUFFER_H */
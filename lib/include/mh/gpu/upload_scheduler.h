@@ -0,0 +1,82 @@
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include <chrono>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/ext/gl3w/gl3w.h"
+
+namespace mh
+{
+
+// Per-frame time budget for deferred buffer uploads. beginFrame() starts
+// the clock (Scene::draw does this); uploads check mayUpload() before every
+// chunk. The first chunk of a frame always goes through, so uploads make
+// progress even when the budget is tiny or beginFrame() is never called.
+class UploadScheduler
+{
+public:
+    static UploadScheduler & get_instance()
+    {
+        static UploadScheduler instance;
+        return instance;
+    }
+
+    void   beginFrame();
+
+    void   setFrameBudget(double milliseconds) { m_budget = milliseconds; }
+    double getFrameBudget()              const { return m_budget; }
+
+    bool   mayUpload() const;
+    void   uploaded(size_t bytes) { m_bytesThisFrame += bytes; }
+
+    size_t bytesThisFrame() const { return m_bytesThisFrame; }
+
+private:
+    UploadScheduler() : m_budget(4.0), m_frameStart(std::chrono::steady_clock::now()), m_bytesThisFrame(0) {}
+
+    UploadScheduler(const UploadScheduler &);
+    void operator=(const UploadScheduler &);
+
+    double                                m_budget;
+    std::chrono::steady_clock::time_point m_frameStart;
+    size_t                                m_bytesThisFrame;
+
+}; // class UploadScheduler
+
+// A buffer filled from CPU memory in chunks over as many frames as the
+// upload budget needs. The storage is allocated up front; the source data
+// has to stay alive and unchanged until done() is true.
+class ChunkedUpload
+{
+public:
+    static const size_t CHUNK_SIZE = 1 << 20;
+
+    // GL thread only, allocates the buffer
+    ChunkedUpload(const void * data, size_t size);
+    // deletes the buffer unless it was released
+    ~ChunkedUpload();
+
+    // uploads chunks while the budget allows; true once the buffer is complete
+    bool   step();
+    bool   done()    const { return m_offset == m_size; }
+
+    // hands the buffer over to the caller
+    GLuint release();
+
+private:
+    ChunkedUpload(const ChunkedUpload &);
+    void operator=(const ChunkedUpload &);
+
+    const uint8_t * m_data;
+    size_t          m_size;
+    size_t          m_offset;
+    GLuint          m_buffer;
+
+}; // class ChunkedUpload
+
+} // namespace mh
+
+#endif /* UPLOAD_SCHEDULER_H */
@@ -0,0 +1,40 @@
+#ifndef VERTEX_DECODE_H
+#define VERTEX_DECODE_H
+
+#include <string>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/gpu/shader.h"
+#include "mh/gpu/vertex_format.h"
+
+namespace mh
+{
+
+// GLSL (330) decoders for the compact encodings of VertexFormat:
+//
+//   uniform vec3 mhPositionOffset, mhPositionScale;
+//   vec3 mhDecodePosition(vec3 quantized);
+//   vec3 mhDecodeNormal(vec2 octahedral);
+//
+// Colors, half floats and other normalized types need no decoding, the
+// attribute arrives as a float vector already. A vertex shader declares the
+// attribute with the encoded width, e.g.
+//
+//   layout(location = 0) in vec3 vertexPosition;   // quantized
+//   layout(location = 1) in vec2 vertexNormal;     // octahedral
+//   ...
+//   vec3 position = mhDecodePosition(vertexPosition);
+//   vec3 normal   = mhDecodeNormal(vertexNormal);
+extern const char * const VERTEX_DECODE_GLSL;
+
+// code with VERTEX_DECODE_GLSL inserted after its #version line
+std::string withVertexDecoding(const std::string & code);
+
+// sets mhPositionOffset and mhPositionScale; the program has to be in use
+void setVertexDecodeUniforms(Shader & shader, const VertexQuantization & quantization);
+
+} // namespace mh
+
+#endif /* VERTEX_DECODE_H */
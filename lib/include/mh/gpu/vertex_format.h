@@ -0,0 +1,108 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/ext/gl3w/gl3w.h"
+
+namespace mh
+{
+
+// What a vertex attribute holds, independent of how it is stored.
+enum class VertexSemantic
+{
+    POSITION,
+    NORMAL,
+    COLOR,
+    INDEX,
+    CUSTOM_INT,
+    CUSTOM_VEC,
+    TEXTURE_COORDS,
+    // per instance data, see InstancedMesh: the top three rows of the
+    // model to world matrix and an instance color
+    INSTANCE_TRANSFORM_ROW_0,
+    INSTANCE_TRANSFORM_ROW_1,
+    INSTANCE_TRANSFORM_ROW_2,
+    INSTANCE_COLOR,
+    COUNT
+};
+
+struct VertexElement
+{
+    VertexSemantic semantic;
+    GLuint         location;
+    GLenum         type;
+    GLint          components;
+    // passed with glVertexAttribIPointer, shader side int/uint
+    bool           integer;
+    // fixed point types arrive in the shader as [0, 1] (unsigned) or
+    // [-1, 1] (signed) floats
+    bool           normalized;
+    // byte offset inside the vertex
+    size_t         offset;
+}; // struct VertexElement
+
+// Layout of one interleaved vertex: the elements in order, each starting on
+// a 4 byte boundary, and the stride between consecutive vertices.
+class VertexFormat
+{
+public:
+    VertexFormat() : m_stride(0) {}
+
+    VertexFormat & add(VertexSemantic semantic, GLuint location, GLenum type, GLint components,
+                       bool integer = false, bool normalized = false);
+
+    // Shorthands for the compact encodings packVertices understands; all
+    // decode to a float vector in the shader:
+    //   quantized position: 3 x unorm16 over the bounds of a
+    //                       VertexQuantization, decoded with mhDecodePosition
+    //   octahedral normal:  2 x snorm16, decoded with mhDecodeNormal
+    //   unorm8:             4 x unorm8, e.g. RGBA colors, alpha is 1
+    //   half:               16 bit floats
+    VertexFormat & addQuantized (VertexSemantic semantic, GLuint location);
+    VertexFormat & addOctahedral(VertexSemantic semantic, GLuint location);
+    VertexFormat & addUnorm8    (VertexSemantic semantic, GLuint location);
+    VertexFormat & addHalf      (VertexSemantic semantic, GLuint location, GLint components);
+
+    const std::vector<VertexElement> & elements() const { return m_elements; }
+    size_t                             stride()   const { return m_stride; }
+    bool                               empty()    const { return m_elements.empty(); }
+
+    // element of the given semantic, nullptr if the format has none
+    const VertexElement * find(VertexSemantic semantic) const;
+    bool                  has (VertexSemantic semantic) const { return find(semantic) != nullptr; }
+
+    // points the attributes of the bound vertex array at the buffer bound
+    // to GL_ARRAY_BUFFER and enables them; a divisor of 1 advances them
+    // per instance instead of per vertex
+    void apply(GLuint divisor = 0) const;
+
+    bool operator==(const VertexFormat & rhs) const;
+    bool operator!=(const VertexFormat & rhs) const { return !(*this == rhs); }
+
+    static size_t typeSize(GLenum type);
+
+private:
+    std::vector<VertexElement> m_elements;
+    size_t                     m_stride;
+}; // class VertexFormat
+
+// Maps quantized positions q in [0, 1]^3 back with offset + scale * q.
+struct VertexQuantization
+{
+    Eigen::Vector3f offset = Eigen::Vector3f::Zero();
+    Eigen::Vector3f scale  = Eigen::Vector3f::Ones();
+
+    // covers the box [min, max]; flat axes get a unit scale
+    static VertexQuantization fromBounds(const Eigen::Vector3f & min, const Eigen::Vector3f & max);
+
+    bool contains(const Eigen::Vector3f & min, const Eigen::Vector3f & max) const;
+}; // struct VertexQuantization
+
+} // namespace mh
+
+#endif /* VERTEX_FORMAT_H */
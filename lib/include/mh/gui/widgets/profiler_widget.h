@@ -0,0 +1,37 @@
+#ifndef PROFILER_WIDGET_H
+#define PROFILER_WIDGET_H
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include <string>
+
+#include "mh/gui/widgets/widget.h"
+
+namespace mh
+{
+
+// Per scope breakdown of the frames recorded by Profiler, averaged over the
+// last few frames, with a plot of the frame times and buttons exporting the
+// history to profile.csv and profile.json.
+class ProfilerWidget : public Widget
+{
+public:
+    ProfilerWidget(int width=MH_DEFAULT_WIDGET_WIDTH, int height=MH_DEFAULT_WIDGET_HEIGHT)
+        : Widget(width, height, "Profiler"), m_averageFrames(60) {}
+
+    void         setAverageFrames (size_t n) { m_averageFrames = n > 0 ? n : 1; }
+    size_t       getAverageFrames (void) const { return m_averageFrames; }
+
+protected:
+    virtual void drawContent (void);
+
+private:
+    size_t      m_averageFrames;
+    std::string m_status;
+
+}; // class ProfilerWidget
+
+} // namespace mh
+
+#endif /* PROFILER_WIDGET_H */
@@ -0,0 +1,44 @@
+#ifndef DIRTY_RANGES_H
+#define DIRTY_RANGES_H
+
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+namespace mh
+{
+
+struct IndexRange
+{
+    size_t begin;
+    size_t end;
+}; // struct IndexRange
+
+// Changed element indices as half-open ranges. Ranges are appended as they
+// come in and sorted and merged when read.
+class DirtyRanges
+{
+public:
+    DirtyRanges() : m_merged(true) {}
+
+    void add(size_t begin, size_t end);
+    void add(size_t index) { add(index, index + 1); }
+
+    void clear()       { m_ranges.clear(); m_merged = true; }
+    bool empty() const { return m_ranges.empty(); }
+
+    // sorted, overlapping and touching ranges merged
+    const std::vector<IndexRange> & get() const;
+
+    // number of indices covered
+    size_t count() const;
+
+private:
+    mutable std::vector<IndexRange> m_ranges;
+    mutable bool                    m_merged;
+}; // class DirtyRanges
+
+} // namespace mh
+
+#endif /* DIRTY_RANGES_H */
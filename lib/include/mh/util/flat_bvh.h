@@ -0,0 +1,171 @@
+#ifndef FLAT_BVH_H
+#define FLAT_BVH_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+#include "mh/3d/intersection.h"
+#include "mh/3d/ray.h"
+
+#include "Eigen/Geometry"
+
+namespace mh
+{
+
+class Face;
+class Mesh;
+
+// Node of a FlatBVH, 32 bytes so two share a cache line. Interior nodes
+// have a count of 0, their first child directly follows them and offset
+// is the index of the second; leaves hold the primitives
+// [offset, offset + count) of the leaf order.
+struct FlatBVHNode
+{
+    float    min[3];
+    uint32_t offset;
+    float    max[3];
+    uint32_t count;
+
+    bool                              isLeaf (void) const { return count > 0; }
+    Eigen::Map<const Eigen::Vector3f> getMin (void) const { return Eigen::Map<const Eigen::Vector3f>(min); }
+    Eigen::Map<const Eigen::Vector3f> getMax (void) const { return Eigen::Map<const Eigen::Vector3f>(max); }
+}; // struct FlatBVHNode
+
+static_assert(sizeof(FlatBVHNode) == 32, "FlatBVHNode has to stay 32 bytes");
+
+enum class BVHBuildMethod
+{
+    // object median along the widest spread of triangle centers
+    MEDIAN,
+    // binned surface area heuristic, the cheapest of the bin boundaries
+    // on all three axes
+    SAH,
+    // linear: triangles sorted by the Morton codes of their centers, split
+    // where the codes first differ; fastest to build, for hierarchies
+    // rebuilt every frame
+    LBVH
+};
+
+// Relative costs of visiting a node and testing a triangle, in which the
+// surface area heuristic measures trees. The defaults suit intersect_bvh,
+// where a node pair costs about twice a triangle box test.
+struct BVHCostModel
+{
+    float traversal    = 2.0f;
+    float intersection = 1.0f;
+}; // struct BVHCostModel
+
+// Bounding volume hierarchy over triangles, stored as one array of nodes in
+// depth first order with the triangle corners copied next to each other in
+// leaf order, so walking it touches few cache lines and no pointers. Leaves
+// hold up to getLeafSize() triangles; the SAH and LBVH builders make
+// smaller ones where splitting is cheaper. Built once; changes to the
+// source mesh need a new build. Builds run on the OpenMP threads, splitting
+// large subtrees into tasks; called from a parallel region they join its
+// team.
+class FlatBVH
+{
+public:
+    static const uint32_t DEFAULT_LEAF_SIZE = 4;
+    static const uint32_t SAH_BINS          = 16;
+
+    FlatBVH() : m_leafSize(DEFAULT_LEAF_SIZE), m_buildMethod(BVHBuildMethod::SAH), m_treelets(false), m_depth(0) {}
+
+    void                 setLeafSize    (uint32_t leafSize)            { m_leafSize = leafSize > 0 ? leafSize : 1; }
+    uint32_t             getLeafSize    (void) const                   { return m_leafSize; }
+
+    void                 setBuildMethod (BVHBuildMethod method)        { m_buildMethod = method; }
+    BVHBuildMethod       getBuildMethod (void) const                   { return m_buildMethod; }
+
+    void                 setCostModel   (const BVHCostModel & cost)    { m_costModel = cost; }
+    const BVHCostModel & getCostModel   (void) const                   { return m_costModel; }
+
+    // LBVH only: rearranges treelets of up to seven subtrees into their
+    // cheapest topology under the cost model, recovering much of the SAH
+    // quality for a fraction of its build time
+    void                 setTreelets    (bool treelets)                { m_treelets = treelets; }
+    bool                 getTreelets    (void) const                   { return m_treelets; }
+
+    // over the faces of the mesh, in the space of transform times the mesh
+    // transform like constructBVHFromMesh
+    void build(const Mesh & mesh, const Eigen::Affine3f & transform=Eigen::Affine3f::Identity());
+    // over triangles given by three consecutive corners each
+    void build(const std::vector<Eigen::Vector3f> & corners);
+
+    void clear(void);
+
+    bool                             empty      (void) const { return m_nodes.empty(); }
+    const std::vector<FlatBVHNode> & getNodes   (void) const { return m_nodes; }
+    size_t                           nTriangles (void) const { return m_primitives.size(); }
+    // levels of nodes on the longest path from the root to a leaf
+    uint32_t                         getDepth   (void) const { return m_depth; }
+
+    // bounds of the whole hierarchy
+    Eigen::Vector3f getMin (void) const { return m_nodes.empty() ? Eigen::Vector3f::Zero() : Eigen::Vector3f(m_nodes[0].getMin()); }
+    Eigen::Vector3f getMax (void) const { return m_nodes.empty() ? Eigen::Vector3f::Zero() : Eigen::Vector3f(m_nodes[0].getMax()); }
+
+    // first of the three corners of the triangle at position i of the leaf order
+    const Eigen::Vector3f * getTriangle  (size_t i) const { return &m_corners[3 * i]; }
+    // index of that triangle in the build input, the face index for meshes
+    uint32_t                getPrimitive (size_t i) const { return m_primitives[i]; }
+    // its face, nullptr unless built from a mesh
+    const Face *            getFace      (size_t i) const { return m_faces.empty() ? nullptr : m_faces[m_primitives[i]]; }
+
+    size_t                  memoryUsage  (void) const;
+
+    // expected cost of a query hitting the root under the cost model:
+    // nodes and triangles weighted by the share of the root surface area
+    // they cover
+    float                   sahCost      (void) const;
+
+private:
+    void build(void);
+
+    uint32_t                     m_leafSize;
+    BVHBuildMethod               m_buildMethod;
+    BVHCostModel                 m_costModel;
+    bool                         m_treelets;
+
+    std::vector<FlatBVHNode>     m_nodes;
+    uint32_t                     m_depth;
+    // three per triangle, in leaf order
+    std::vector<Eigen::Vector3f> m_corners;
+    std::vector<uint32_t>        m_primitives;
+    // by build input index
+    std::vector<const Face *>    m_faces;
+
+}; // class FlatBVH
+
+// one hierarchy per mesh, built concurrently as OpenMP tasks with the leaf
+// size, build method, cost model and treelet setting of settings
+std::vector<FlatBVH> buildFlatBVHs(const std::vector<std::shared_ptr<Mesh> > & meshes, const FlatBVH & settings=FlatBVH());
+
+// true if any triangles of the two hierarchies intersect, each placed by
+// its transform
+bool intersect_bvh(const FlatBVH & a, const FlatBVH & b,
+    const Eigen::Affine3f & a_transform=Eigen::Affine3f::Identity(), const Eigen::Affine3f & b_transform=Eigen::Affine3f::Identity());
+
+// Nearest triangle the ray hits at a distance in (0, maxT), with rays in
+// the space the hierarchy was built in. The object is the face hit, nullptr
+// unless built from a mesh, and the barycentrics weigh its corners in the
+// order of Face::getVertex. Rays through shared edges and corners never
+// slip between the triangles meeting there.
+Intersection<const Face> closestHit(const FlatBVH & bvh, const Ray & ray, float maxT=std::numeric_limits<float>::max());
+// true if the ray hits any triangle at a distance in (0, maxT), returning
+// at the first one found; for shadow and occlusion rays
+bool anyHit(const FlatBVH & bvh, const Ray & ray, float maxT=std::numeric_limits<float>::max());
+
+// one query per ray, spread over the OpenMP threads
+void closestHit(const FlatBVH & bvh, const std::vector<Ray> & rays, std::vector<Intersection<const Face> > & hits,
+                float maxT=std::numeric_limits<float>::max());
+void anyHit(const FlatBVH & bvh, const std::vector<Ray> & rays, std::vector<uint8_t> & hits,
+            float maxT=std::numeric_limits<float>::max());
+
+} // namespace mh
+
+#endif /* FLAT_BVH_H */
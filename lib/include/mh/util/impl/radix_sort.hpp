@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include "mh/base/parallel.h"
+
+namespace mh
+{
+
+template <class T, class TKeyFunc>
+void radixSort(std::vector<T> & items, TKeyFunc key, int keyBits)
+{
+    const int    RADIX_BITS = 8;
+    const size_t RADIX      = 1 << RADIX_BITS;
+
+    const size_t n = items.size();
+    if (n < 2 || keyBits <= 0)
+    {
+        return;
+    }
+
+    std::vector<T> tmp(n);
+
+    const int nChunks = std::max(1, std::min(maxThreads(), static_cast<int>(n / 4096) + 1));
+    std::vector<size_t> histograms(nChunks * RADIX);
+
+    for (int shift = 0; shift < keyBits; shift += RADIX_BITS)
+    {
+        std::fill(histograms.begin(), histograms.end(), 0);
+
+        MH_OMP(parallel for schedule(static, 1) num_threads(nChunks))
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+        {
+            size_t   begin = n * chunk / nChunks;
+            size_t   end   = n * (chunk + 1) / nChunks;
+            size_t * hist  = &histograms[chunk * RADIX];
+            for (size_t i = begin; i < end; ++i)
+            {
+                ++hist[(static_cast<uint64_t>(key(items[i])) >> shift) & (RADIX - 1)];
+            }
+        }
+
+        // exclusive scan in (digit, chunk) order keeps equal digits in input order
+        size_t offset = 0;
+        for (size_t digit = 0; digit < RADIX; ++digit)
+        {
+            for (int chunk = 0; chunk < nChunks; ++chunk)
+            {
+                size_t count = histograms[chunk * RADIX + digit];
+                histograms[chunk * RADIX + digit] = offset;
+                offset += count;
+            }
+        }
+
+        MH_OMP(parallel for schedule(static, 1) num_threads(nChunks))
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+        {
+            size_t   begin = n * chunk / nChunks;
+            size_t   end   = n * (chunk + 1) / nChunks;
+            size_t * hist  = &histograms[chunk * RADIX];
+            for (size_t i = begin; i < end; ++i)
+            {
+                tmp[hist[(static_cast<uint64_t>(key(items[i])) >> shift) & (RADIX - 1)]++] = items[i];
+            }
+        }
+
+        items.swap(tmp);
+    }
+}
+
+} // namespace mh
@@ -0,0 +1,140 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mh/base/defs.h"
+
+namespace mh
+{
+
+// Slab allocator for objects of a single type. Objects are constructed in
+// place inside fixed-size slabs that are never moved or resized, so raw
+// pointers to them stay valid for the lifetime of the pool. There is no
+// per-object free: everything is destroyed at once when the pool is cleared
+// or goes out of scope.
+template <class T>
+class ObjectPool
+{
+public:
+    typedef T ObjectType;
+
+    static const size_t DEFAULT_SLAB_SIZE = 4096;
+
+    ObjectPool(size_t slabSize=DEFAULT_SLAB_SIZE)
+        : m_slabSize(slabSize), m_size(0) {}
+    ~ObjectPool() { clear(); }
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool & operator=(const ObjectPool &) = delete;
+
+    template <class... TArgs>
+    T *    create   (TArgs && ... args);
+
+    // make sure the next n objects are carved from a single slab
+    void   reserve  (size_t n);
+
+    void   clear    (void);
+
+    size_t size     (void) const { return m_size; }
+    size_t nSlabs   (void) const { return m_slabs.size(); }
+    size_t capacity (void) const;
+
+protected:
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    struct Slab
+    {
+        std::unique_ptr<Storage[]> data;
+        size_t                     capacity;
+        size_t                     used;
+    };
+
+    void addSlab(size_t capacity);
+
+    std::vector<Slab> m_slabs;
+    size_t            m_slabSize;
+    size_t            m_size;
+
+}; // class ObjectPool
+
+template <class T>
+template <class... TArgs>
+T * ObjectPool<T>::create(TArgs && ... args)
+{
+    if (m_slabs.empty() || m_slabs.back().used == m_slabs.back().capacity)
+    {
+        addSlab(m_slabSize);
+    }
+
+    Slab & slab = m_slabs.back();
+    T * obj = new (&slab.data[slab.used]) T(std::forward<TArgs>(args)...);
+    ++slab.used;
+    ++m_size;
+
+    return obj;
+}
+
+template <class T>
+void ObjectPool<T>::reserve(size_t n)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    if (!m_slabs.empty() && m_slabs.back().capacity - m_slabs.back().used >= n)
+    {
+        return;
+    }
+
+    addSlab(std::max(n, m_slabSize));
+}
+
+template <class T>
+void ObjectPool<T>::clear(void)
+{
+    for (auto slab_it = m_slabs.rbegin(); slab_it != m_slabs.rend(); ++slab_it)
+    {
+        for (size_t i = slab_it->used; i > 0; --i)
+        {
+            reinterpret_cast<T*>(&slab_it->data[i - 1])->~T();
+        }
+    }
+
+    m_slabs.clear();
+    m_size = 0;
+}
+
+template <class T>
+size_t ObjectPool<T>::capacity(void) const
+{
+    size_t capacity = 0;
+    for (const Slab & slab : m_slabs)
+    {
+        capacity += slab.capacity;
+    }
+
+    return capacity;
+}
+
+template <class T>
+void ObjectPool<T>::addSlab(size_t capacity)
+{
+    Slab slab;
+    slab.data     = std::unique_ptr<Storage[]>(new Storage[capacity]);
+    slab.capacity = capacity;
+    slab.used     = 0;
+
+    m_slabs.push_back(std::move(slab));
+}
+
+} // namespace mh
+
+#endif /* OBJECT_POOL_H */
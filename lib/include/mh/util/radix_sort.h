@@ -0,0 +1,21 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstdint>
+#include <vector>
+
+namespace mh
+{
+
+// Stable least-significant-digit radix sort on the lowest keyBits bits of an
+// unsigned integer key, 8 bits per pass. Every pass builds per-thread digit
+// histograms over contiguous chunks, so the scatter stays stable and runs in
+// parallel when OpenMP is enabled.
+template <class T, class TKeyFunc>
+void radixSort(std::vector<T> & items, TKeyFunc key, int keyBits);
+
+} // namespace mh
+
+#include "impl/radix_sort.hpp"
+
+#endif /* RADIX_SORT_H */
@@ -0,0 +1,81 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mh/base/defs.h"
+#include "mh/base/imports.h"
+
+namespace mh
+{
+
+// Fixed set of threads running queued jobs in submission order. Meant for
+// long CPU-only jobs (preparing GL data) that would otherwise stall the
+// render thread; jobs may use OpenMP themselves.
+class WorkerPool
+{
+public:
+    // one thread less than the hardware offers, at least one
+    static WorkerPool & get_instance();
+
+    explicit WorkerPool(size_t nThreads);
+    ~WorkerPool();
+
+    std::future<void> submit(std::function<void()> job);
+
+    size_t nThreads() const { return m_threads.size(); }
+
+private:
+    WorkerPool(const WorkerPool &);
+    void operator=(const WorkerPool &);
+
+    void run();
+
+    std::vector<std::thread>              m_threads;
+    std::deque<std::packaged_task<void()> > m_jobs;
+    std::mutex                            m_mutex;
+    std::condition_variable               m_wakeup;
+    bool                                  m_stop;
+
+}; // class WorkerPool
+
+// A job on the shared pool that can be asked to stop early. The job polls
+// the flag it is handed and returns when it is set. Destroying or
+// reassigning a BackgroundJob cancels the job and waits for it, so whatever
+// the job references has to outlive the BackgroundJob only.
+class BackgroundJob
+{
+public:
+    typedef std::function<void(const std::atomic<bool> & cancelled)> Job;
+
+    BackgroundJob() {}
+    explicit BackgroundJob(Job job);
+    ~BackgroundJob() { cancel(); wait(); }
+
+    BackgroundJob(BackgroundJob && rhs) = default;
+    BackgroundJob & operator=(BackgroundJob && rhs);
+
+    // true until the job finished and was waited for
+    bool valid()  const { return m_future.valid(); }
+    bool ready()  const;
+
+    void cancel();
+    void wait();
+
+private:
+    std::shared_ptr<std::atomic<bool> > m_cancelled;
+    std::future<void>                   m_future;
+
+}; // class BackgroundJob
+
+} // namespace mh
+
+#endif /* WORKER_POOL_H */
@@ -0,0 +1,362 @@
+#include "mh/3d/batch_renderer.h"
+#include "mh/3d/mesh.h"
+#include "mh/base/parallel.h"
+#include "mh/gpu/texture.h"
+
+#include <cstring>
+#include <numeric>
+
+namespace mh
+{
+
+const char * const BATCH_GLSL = R"GLSL(
+layout(location = 7) in uint mhDrawID;
+
+struct MhDraw
+{
+    mat4  modelToWorld;
+    vec3  diffuse;
+    float shininess;
+    vec3  specular;
+    float padding;
+};
+
+layout(std430, binding = 2) readonly buffer MhDraws
+{
+    MhDraw mhDraws[];
+};
+
+#define modelToWorld (mhDraws[mhDrawID].modelToWorld)
+#define diffuse      (mhDraws[mhDrawID].diffuse)
+#define shininess    (mhDraws[mhDrawID].shininess)
+#define specular     (mhDraws[mhDrawID].specular)
+)GLSL";
+
+static_assert(sizeof(BatchRenderer::DrawData) == 96, "DrawData does not match the std430 layout of MhDraw");
+
+constexpr GLuint BatchRenderer::DRAW_ID_LOCATION;
+constexpr GLuint BatchRenderer::DRAWS_BINDING;
+
+namespace
+{
+
+// the diffuse texture a mesh is drawn with, the key of its batch next to
+// the vertex format
+std::shared_ptr<const Texture> textureOf(const Mesh & mesh)
+{
+    if (!mesh.hasTextureCoords()) return nullptr;
+    return mesh.getMaterial()->getDiffuseTexture();
+}
+
+} // anonymous namespace
+
+BatchRenderer::BatchRenderer()
+    : m_nDrawnBatches(0),
+      m_nTextureChanges(0),
+      m_boundTexture(nullptr)
+{
+    glGenBuffers(1, &m_drawIDBufferID);
+    glGenBuffers(1, &m_drawBufferID);
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    clear();
+
+    glDeleteBuffers(1, &m_drawIDBufferID);
+    glDeleteBuffers(1, &m_drawBufferID);
+}
+
+bool BatchRenderer::isSupported()
+{
+    return gl3wIsSupported(4, 3);
+}
+
+void BatchRenderer::clear()
+{
+    for (Batch & batch : m_batches)
+    {
+        deleteBatch(batch);
+    }
+
+    m_batches.clear();
+    m_meshes.clear();
+    m_generations.clear();
+    m_meshBatches.clear();
+}
+
+size_t BatchRenderer::nDraws() const
+{
+    size_t nDraws = 0;
+    for (const Batch & batch : m_batches)
+    {
+        nDraws += batch.nCommands;
+    }
+
+    return nDraws;
+}
+
+void BatchRenderer::draw(const std::vector<std::shared_ptr<Mesh> > & meshes, const std::vector<uint8_t> * visible)
+{
+    bool sameMeshes = meshes.size() == m_meshes.size();
+    for (size_t i = 0; sameMeshes && i < meshes.size(); ++i)
+    {
+        sameMeshes = meshes[i].get() == m_meshes[i];
+    }
+
+    if (!sameMeshes)
+    {
+        rebuild(meshes);
+    } else {
+        std::vector<bool> changed(m_batches.size(), false);
+        bool              regroup = false;
+
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            // a mesh changing its format or texture moves to another
+            // batch; materials change without a new generation
+            regroup = regroup || textureOf(*meshes[i]) != m_batches[m_meshBatches[i]].texture;
+
+            if (meshes[i]->glGeneration() != m_generations[i]) changed[m_meshBatches[i]] = true;
+        }
+
+        if (regroup)
+        {
+            rebuild(meshes);
+        } else {
+            for (size_t b = 0; b < m_batches.size(); ++b)
+            {
+                if (changed[b]) buildBatch(m_batches[b], meshes);
+            }
+        }
+    }
+
+    uploadDraws(meshes);
+
+    m_nDrawnBatches   = 0;
+    m_nTextureChanges = 0;
+    m_boundTexture    = nullptr;
+
+    for (Batch & batch : m_batches)
+    {
+        if (batch.nCommands == 0) continue;
+
+        updateVisibility(batch, visible);
+
+        if (m_nDrawnBatches == 0 || batch.texture.get() != m_boundTexture)
+        {
+            glBindTexture(GL_TEXTURE_2D, batch.texture ? batch.texture->getTextureID() : 0);
+            m_boundTexture = batch.texture.get();
+            ++m_nTextureChanges;
+        }
+        ++m_nDrawnBatches;
+
+        glBindVertexArray(batch.vaoID);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.commandBufferID);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, batch.nCommands, 0);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void BatchRenderer::rebuild(const std::vector<std::shared_ptr<Mesh> > & meshes)
+{
+    clear();
+
+    m_meshes.resize(meshes.size());
+    m_generations.resize(meshes.size());
+    m_meshBatches.resize(meshes.size());
+
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        const std::shared_ptr<const Texture> texture    = textureOf(*meshes[i]);
+        const bool                           hasTexture = texture != nullptr;
+
+        size_t b = 0;
+        while (b < m_batches.size() && m_batches[b].texture != texture) ++b;
+
+        if (b == m_batches.size())
+        {
+            Batch batch;
+            batch.hasTexture      = hasTexture;
+            batch.texture         = texture;
+            batch.format          = MeshGLState::defaultVertexFormat(hasTexture);
+            batch.vaoID           = 0;
+            batch.vertexVboID     = 0;
+            batch.faceVboID       = 0;
+            batch.commandBufferID = 0;
+            batch.nCommands       = 0;
+            m_batches.push_back(batch);
+        }
+
+        m_batches[b].meshes.push_back(i);
+        m_meshes[i]      = meshes[i].get();
+        m_meshBatches[i] = b;
+    }
+
+    // the draw ID of instance 0 of a command is its base instance, the
+    // mesh index
+    std::vector<GLuint> drawIDs(meshes.size());
+    std::iota(drawIDs.begin(), drawIDs.end(), 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_drawIDBufferID);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * drawIDs.size(), drawIDs.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (Batch & batch : m_batches)
+    {
+        buildBatch(batch, meshes);
+    }
+}
+
+void BatchRenderer::buildBatch(Batch & batch, const std::vector<std::shared_ptr<Mesh> > & meshes)
+{
+    deleteBatch(batch);
+
+    std::vector<MeshGLBuild> builds(batch.meshes.size());
+
+    // small meshes dominate, so the meshes go in parallel and every build
+    // runs its own loops serially
+    MH_OMP(parallel for schedule(dynamic))
+    for (size_t k = 0; k < batch.meshes.size(); ++k)
+    {
+        const Mesh &  mesh  = *meshes[batch.meshes[k]];
+        MeshGLBuild & build = builds[k];
+
+        build.vertexMode  = GLVertexMode::INDEXED;
+        build.format      = batch.format;
+        build.hasTexture  = batch.hasTexture;
+        build.dynamic     = false;
+        build.nFaces      = mesh.nFaces();
+        build.nGLVertices = 0;
+
+        prepareMeshGLBuild(mesh, build);
+    }
+
+    std::vector<DrawCommand> commands;
+    size_t nVertexBytes = 0, nFaces = 0;
+
+    for (size_t k = 0; k < builds.size(); ++k)
+    {
+        const MeshGLBuild & build = builds[k];
+
+        m_generations[batch.meshes[k]] = meshes[batch.meshes[k]]->glGeneration();
+
+        if (build.nFaces > 0)
+        {
+            DrawCommand command;
+            command.count         = static_cast<GLuint>(3 * build.nFaces);
+            command.instanceCount = 1;
+            command.firstIndex    = static_cast<GLuint>(3 * nFaces);
+            command.baseVertex    = static_cast<GLint>(nVertexBytes / batch.format.stride());
+            command.baseInstance  = static_cast<GLuint>(batch.meshes[k]);
+            commands.push_back(command);
+        }
+
+        nVertexBytes += build.vertexData.size();
+        nFaces       += build.faceData.size();
+    }
+
+    batch.nCommands = static_cast<GLsizei>(commands.size());
+    batch.commands  = commands;
+    if (commands.empty()) return;
+
+    // concatenated straight into the mapped buffers
+    glGenVertexArrays(1, &batch.vaoID);
+    glBindVertexArray(batch.vaoID);
+
+    glGenBuffers(1, &batch.vertexVboID);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vertexVboID);
+    glBufferData(GL_ARRAY_BUFFER, nVertexBytes, nullptr, GL_STATIC_DRAW);
+    uint8_t * vertexData = static_cast<uint8_t *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, nVertexBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+    glGenBuffers(1, &batch.faceVboID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.faceVboID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Eigen::Vector3i) * nFaces, nullptr, GL_STATIC_DRAW);
+    uint8_t * faceData = static_cast<uint8_t *>(glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(Eigen::Vector3i) * nFaces, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+    for (const MeshGLBuild & build : builds)
+    {
+        std::memcpy(vertexData, build.vertexData.data(), build.vertexData.size());
+        std::memcpy(faceData,   build.faceData.data(),   sizeof(Eigen::Vector3i) * build.faceData.size());
+
+        vertexData += build.vertexData.size();
+        faceData   += sizeof(Eigen::Vector3i) * build.faceData.size();
+    }
+
+    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    batch.format.apply();
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_drawIDBufferID);
+    glEnableVertexAttribArray(DRAW_ID_LOCATION);
+    glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, 0, 0);
+    glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &batch.commandBufferID);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.commandBufferID);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * commands.size(), commands.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void BatchRenderer::deleteBatch(Batch & batch)
+{
+    if (batch.vaoID == 0) return;
+
+    glDeleteVertexArrays(1, &batch.vaoID);
+    glDeleteBuffers     (1, &batch.vertexVboID);
+    glDeleteBuffers     (1, &batch.faceVboID);
+    glDeleteBuffers     (1, &batch.commandBufferID);
+
+    batch.vaoID     = 0;
+    batch.nCommands = 0;
+    batch.commands.clear();
+}
+
+void BatchRenderer::updateVisibility(Batch & batch, const std::vector<uint8_t> * visible)
+{
+    bool changed = false;
+    for (DrawCommand & command : batch.commands)
+    {
+        GLuint instanceCount = !visible || (*visible)[command.baseInstance] ? 1 : 0;
+        if (command.instanceCount != instanceCount)
+        {
+            command.instanceCount = instanceCount;
+            changed = true;
+        }
+    }
+
+    if (!changed) return;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.commandBufferID);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand) * batch.commands.size(), batch.commands.data());
+}
+
+void BatchRenderer::uploadDraws(const std::vector<std::shared_ptr<Mesh> > & meshes)
+{
+    m_draws.resize(meshes.size());
+
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        DrawData & draw = m_draws[i];
+        draw.modelToWorld = transform_to_mtw(meshes[i]->getTransform()).matrix();
+        draw.diffuse      = meshes[i]->getMaterial()->getDiffuse();
+        draw.shininess    = meshes[i]->getMaterial()->getShininess();
+        draw.specular     = meshes[i]->getMaterial()->getSpecular();
+        draw.padding      = 0.0f;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawBufferID);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawData) * m_draws.size(), m_draws.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING, m_drawBufferID);
+}
+
+} // namespace mh
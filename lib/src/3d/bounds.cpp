@@ -0,0 +1,171 @@
+#include "mh/3d/bounds.h"
+#include "mh/3d/vertex.h"
+
+#include <algorithm>
+
+#include "mh/base/parallel.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    using namespace mh;
+
+    // below this many points a reduction is not worth waking up threads
+    const size_t PARALLEL_THRESHOLD = 1 << 16;
+
+    void reducePacked(const Eigen::Vector3f * points, size_t n, Eigen::Vector3f & min, Eigen::Vector3f & max)
+    {
+        setEmptyBounds(min, max);
+
+        size_t i = 0;
+
+#ifdef __SSE__
+        if (n >= 4)
+        {
+            // four packed points are three registers whose lanes hold
+            // (x y z x) (y z x y) (z x y z); every lane keeps its component
+            // over the whole loop, so the lanes are only sorted out at the end
+            const float * data = points[0].data();
+
+            __m128 min_a = _mm_loadu_ps(data + 0), max_a = min_a;
+            __m128 min_b = _mm_loadu_ps(data + 4), max_b = min_b;
+            __m128 min_c = _mm_loadu_ps(data + 8), max_c = min_c;
+
+            for (i = 4; i + 4 <= n; i += 4)
+            {
+                __m128 a = _mm_loadu_ps(data + 3 * i + 0);
+                __m128 b = _mm_loadu_ps(data + 3 * i + 4);
+                __m128 c = _mm_loadu_ps(data + 3 * i + 8);
+
+                min_a = _mm_min_ps(min_a, a); max_a = _mm_max_ps(max_a, a);
+                min_b = _mm_min_ps(min_b, b); max_b = _mm_max_ps(max_b, b);
+                min_c = _mm_min_ps(min_c, c); max_c = _mm_max_ps(max_c, c);
+            }
+
+            float lo_a[4], lo_b[4], lo_c[4], hi_a[4], hi_b[4], hi_c[4];
+            _mm_storeu_ps(lo_a, min_a); _mm_storeu_ps(hi_a, max_a);
+            _mm_storeu_ps(lo_b, min_b); _mm_storeu_ps(hi_b, max_b);
+            _mm_storeu_ps(lo_c, min_c); _mm_storeu_ps(hi_c, max_c);
+
+            min(0) = std::min({lo_a[0], lo_a[3], lo_b[2], lo_c[1]});
+            min(1) = std::min({lo_a[1], lo_b[0], lo_b[3], lo_c[2]});
+            min(2) = std::min({lo_a[2], lo_b[1], lo_c[0], lo_c[3]});
+            max(0) = std::max({hi_a[0], hi_a[3], hi_b[2], hi_c[1]});
+            max(1) = std::max({hi_a[1], hi_b[0], hi_b[3], hi_c[2]});
+            max(2) = std::max({hi_a[2], hi_b[1], hi_c[0], hi_c[3]});
+        }
+#endif
+
+        for (; i < n; ++i)
+        {
+            min = min.cwiseMin(points[i]);
+            max = max.cwiseMax(points[i]);
+        }
+    }
+
+    void reduceVertices(const std::shared_ptr<Vertex> * verts, size_t n, Eigen::Vector3f & min, Eigen::Vector3f & max)
+    {
+        setEmptyBounds(min, max);
+
+#ifdef __SSE__
+        __m128 lo = _mm_set1_ps( std::numeric_limits<float>::infinity());
+        __m128 hi = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Eigen::Vector3f & p = verts[i]->getPosition();
+            __m128 v = _mm_setr_ps(p(0), p(1), p(2), p(2));
+            lo = _mm_min_ps(lo, v);
+            hi = _mm_max_ps(hi, v);
+        }
+
+        float lo_v[4], hi_v[4];
+        _mm_storeu_ps(lo_v, lo);
+        _mm_storeu_ps(hi_v, hi);
+        min = Eigen::Vector3f(lo_v[0], lo_v[1], lo_v[2]);
+        max = Eigen::Vector3f(hi_v[0], hi_v[1], hi_v[2]);
+#else
+        for (size_t i = 0; i < n; ++i)
+        {
+            min = min.cwiseMin(verts[i]->getPosition());
+            max = max.cwiseMax(verts[i]->getPosition());
+        }
+#endif
+    }
+
+    // splits [0, n) into one chunk per thread and merges the chunk boxes
+    template <class T, class TReduceFunc>
+    void reduceParallel(const T * items, size_t n, Eigen::Vector3f & min, Eigen::Vector3f & max, TReduceFunc reduce)
+    {
+        const int nChunks = n < PARALLEL_THRESHOLD ? 1 : maxThreads();
+        if (nChunks == 1)
+        {
+            reduce(items, n, min, max);
+            return;
+        }
+
+        std::vector<Eigen::Vector3f> mins(nChunks), maxs(nChunks);
+
+        MH_OMP(parallel for schedule(static, 1) num_threads(nChunks))
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+        {
+            size_t begin = n * chunk / nChunks;
+            size_t end   = n * (chunk + 1) / nChunks;
+            reduce(items + begin, end - begin, mins[chunk], maxs[chunk]);
+        }
+
+        setEmptyBounds(min, max);
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+        {
+            mergeBounds(mins[chunk], maxs[chunk], min, max);
+        }
+    }
+
+} // anonymous namespace
+
+namespace mh
+{
+
+void computeBounds(const Eigen::Vector3f * points, size_t n, Eigen::Vector3f & min, Eigen::Vector3f & max)
+{
+    reduceParallel(points, n, min, max, reducePacked);
+}
+
+void computeBounds(const std::shared_ptr<Vertex> * verts, size_t n, Eigen::Vector3f & min, Eigen::Vector3f & max)
+{
+    reduceParallel(verts, n, min, max, reduceVertices);
+}
+
+void transformBounds(const Eigen::Affine3f & transform,
+                     const Eigen::Vector3f & min, const Eigen::Vector3f & max,
+                     Eigen::Vector3f & transformedMin, Eigen::Vector3f & transformedMax)
+{
+    if (!(min.array() <= max.array()).all())
+    {
+        setEmptyBounds(transformedMin, transformedMax);
+        return;
+    }
+
+    // every output axis gathers the smaller and the larger product of each
+    // input axis instead of transforming all eight corners
+    const Eigen::Matrix3f linear = transform.linear();
+    transformedMin = transform.translation();
+    transformedMax = transform.translation();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            float a = linear(i, j) * min(j);
+            float b = linear(i, j) * max(j);
+
+            transformedMin(i) += std::min(a, b);
+            transformedMax(i) += std::max(a, b);
+        }
+    }
+}
+
+} // namespace mh
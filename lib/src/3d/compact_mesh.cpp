@@ -0,0 +1,288 @@
+#include "mh/3d/compact_mesh.h"
+#include "mh/3d/bounds.h"
+#include "mh/3d/mesh.h"
+#include "mh/3d/topology.h"
+
+namespace
+{
+    // make_shared control block (vtable pointer plus use and weak counts)
+    const size_t CONTROL_BLOCK_BYTES = sizeof(void*) + 2 * sizeof(int);
+    // bookkeeping glibc malloc keeps in front of every chunk
+    const size_t MALLOC_HEADER_BYTES = 2 * sizeof(size_t);
+
+    template <class T>
+    size_t vectorBytes(const std::vector<T> & vec)
+    {
+        return vec.capacity() * sizeof(T);
+    }
+
+    // elements living in the mesh arena are accounted for by the arena itself,
+    // anything else was allocated on its own with make_shared
+    template <class T>
+    size_t sharedElementBytes(const std::vector<std::shared_ptr<T> > & vec, const std::shared_ptr<mh::MeshArena> & arena)
+    {
+        size_t bytes = vectorBytes(vec);
+        for (const auto & elem : vec)
+        {
+            bool in_arena = !elem.owner_before(arena) && !arena.owner_before(elem);
+            if (!in_arena)
+            {
+                bytes += sizeof(T) + CONTROL_BLOCK_BYTES + MALLOC_HEADER_BYTES;
+            }
+        }
+
+        return bytes;
+    }
+}
+
+namespace mh
+{
+
+constexpr uint32_t CompactMesh::INVALID_INDEX;
+
+void CompactMesh::reserve(size_t nVerts, size_t nFaces)
+{
+    m_positions.reserve(nVerts);
+    m_colors.reserve(nVerts);
+    m_customInts.reserve(nVerts);
+    m_customVecs.reserve(nVerts);
+    m_vertHalfEdge.reserve(nVerts);
+
+    m_normals.reserve(nFaces * 3);
+    m_textureCoords.reserve(nFaces * 3);
+    m_heVertex.reserve(nFaces * 3);
+    m_heTwin.reserve(nFaces * 3);
+    m_heFlags.reserve(nFaces * 3);
+}
+
+uint32_t CompactMesh::addVertex(const Eigen::Vector3f & position)
+{
+    MH_ASSERT(m_positions.size() < INVALID_INDEX);
+
+    m_positions.push_back(position);
+    m_colors.push_back(Eigen::Vector3f(0.0f, 0.0f, 0.0f));
+    m_customInts.push_back(0);
+    m_customVecs.push_back(Eigen::Vector3f(0.0f, 0.0f, 0.0f));
+    m_vertHalfEdge.push_back(INVALID_INDEX);
+
+    return m_positions.size() - 1;
+}
+
+uint32_t CompactMesh::addFace(uint32_t v0, uint32_t v1, uint32_t v2)
+{
+    MH_ASSERT(v0 < nVerts() && v1 < nVerts() && v2 < nVerts());
+
+    uint32_t face = nFaces();
+    uint32_t he   = 3 * face;
+
+    m_heVertex.push_back(v0);
+    m_heVertex.push_back(v1);
+    m_heVertex.push_back(v2);
+
+    m_heTwin.push_back(INVALID_INDEX);
+    m_heTwin.push_back(INVALID_INDEX);
+    m_heTwin.push_back(INVALID_INDEX);
+
+    m_heFlags.resize(m_heFlags.size() + 3, 0);
+
+    // outgoing halfedges, same assignment as the Mesh loaders
+    m_vertHalfEdge[v2] = he + 0;
+    m_vertHalfEdge[v0] = he + 1;
+    m_vertHalfEdge[v1] = he + 2;
+
+    m_normals.resize(m_normals.size() + 3, Eigen::Vector3f(0.0f, 0.0f, 0.0f));
+    m_textureCoords.resize(m_textureCoords.size() + 3, makeFloat2(0.0f, 0.0f));
+
+    return face;
+}
+
+void CompactMesh::getBounds(Eigen::Vector3f & min, Eigen::Vector3f & max) const
+{
+    computeBounds(m_positions.data(), m_positions.size(), min, max);
+}
+
+size_t CompactMesh::memoryUsage() const
+{
+    return vectorBytes(m_positions)
+         + vectorBytes(m_colors)
+         + vectorBytes(m_customInts)
+         + vectorBytes(m_customVecs)
+         + vectorBytes(m_vertHalfEdge)
+         + vectorBytes(m_normals)
+         + vectorBytes(m_textureCoords)
+         + vectorBytes(m_heVertex)
+         + vectorBytes(m_heTwin)
+         + vectorBytes(m_heFlags);
+}
+
+CompactMesh toCompactMesh(const Mesh & mesh)
+{
+    CompactMesh compact(mesh.idx());
+    compact.setName(mesh.getName());
+    compact.getTransform() = mesh.getTransform();
+    if (mesh.getMaterial())
+    {
+        compact.setMaterial(std::make_shared<Material>(*mesh.getMaterial()));
+    }
+
+    compact.reserve(mesh.nVerts(), mesh.nFaces());
+
+    for (size_t i = 0; i < mesh.nVerts(); ++i)
+    {
+        const Vertex * vert = mesh.getVerts()[i].get();
+
+        uint32_t v = compact.addVertex(vert->getPosition());
+        compact.getColors()[v]     = vert->getColor();
+        compact.getCustomInts()[v] = vert->getCustomInt();
+        compact.getCustomVecs()[v] = vert->getCustomVec();
+    }
+
+    // vertices keep their position, idx() need not match it
+    const std::vector<uint32_t> corners = meshCornerVertices(mesh);
+
+    bool hasTextureCoords = false;
+    for (size_t i = 0; i < mesh.nFaces(); ++i)
+    {
+        const Face * face = mesh.getFaces()[i].get();
+
+        uint32_t f = compact.addFace(corners[3 * i + 0], corners[3 * i + 1], corners[3 * i + 2]);
+
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const Wedge * wedge = face->getWedges()[c];
+            compact.getNormals()[3 * f + c] = wedge->getNormal();
+            if (wedge->hasTextureCoords())
+            {
+                compact.getTextureCoords()[3 * f + c] = wedge->getTextureCoords();
+                hasTextureCoords = true;
+            }
+        }
+    }
+    compact.setHasTextureCoords(hasTextureCoords);
+
+    finalizeTopology(compact);
+
+    return compact;
+}
+
+std::unique_ptr<Mesh> toMesh(const CompactMesh & compact)
+{
+    auto mesh = std::make_unique<Mesh>(compact.idx());
+    mesh->setName(compact.getName());
+    mesh->getTransform() = compact.getTransform();
+
+    mesh->reserve(compact.nVerts(), compact.nFaces());
+
+    for (size_t i = 0; i < compact.nVerts(); ++i)
+    {
+        Vertex * vert = mesh->addVertex(compact.getPositions()[i], i);
+        vert->setColor(compact.getColors()[i]);
+        vert->setCustomInt(compact.getCustomInts()[i]);
+        vert->setCustomVec(compact.getCustomVecs()[i]);
+    }
+
+    const auto & verts = mesh->getVerts();
+    for (size_t i = 0; i < compact.nFaces(); ++i)
+    {
+        Face * face = mesh->addFace(verts[compact.faceVertex(i, 0)].get(),
+                                    verts[compact.faceVertex(i, 1)].get(),
+                                    verts[compact.faceVertex(i, 2)].get(), i);
+
+        for (size_t c = 0; c < 3; ++c)
+        {
+            face->getWedges()[c]->setNormal(compact.getNormals()[3 * i + c]);
+            if (compact.hasTextureCoords())
+            {
+                face->getWedges()[c]->setTextureCoords(compact.getTextureCoords()[3 * i + c]);
+            }
+        }
+    }
+
+    // halfedges were appended in the same order, so indices carry over
+    const auto & halfedges = mesh->getHalfEdges();
+    for (size_t i = 0; i < compact.nHalfEdges(); ++i)
+    {
+        uint32_t twin = compact.heTwin(i);
+        halfedges[i]->setTwin(twin != CompactMesh::INVALID_INDEX ? halfedges[twin].get() : nullptr);
+        halfedges[i]->setFlags(compact.getHalfEdgeFlags()[i]);
+    }
+
+    for (size_t i = 0; i < compact.nVerts(); ++i)
+    {
+        uint32_t he = compact.getVertexHalfEdges()[i];
+        verts[i]->setHalfEdge(he != CompactMesh::INVALID_INDEX ? halfedges[he].get() : nullptr);
+    }
+
+    mesh->setMaterial(compact.getMaterial() ? std::make_shared<Material>(*compact.getMaterial())
+                                            : std::make_shared<Material>());
+
+    return mesh;
+}
+
+MeshGLData getMeshGLData(const CompactMesh & mesh)
+{
+    MeshGLData meshGLData;
+
+    // same duplicated per-face layout as getMeshGLData(const Mesh &), but
+    // every attribute is read with a single indexed load
+    size_t nCorners = mesh.nHalfEdges();
+    meshGLData.vertData.resize(nCorners);
+    meshGLData.normalData.resize(nCorners);
+    meshGLData.colorData.resize(nCorners);
+    meshGLData.indexData.resize(nCorners);
+    meshGLData.customIntData.resize(nCorners);
+    meshGLData.customVecData.resize(nCorners);
+    meshGLData.faceData.resize(mesh.nFaces());
+    if (mesh.hasTextureCoords())
+    {
+        meshGLData.textureCoordsData = mesh.getTextureCoords();
+    }
+
+    const std::vector<uint32_t> & heVertex = mesh.getHalfEdgeVertices();
+    for (size_t i = 0; i < nCorners; ++i)
+    {
+        uint32_t v = heVertex[i];
+        meshGLData.vertData[i]      = mesh.getPositions()[v];
+        meshGLData.colorData[i]     = mesh.getColors()[v];
+        meshGLData.indexData[i]     = v;
+        meshGLData.customIntData[i] = mesh.getCustomInts()[v];
+        meshGLData.customVecData[i] = mesh.getCustomVecs()[v];
+    }
+    meshGLData.normalData = mesh.getNormals();
+
+    for (size_t i = 0; i < mesh.nFaces(); ++i)
+    {
+        meshGLData.faceData[i] = {static_cast<int>(i)*3+0,
+                                  static_cast<int>(i)*3+1,
+                                  static_cast<int>(i)*3+2};
+    }
+
+    return meshGLData;
+}
+
+size_t meshMemoryUsage(const Mesh & mesh)
+{
+    size_t bytes = sharedElementBytes(mesh.getVerts(),     mesh.getArena())
+                 + sharedElementBytes(mesh.getFaces(),     mesh.getArena())
+                 + sharedElementBytes(mesh.getHalfEdges(), mesh.getArena())
+                 + sharedElementBytes(mesh.getWedges(),    mesh.getArena());
+
+    const MeshArena & arena = *mesh.getArena();
+    bytes += arena.verts.capacity()     * sizeof(Vertex)
+           + arena.faces.capacity()     * sizeof(Face)
+           + arena.halfedges.capacity() * sizeof(HalfEdge)
+           + arena.wedges.capacity()    * sizeof(Wedge);
+
+    // per-vertex wedge lists are separate heap allocations
+    for (const auto & vert : mesh.getVerts())
+    {
+        if (vert->getWedges().capacity())
+        {
+            bytes += vectorBytes(vert->getWedges()) + MALLOC_HEADER_BYTES;
+        }
+    }
+
+    return bytes;
+}
+
+} // namespace mh
@@ -5,46 +5,6 @@
 namespace mh
 {
 
-const Vertex * Face::getVertex(size_t idx) const
-{
-    MH_ASSERT(idx < 3); // we deal only in triangles in these parts
-
-    switch (idx)
-    {
-        case 0:
-            return getHalfEdge()->getVertex();
-            break;
-        case 1:
-            return getHalfEdge()->getNext()->getVertex();
-            break;
-        case 2:
-            return getHalfEdge()->getNext()->getNext()->getVertex();
-            break;
-    }
-
-    return nullptr;
-}
-
-Vertex * Face::getVertex(size_t idx)
-{
-    MH_ASSERT(idx < 3); // we deal only in triangles in these parts
-
-    switch (idx)
-    {
-        case 0:
-            return getHalfEdge()->getVertex();
-            break;
-        case 1:
-            return getHalfEdge()->getNext()->getVertex();
-            break;
-        case 2:
-            return getHalfEdge()->getNext()->getNext()->getVertex();
-            break;
-    }
-
-    return nullptr;
-}
-
 Eigen::Vector3f Face::getEdge(size_t idx) const
 {
     MH_ASSERT(idx < 3); // we deal only in triangles in these parts
@@ -0,0 +1,96 @@
+#include "mh/3d/frustum.h"
+
+#include "mh/3d/camera.h"
+
+namespace mh
+{
+
+Frustum::Frustum()
+{
+    // 0 >= 0 holds everywhere
+    m_planes.fill(Eigen::Vector4f::Zero());
+}
+
+Frustum Frustum::fromMatrix(const Eigen::Matrix4f & clip)
+{
+    // Gribb & Hartmann: -w <= x, y, z <= w in clip space
+    Frustum frustum;
+    frustum.m_planes[0] = clip.row(3) + clip.row(0);
+    frustum.m_planes[1] = clip.row(3) - clip.row(0);
+    frustum.m_planes[2] = clip.row(3) + clip.row(1);
+    frustum.m_planes[3] = clip.row(3) - clip.row(1);
+    frustum.m_planes[4] = clip.row(3) + clip.row(2);
+    frustum.m_planes[5] = clip.row(3) - clip.row(2);
+
+    for (Eigen::Vector4f & plane : frustum.m_planes)
+    {
+        float length = plane.head<3>().norm();
+        if (length > 0.0f) plane /= length;
+    }
+
+    return frustum;
+}
+
+Frustum Frustum::fromCamera(const Camera & camera)
+{
+    return fromMatrix(camera.getCameraToClip() * camera.getWorldToCamera().matrix());
+}
+
+bool Frustum::intersectsSphere(const Eigen::Vector3f & center, float radius) const
+{
+    for (const Eigen::Vector4f & plane : m_planes)
+    {
+        if (plane.head<3>().dot(center) + plane(3) < -radius) return false;
+    }
+
+    return true;
+}
+
+bool Frustum::intersectsBox(const Eigen::Vector3f & min, const Eigen::Vector3f & max) const
+{
+    for (const Eigen::Vector4f & plane : m_planes)
+    {
+        // the corner furthest along the plane normal
+        Eigen::Vector3f corner(plane(0) >= 0.0f ? max(0) : min(0),
+                               plane(1) >= 0.0f ? max(1) : min(1),
+                               plane(2) >= 0.0f ? max(2) : min(2));
+
+        if (plane.head<3>().dot(corner) + plane(3) < 0.0f) return false;
+    }
+
+    return true;
+}
+
+FrustumTest Frustum::classifyBox(const Eigen::Vector3f & min, const Eigen::Vector3f & max) const
+{
+    FrustumTest result = FrustumTest::INSIDE;
+
+    for (const Eigen::Vector4f & plane : m_planes)
+    {
+        // the corners furthest along and against the plane normal
+        Eigen::Vector3f positive(plane(0) >= 0.0f ? max(0) : min(0),
+                                 plane(1) >= 0.0f ? max(1) : min(1),
+                                 plane(2) >= 0.0f ? max(2) : min(2));
+        Eigen::Vector3f negative(plane(0) >= 0.0f ? min(0) : max(0),
+                                 plane(1) >= 0.0f ? min(1) : max(1),
+                                 plane(2) >= 0.0f ? min(2) : max(2));
+
+        if (plane.head<3>().dot(positive) + plane(3) < 0.0f) return FrustumTest::OUTSIDE;
+        if (plane.head<3>().dot(negative) + plane(3) < 0.0f) result = FrustumTest::INTERSECTS;
+    }
+
+    return result;
+}
+
+void transformBoundingSphere(const Eigen::Affine3f & transform, const Eigen::Vector3f & min, const Eigen::Vector3f & max,
+                             Eigen::Vector3f & center, float & radius)
+{
+    // the largest axis scale bounds any stretch of the box
+    const Eigen::Matrix3f linear = transform.linear();
+    const float scale = std::max(linear.col(0).norm(), std::max(linear.col(1).norm(), linear.col(2).norm()));
+
+    center = transform * ((min + max) / 2.0f);
+    radius = scale * (max - min).norm() / 2.0f;
+}
+
+} // namespace mh
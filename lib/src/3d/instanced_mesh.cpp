@@ -0,0 +1,193 @@
+#include "mh/3d/instanced_mesh.h"
+#include "mh/3d/mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mh/3d/bounds.h"
+
+namespace
+{
+    using namespace mh;
+
+    // one element of the instance buffer, laid out as instanceFormat()
+    struct InstanceData
+    {
+        float   rows[3][4];
+        uint8_t color[4];
+    }; // struct InstanceData
+
+    static_assert(sizeof(InstanceData) == 52, "InstanceData does not match the instance format");
+
+    uint8_t unorm8(float value)
+    {
+        return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+    }
+
+} // anonymous namespace
+
+namespace mh
+{
+
+const char * const INSTANCE_GLSL = R"GLSL(
+uniform bool mhInstanced;
+
+layout(location = 8)  in vec4 mhInstanceRow0;
+layout(location = 9)  in vec4 mhInstanceRow1;
+layout(location = 10) in vec4 mhInstanceRow2;
+layout(location = 11) in vec4 mhInstanceColorAttribute;
+
+mat4 mhModelToWorld(mat4 modelToWorld)
+{
+    if (!mhInstanced) return modelToWorld;
+    return transpose(mat4(mhInstanceRow0, mhInstanceRow1, mhInstanceRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+vec3 mhInstanceColor(vec3 color)
+{
+    return mhInstanced ? color * mhInstanceColorAttribute.rgb : color;
+}
+)GLSL";
+
+constexpr int InstancedMesh::TRANSFORM_LOCATION;
+constexpr int InstancedMesh::INSTANCE_COLOR_LOCATION;
+
+InstancedMesh::InstancedMesh(std::shared_ptr<Mesh> mesh)
+    : m_mesh(mesh)
+    , m_changed(true)
+    , m_instanceVboID(0)
+{}
+
+InstancedMesh::~InstancedMesh()
+{
+    if (m_instanceVboID != 0)
+    {
+        m_mesh->setInstanceBufferGL(0, VertexFormat());
+        glDeleteBuffers(1, &m_instanceVboID);
+    }
+}
+
+const VertexFormat & InstancedMesh::instanceFormat()
+{
+    static const VertexFormat format = VertexFormat()
+        .add      (VertexSemantic::INSTANCE_TRANSFORM_ROW_0, TRANSFORM_LOCATION + 0, GL_FLOAT, 4)
+        .add      (VertexSemantic::INSTANCE_TRANSFORM_ROW_1, TRANSFORM_LOCATION + 1, GL_FLOAT, 4)
+        .add      (VertexSemantic::INSTANCE_TRANSFORM_ROW_2, TRANSFORM_LOCATION + 2, GL_FLOAT, 4)
+        .addUnorm8(VertexSemantic::INSTANCE_COLOR,           INSTANCE_COLOR_LOCATION);
+
+    return format;
+}
+
+size_t InstancedMesh::addInstance(const Eigen::Affine3f & modelToWorld, const Eigen::Vector3f & color)
+{
+    m_modelToWorld.push_back(modelToWorld);
+    m_colors.push_back(color);
+    m_changed = true;
+
+    return m_modelToWorld.size() - 1;
+}
+
+size_t InstancedMesh::addInstance(const Transform & transform, const Eigen::Vector3f & color)
+{
+    return addInstance(transform_to_mtw(transform), color);
+}
+
+void InstancedMesh::setInstance(size_t i, const Eigen::Affine3f & modelToWorld, const Eigen::Vector3f & color)
+{
+    m_modelToWorld[i] = modelToWorld;
+    m_colors[i]       = color;
+    m_changed         = true;
+}
+
+void InstancedMesh::reserve(size_t nInstances)
+{
+    m_modelToWorld.reserve(nInstances);
+    m_colors.reserve(nInstances);
+}
+
+void InstancedMesh::clear()
+{
+    m_modelToWorld.clear();
+    m_colors.clear();
+    m_changed = true;
+}
+
+void InstancedMesh::getBounds(Eigen::Vector3f & min, Eigen::Vector3f & max) const
+{
+    setEmptyBounds(min, max);
+
+    const Mesh & mesh = *m_mesh;
+    for (const Eigen::Affine3f & modelToWorld : m_modelToWorld)
+    {
+        Eigen::Vector3f center;
+        float           radius;
+        transformBoundingSphere(modelToWorld, mesh.getMin(), mesh.getMax(), center, radius);
+
+        mergeBounds(center.array() - radius, center.array() + radius, min, max);
+    }
+}
+
+void InstancedMesh::draw(const Frustum & frustum)
+{
+    const Mesh &          mesh = *m_mesh;
+    const Eigen::Vector3f min  = mesh.getMin();
+    const Eigen::Vector3f max  = mesh.getMax();
+
+    m_candidates.clear();
+    for (size_t i = 0; i < m_modelToWorld.size(); ++i)
+    {
+        Eigen::Vector3f center;
+        float           radius;
+        transformBoundingSphere(m_modelToWorld[i], min, max, center, radius);
+
+        if (frustum.intersectsSphere(center, radius))
+        {
+            m_candidates.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // a still camera over unchanged instances uploads nothing
+    if (m_changed || m_candidates != m_visible)
+    {
+        m_visible.swap(m_candidates);
+
+        m_instanceData.resize(sizeof(InstanceData) * m_visible.size());
+        InstanceData * data = reinterpret_cast<InstanceData *>(m_instanceData.data());
+
+        for (size_t k = 0; k < m_visible.size(); ++k)
+        {
+            const Eigen::Matrix4f & matrix = m_modelToWorld[m_visible[k]].matrix();
+            const Eigen::Vector3f & color  = m_colors[m_visible[k]];
+
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    data[k].rows[r][c] = matrix(r, c);
+                }
+            }
+
+            data[k].color[0] = unorm8(color(0));
+            data[k].color[1] = unorm8(color(1));
+            data[k].color[2] = unorm8(color(2));
+            data[k].color[3] = 255;
+        }
+
+        if (m_instanceVboID == 0)
+        {
+            glGenBuffers(1, &m_instanceVboID);
+            mesh.setInstanceBufferGL(m_instanceVboID, instanceFormat());
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceVboID);
+        glBufferData(GL_ARRAY_BUFFER, m_instanceData.size(), m_instanceData.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        m_changed = false;
+    }
+
+    mesh.drawInstanced(static_cast<GLsizei>(m_visible.size()));
+}
+
+} // namespace mh
@@ -1,136 +1,321 @@
 #include "mh/3d/mesh.h"
+#include "mh/3d/bounds.h"
+#include "mh/3d/topology.h"
+#include "mh/base/parallel.h"
 
-#include <map>
+#include <algorithm>
 #include <memory>
 
-#define COPY_VERTEX(IDX) \
-    std::shared_ptr<Vertex> vert_##IDX; \
-    auto vert_##IDX##_it = vert_idx_map.find(vert_##IDX##_idx); \
-    if (vert_##IDX##_it != vert_idx_map.end()) \
-    { \
-        vert_##IDX = m_verts[vert_##IDX##_it->second]; \
-    } else { \
-        vert_##IDX = std::make_shared<Vertex>(mesh.getVerts()[vert_##IDX##_idx]->getPosition(), mesh.getVerts()[vert_##IDX##_idx]->idx()); \
-        m_verts.push_back(vert_##IDX); \
-        vert_idx_map[vert_##IDX##_idx] = m_verts.size() - 1; \
-    }
-
-#define COPY_VERTEX_SUBMESH(IDX) \
-    std::shared_ptr<Vertex> vert_##IDX; \
-    auto vert_##IDX##_it = vert_idx_map.find(vert_##IDX##_idx); \
-    if (vert_##IDX##_it != vert_idx_map.end()) \
-    { \
-        vert_##IDX = submesh->getVerts()[vert_##IDX##_it->second]; \
-    } else { \
-        vert_##IDX = std::make_shared<Vertex>(mesh.getVerts()[vert_##IDX##_idx]->getPosition(), submesh->getVerts().size()); \
-        submesh->getVerts().push_back(vert_##IDX); \
-        vert_idx_map[vert_##IDX##_idx] = submesh->getVerts().size() - 1; \
+namespace
+{
+    using namespace mh;
+
+    const int UNMAPPED = -1;
+
+    // vertices per cached bounding box block
+    const size_t BOUNDS_BLOCK_SIZE = 4096;
+
+    Vertex * copyVertex(Mesh & dst, const Vertex * src, int idx)
+    {
+        Vertex * vert = dst.addVertex(src->getPosition(), idx);
+        vert->setColor(src->getColor());
+        vert->setCustomInt(src->getCustomInt());
+        vert->setCustomVec(src->getCustomVec());
+
+        return vert;
     }
 
+    void copyWedges(const Face * src, Face * dst)
+    {
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const Wedge * from = src->getWedges()[c];
+                  Wedge * to   = dst->getWedges()[c];
+
+            to->setNormal(from->getNormal());
+            if (from->hasTextureCoords())
+            {
+                to->setTextureCoords(from->getTextureCoords());
+            }
+        }
+    }
+
+    // Extracts the faces of mesh listed in faceIndices into a new mesh.
+    // corners is meshCornerVertices(mesh). remap maps source vertex
+    // positions onto submesh vertex positions; it has to be sized to
+    // mesh.nVerts() and hold UNMAPPED everywhere. Only the entries in
+    // touched are written and they are reset before returning, so a single
+    // table can serve any number of extractions.
+    std::unique_ptr<Mesh> extractSubMesh(const Mesh & mesh,
+                                         const std::vector<uint32_t> & corners,
+                                         const size_t * faceIndices,
+                                         size_t nFaces,
+                                         size_t idx,
+                                         std::vector<int> & remap,
+                                         std::vector<int> & touched)
+    {
+        const auto & faces = mesh.getFaces();
+        const auto & verts = mesh.getVerts();
+
+        // number vertices in order of first use
+        touched.clear();
+        for (size_t i = 0; i < nFaces; ++i)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                const uint32_t vert = corners[3 * faceIndices[i] + c];
+                if (remap[vert] == UNMAPPED)
+                {
+                    remap[vert] = touched.size();
+                    touched.push_back(vert);
+                }
+            }
+        }
+
+        auto submesh = std::make_unique<Mesh>(idx);
+        submesh->reserve(touched.size(), nFaces);
+
+        for (size_t i = 0; i < touched.size(); ++i)
+        {
+            copyVertex(*submesh, verts[touched[i]].get(), i);
+        }
+
+        const auto & newVerts = static_cast<const Mesh &>(*submesh).getVerts();
+        for (size_t i = 0; i < nFaces; ++i)
+        {
+            const Face *     oldFace = faces[faceIndices[i]].get();
+            const uint32_t * corner  = corners.data() + 3 * faceIndices[i];
+
+            Face * face = submesh->addFace(newVerts[remap[corner[0]]].get(),
+                                           newVerts[remap[corner[1]]].get(),
+                                           newVerts[remap[corner[2]]].get(),
+                                           i);
+            copyWedges(oldFace, face);
+        }
+
+        for (int vert : touched)
+        {
+            remap[vert] = UNMAPPED;
+        }
+
+        if (mesh.getMaterial())
+        {
+            submesh->setMaterial(std::make_shared<Material>(*mesh.getMaterial()));
+        }
+
+        finalizeTopology(*submesh);
+
+        return submesh;
+    }
+
+} // anonymous namespace
+
 namespace mh
 {
 
 Mesh::Mesh(const Mesh & mesh)
-    : m_transform(mesh.m_transform),
+    : m_idx(mesh.m_idx),
+      m_arena(std::make_shared<MeshArena>()),
+      m_transform(mesh.m_transform),
       m_dirtyBB(true),
-      m_dirtyGL(true),
       m_gl_state(*this),
       m_pointcloud_gl_state(*this)
 {
-    std::map<size_t, size_t> vert_idx_map;
+    reserve(mesh.nVerts(), mesh.nFaces());
+
+    // idx() of the source need not match the position of a vertex (binary
+    // files, submeshes); copies keep the position, so the corner table of
+    // the source indexes them directly. They are numbered by position.
+    for (size_t i = 0; i < mesh.m_verts.size(); ++i)
+    {
+        copyVertex(*this, mesh.m_verts[i].get(), i);
+    }
+
+    const std::vector<uint32_t> corners = meshCornerVertices(mesh);
     for (size_t i = 0; i < mesh.m_faces.size(); ++i)
     {
-        auto oldFace = mesh.getFaces()[i];
-        auto face = std::make_shared<Face>(i);
-        m_faces.push_back(face);
+        const Face *     oldFace = mesh.m_faces[i].get();
+        const uint32_t * corner  = corners.data() + 3 * i;
+
+        Face * face = addFace(m_verts[corner[0]].get(),
+                              m_verts[corner[1]].get(),
+                              m_verts[corner[2]].get(),
+                              oldFace->idx());
+        copyWedges(oldFace, face);
+    }
 
-        size_t vert_0_idx = oldFace->getVertex(0)->idx();
-        size_t vert_1_idx = oldFace->getVertex(1)->idx();
-        size_t vert_2_idx = oldFace->getVertex(2)->idx();
+    if (mesh.getMaterial())
+    {
+        this->setMaterial(std::make_shared<Material>(*mesh.getMaterial()));
+    }
 
-        COPY_VERTEX(0);
-        COPY_VERTEX(1);
-        COPY_VERTEX(2);
+    finalizeTopology(*this);
+}
 
-        auto he_0 = std::make_shared<HalfEdge>();
-        auto he_1 = std::make_shared<HalfEdge>();
-        auto he_2 = std::make_shared<HalfEdge>();
-        m_halfedges.push_back(he_0);
-        m_halfedges.push_back(he_1);
-        m_halfedges.push_back(he_2);
+std::shared_ptr<Vertex> Mesh::createVertex(const Eigen::Vector3f & position, int idx)
+{
+    return std::shared_ptr<Vertex>(m_arena, m_arena->verts.create(position, idx));
+}
 
-        he_0->setVertex(vert_0.get());
-        he_1->setVertex(vert_1.get());
-        he_2->setVertex(vert_2.get());
+std::shared_ptr<Face> Mesh::createFace(int idx)
+{
+    return std::shared_ptr<Face>(m_arena, m_arena->faces.create(idx));
+}
+
+std::shared_ptr<HalfEdge> Mesh::createHalfEdge()
+{
+    return std::shared_ptr<HalfEdge>(m_arena, m_arena->halfedges.create());
+}
 
-        he_0->setFace(face.get());
-        he_1->setFace(face.get());
-        he_2->setFace(face.get());
+std::shared_ptr<Wedge> Mesh::createWedge(Vertex * vertex, Face * face)
+{
+    return std::shared_ptr<Wedge>(m_arena, m_arena->wedges.create(vertex, face));
+}
 
-        he_0->setNext(he_1.get());
-        he_1->setNext(he_2.get());
-        he_2->setNext(he_0.get());
+Vertex * Mesh::addVertex(const Eigen::Vector3f & position, int idx)
+{
+    dirty();
 
-        vert_2->setHalfEdge(he_0.get());
-        vert_0->setHalfEdge(he_1.get());
-        vert_1->setHalfEdge(he_2.get());
+    m_verts.push_back(createVertex(position, idx));
 
-        face->setHalfEdge(he_0.get());
+    return m_verts.back().get();
+}
 
-        face->getWedges().resize(3);
+Face * Mesh::addFace(Vertex * v0, Vertex * v1, Vertex * v2, int idx)
+{
+    dirty();
+
+    Face * face = m_arena->faces.create(idx);
+    m_faces.push_back(std::shared_ptr<Face>(m_arena, face));
+
+    HalfEdge * he_0 = m_arena->halfedges.create();
+    HalfEdge * he_1 = m_arena->halfedges.create();
+    HalfEdge * he_2 = m_arena->halfedges.create();
+    m_halfedges.push_back(std::shared_ptr<HalfEdge>(m_arena, he_0));
+    m_halfedges.push_back(std::shared_ptr<HalfEdge>(m_arena, he_1));
+    m_halfedges.push_back(std::shared_ptr<HalfEdge>(m_arena, he_2));
+
+    he_0->setVertex(v0);
+    he_1->setVertex(v1);
+    he_2->setVertex(v2);
+
+    he_0->setFace(face);
+    he_1->setFace(face);
+    he_2->setFace(face);
+
+    he_0->setNext(he_1);
+    he_1->setNext(he_2);
+    he_2->setNext(he_0);
+
+    v2->setHalfEdge(he_0);
+    v0->setHalfEdge(he_1);
+    v1->setHalfEdge(he_2);
+
+    face->setHalfEdge(he_0);
+    face->setVertices(v0, v1, v2);
+
+    Wedge * wedge_0 = m_arena->wedges.create(v0, face);
+    Wedge * wedge_1 = m_arena->wedges.create(v1, face);
+    Wedge * wedge_2 = m_arena->wedges.create(v2, face);
+    face->getWedges()[0] = wedge_0;
+    face->getWedges()[1] = wedge_1;
+    face->getWedges()[2] = wedge_2;
+    m_wedges.push_back(std::shared_ptr<Wedge>(m_arena, wedge_0));
+    m_wedges.push_back(std::shared_ptr<Wedge>(m_arena, wedge_1));
+    m_wedges.push_back(std::shared_ptr<Wedge>(m_arena, wedge_2));
+
+    return face;
+}
 
-        auto wedge_0 = std::make_shared<Wedge>(vert_0.get(), face.get());
-        auto wedge_1 = std::make_shared<Wedge>(vert_1.get(), face.get());
-        auto wedge_2 = std::make_shared<Wedge>(vert_2.get(), face.get());
-        face->getWedges()[0] = wedge_0.get();
-        face->getWedges()[1] = wedge_1.get();
-        face->getWedges()[2] = wedge_2.get();
-        m_wedges.push_back(wedge_0);
-        m_wedges.push_back(wedge_1);
-        m_wedges.push_back(wedge_2);
+void Mesh::reserve(size_t nVerts, size_t nFaces)
+{
+    m_verts.reserve(m_verts.size() + nVerts);
+    m_faces.reserve(m_faces.size() + nFaces);
+    m_halfedges.reserve(m_halfedges.size() + 3 * nFaces);
+    m_wedges.reserve(m_wedges.size() + 3 * nFaces);
+
+    m_arena->verts.reserve(nVerts);
+    m_arena->faces.reserve(nFaces);
+    m_arena->halfedges.reserve(3 * nFaces);
+    m_arena->wedges.reserve(3 * nFaces);
+}
 
-        face->getWedges()[0]->setTextureCoords(oldFace->getWedges()[0]->getTextureCoords());
-        face->getWedges()[1]->setTextureCoords(oldFace->getWedges()[1]->getTextureCoords());
-        face->getWedges()[2]->setTextureCoords(oldFace->getWedges()[2]->getTextureCoords());
+void Mesh::setVertexPositions(const std::vector<size_t> & indices, const std::vector<Eigen::Vector3f> & positions)
+{
+    MH_ASSERT(indices.size() == positions.size());
 
-        face->getWedges()[0]->setNormal(oldFace->getWedges()[0]->getNormal());
-        face->getWedges()[1]->setNormal(oldFace->getWedges()[1]->getNormal());
-        face->getWedges()[2]->setNormal(oldFace->getWedges()[2]->getNormal());
+    waitGL();
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        m_verts[indices[i]]->setPosition(positions[i]);
+        markChanged(MeshAttribute::POSITION, indices[i]);
     }
-    this->setMaterial(std::make_shared<Material>(*mesh.getMaterial()));
 }
 
-void Mesh::updateMinMax() const
+void Mesh::markChanged(MeshAttribute attribute, size_t begin, size_t end)
 {
-    if (!m_dirtyBB) return;
+    if (begin >= end) return;
 
-    m_min = m_verts[0]->getPosition();
-    m_max = m_verts[0]->getPosition();
+    waitGL();
 
-    for (size_t i = 1; i < nVerts(); ++i)
+    m_glChanges[attribute].add(begin, end);
+    ++m_glGeneration;
+
+    if (attribute == MeshAttribute::POSITION && !m_dirtyBB)
+    {
+        for (size_t block = begin / BOUNDS_BLOCK_SIZE; block <= (end - 1) / BOUNDS_BLOCK_SIZE; ++block)
+        {
+            m_dirtyBlocks.push_back(block);
+        }
+    }
+}
+
+void Mesh::updateMinMax() const
+{
+    if (m_dirtyBB)
     {
-        m_min(0) = std::min(m_verts[i]->getPosition()(0), m_min(0));
-        m_min(1) = std::min(m_verts[i]->getPosition()(1), m_min(1));
-        m_min(2) = std::min(m_verts[i]->getPosition()(2), m_min(2));
+        const size_t nBlocks = (nVerts() + BOUNDS_BLOCK_SIZE - 1) / BOUNDS_BLOCK_SIZE;
+        m_blockMin.resize(nBlocks);
+        m_blockMax.resize(nBlocks);
+
+        MH_OMP(parallel for schedule(static))
+        for (size_t block = 0; block < nBlocks; ++block)
+        {
+            size_t begin = block * BOUNDS_BLOCK_SIZE;
+            size_t end   = std::min(begin + BOUNDS_BLOCK_SIZE, nVerts());
+            computeBounds(&m_verts[begin], end - begin, m_blockMin[block], m_blockMax[block]);
+        }
+    } else if (!m_dirtyBlocks.empty()) {
+        std::sort(m_dirtyBlocks.begin(), m_dirtyBlocks.end());
+        m_dirtyBlocks.erase(std::unique(m_dirtyBlocks.begin(), m_dirtyBlocks.end()), m_dirtyBlocks.end());
+
+        for (size_t block : m_dirtyBlocks)
+        {
+            size_t begin = block * BOUNDS_BLOCK_SIZE;
+            size_t end   = std::min(begin + BOUNDS_BLOCK_SIZE, nVerts());
+            computeBounds(&m_verts[begin], end - begin, m_blockMin[block], m_blockMax[block]);
+        }
+    } else {
+        return;
+    }
 
-        m_max(0) = std::max(m_verts[i]->getPosition()(0), m_max(0));
-        m_max(1) = std::max(m_verts[i]->getPosition()(1), m_max(1));
-        m_max(2) = std::max(m_verts[i]->getPosition()(2), m_max(2));
+    setEmptyBounds(m_min, m_max);
+    for (size_t block = 0; block < m_blockMin.size(); ++block)
+    {
+        mergeBounds(m_blockMin[block], m_blockMax[block], m_min, m_max);
     }
 
+    m_dirtyBlocks.clear();
     m_dirtyBB = false;
 }
 
 void Mesh::updateGL() const
 {
-    if (!m_dirtyGL) return;
+    m_gl_state.update(m_glChanges);
+    m_pointcloud_gl_state.update(m_glChanges);
 
-    m_gl_state.deleteVBO();
-    m_gl_state.createVBO();
-    m_pointcloud_gl_state.deleteVBO();
-    m_pointcloud_gl_state.createVBO();
-
-    m_dirtyGL = false;
+    m_glChanges.clear();
 }
 
 std::vector<Eigen::Vector3i> meshToFVI(const Mesh & mesh)
@@ -138,90 +323,127 @@ std::vector<Eigen::Vector3i> meshToFVI(const Mesh & mesh)
     std::vector<Eigen::Vector3i> fvi(mesh.nFaces());
     for (size_t i = 0; i < mesh.nFaces(); ++i)
     {
-        fvi[i] = {mesh.getFaces()[i]->getVertex(0)->idx(),
-                  mesh.getFaces()[i]->getVertex(1)->idx(),
-                  mesh.getFaces()[i]->getVertex(2)->idx()};
+        const Face * face = mesh.getFaces()[i].get();
+        fvi[i] = {face->getVertex<0>()->idx(),
+                  face->getVertex<1>()->idx(),
+                  face->getVertex<2>()->idx()};
     }
 
     return fvi;
 }
 
-std::unique_ptr<Mesh> getSubMesh(const Mesh & mesh, const std::vector<size_t> & faceIndices)
+std::vector<uint32_t> meshCornerVertices(const Mesh & mesh)
 {
-    auto submesh = std::make_unique<Mesh>();
+    const auto & verts = mesh.getVerts();
+    const auto & faces = mesh.getFaces();
 
-    std::map<size_t, size_t> vert_idx_map;
-    for (size_t i = 0; i < faceIndices.size(); ++i)
+    std::vector<uint32_t> corners(3 * faces.size());
+
+    // the loaders number vertices by position, then idx() is the answer
+    bool positional = true;
+    for (size_t i = 0; positional && i < verts.size(); ++i)
     {
-        auto oldFace = mesh.getFaces()[faceIndices[i]];
-        auto face = std::make_shared<Face>(i);
-        submesh->getFaces().push_back(face);
+        positional = verts[i]->idx() == static_cast<int>(i);
+    }
 
-        size_t vert_0_idx = oldFace->getVertex(0)->idx();
-        size_t vert_1_idx = oldFace->getVertex(1)->idx();
-        size_t vert_2_idx = oldFace->getVertex(2)->idx();
+    if (positional)
+    {
+        MH_OMP(parallel for schedule(static))
+        for (size_t k = 0; k < corners.size(); ++k)
+        {
+            corners[k] = faces[k / 3]->getVertex(k % 3)->idx();
+        }
+        return corners;
+    }
 
-        COPY_VERTEX_SUBMESH(0);
-        COPY_VERTEX_SUBMESH(1);
-        COPY_VERTEX_SUBMESH(2);
+    // otherwise look the vertices up by address
+    std::vector<std::pair<const Vertex *, uint32_t> > byAddress(verts.size());
+    for (size_t i = 0; i < verts.size(); ++i)
+    {
+        byAddress[i] = std::make_pair(verts[i].get(), static_cast<uint32_t>(i));
+    }
+    std::sort(byAddress.begin(), byAddress.end());
 
-        auto he_0 = std::make_shared<HalfEdge>();
-        auto he_1 = std::make_shared<HalfEdge>();
-        auto he_2 = std::make_shared<HalfEdge>();
-        submesh->getHalfEdges().push_back(he_0);
-        submesh->getHalfEdges().push_back(he_1);
-        submesh->getHalfEdges().push_back(he_2);
+    MH_OMP(parallel for schedule(static))
+    for (size_t k = 0; k < corners.size(); ++k)
+    {
+        const Vertex * vert = faces[k / 3]->getVertex(k % 3);
+        auto it = std::lower_bound(byAddress.begin(), byAddress.end(), std::make_pair(vert, uint32_t(0)));
+        MH_ASSERT(it != byAddress.end() && it->first == vert);
+        corners[k] = it->second;
+    }
 
-        he_0->setVertex(vert_0.get());
-        he_1->setVertex(vert_1.get());
-        he_2->setVertex(vert_2.get());
+    return corners;
+}
 
-        he_0->setFace(face.get());
-        he_1->setFace(face.get());
-        he_2->setFace(face.get());
+std::unique_ptr<Mesh> getSubMesh(const Mesh & mesh, const std::vector<size_t> & faceIndices)
+{
+    std::vector<int> remap(mesh.nVerts(), UNMAPPED);
+    std::vector<int> touched;
 
-        he_0->setNext(he_1.get());
-        he_1->setNext(he_2.get());
-        he_2->setNext(he_0.get());
+    return extractSubMesh(mesh, meshCornerVertices(mesh), faceIndices.data(), faceIndices.size(), 0, remap, touched);
+}
 
-        vert_2->setHalfEdge(he_0.get());
-        vert_0->setHalfEdge(he_1.get());
-        vert_1->setHalfEdge(he_2.get());
+std::vector<std::unique_ptr<Mesh> > splitIntoSubMeshes(const Mesh & mesh, const std::vector<int> & labels)
+{
+    MH_ASSERT(labels.size() == mesh.nFaces());
 
-        face->setHalfEdge(he_0.get());
+    int nLabels = 0;
+    for (int label : labels)
+    {
+        nLabels = std::max(nLabels, label + 1);
+    }
 
-        face->getWedges().resize(3);
+    // bucket the faces by label, keeping their order within a label
+    std::vector<size_t> offsets(nLabels + 1, 0);
+    for (int label : labels)
+    {
+        if (label >= 0) ++offsets[label + 1];
+    }
+    for (int i = 0; i < nLabels; ++i)
+    {
+        offsets[i + 1] += offsets[i];
+    }
 
-        auto wedge_0 = std::make_shared<Wedge>(vert_0.get(), face.get());
-        auto wedge_1 = std::make_shared<Wedge>(vert_1.get(), face.get());
-        auto wedge_2 = std::make_shared<Wedge>(vert_2.get(), face.get());
-        face->getWedges()[0] = wedge_0.get();
-        face->getWedges()[1] = wedge_1.get();
-        face->getWedges()[2] = wedge_2.get();
-        submesh->getWedges().push_back(wedge_0);
-        submesh->getWedges().push_back(wedge_1);
-        submesh->getWedges().push_back(wedge_2);
+    std::vector<size_t> order(offsets[nLabels]);
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < labels.size(); ++i)
+    {
+        if (labels[i] >= 0) order[fill[labels[i]]++] = i;
+    }
 
-        face->getWedges()[0]->setTextureCoords(oldFace->getWedges()[0]->getTextureCoords());
-        face->getWedges()[1]->setTextureCoords(oldFace->getWedges()[1]->getTextureCoords());
-        face->getWedges()[2]->setTextureCoords(oldFace->getWedges()[2]->getTextureCoords());
+    std::vector<std::unique_ptr<Mesh> > submeshes(nLabels);
+    const std::vector<uint32_t>         corners = meshCornerVertices(mesh);
 
-        face->getWedges()[0]->setNormal(oldFace->getWedges()[0]->getNormal());
-        face->getWedges()[1]->setNormal(oldFace->getWedges()[1]->getNormal());
-        face->getWedges()[2]->setNormal(oldFace->getWedges()[2]->getNormal());
+    MH_OMP(parallel)
+    {
+        std::vector<int> remap(mesh.nVerts(), UNMAPPED);
+        std::vector<int> touched;
+
+        MH_OMP(for schedule(dynamic))
+        for (int label = 0; label < nLabels; ++label)
+        {
+            submeshes[label] = extractSubMesh(mesh,
+                                              corners,
+                                              order.data() + offsets[label],
+                                              offsets[label + 1] - offsets[label],
+                                              label,
+                                              remap,
+                                              touched);
+        }
     }
-    submesh->setMaterial(std::make_shared<Material>(*mesh.getMaterial()));
 
-    return submesh;
+    return submeshes;
 }
 
 void recomputeNormalsMesh(Mesh & mesh)
 {
     for (size_t i = 0; i < mesh.getFaces().size(); ++i)
     {
-        auto vertex_0 = mesh.getFaces()[i]->getVertex(0);
-        auto vertex_1 = mesh.getFaces()[i]->getVertex(1);
-        auto vertex_2 = mesh.getFaces()[i]->getVertex(2);
+        const Face * face = mesh.getFaces()[i].get();
+        auto vertex_0 = face->getVertex<0>();
+        auto vertex_1 = face->getVertex<1>();
+        auto vertex_2 = face->getVertex<2>();
 
         Eigen::Vector3f normal = (vertex_1->getPosition() - vertex_0->getPosition()).cross(
                                  (vertex_2->getPosition() - vertex_0->getPosition()));
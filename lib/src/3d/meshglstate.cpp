@@ -1,30 +1,225 @@
 #include "mh/3d/meshglstate.h"
 #include "mh/3d/mesh.h"
 
-#define MH_GEN_ARRAY_BUF(ID, TYPE, SIZE, START, GLTYPE, WIDTH, LOC) \
-    glGenBuffers(1, &ID); \
-    glBindBuffer(GL_ARRAY_BUFFER, ID); \
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TYPE) * SIZE, START, GL_STATIC_DRAW); \
-    \
-    glEnableVertexAttribArray(LOC);\
-    glVertexAttribPointer(LOC, WIDTH, GLTYPE, 0, 0, 0)
-
-#define MH_GEN_ARRAY_BUF_INT(ID, TYPE, SIZE, START, GLTYPE, WIDTH, LOC) \
-    glGenBuffers(1, &ID); \
-    glBindBuffer(GL_ARRAY_BUFFER, ID); \
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TYPE) * SIZE, START, GL_STATIC_DRAW); \
-    \
-    glEnableVertexAttribArray(LOC);\
-    glVertexAttribIPointer(LOC, WIDTH, GLTYPE, 0, 0)
-
-#define MH_GEN_ELEM_ARRAY_BUF(ID, TYPE, SIZE, START) \
-    glGenBuffers(1, &ID); \
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID); \
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(TYPE) * SIZE, START, GL_STATIC_DRAW)
+#include <algorithm>
+#include <cstring>
+
+#include "mh/3d/vertex_packing.h"
+
+#include "mh/base/parallel.h"
+
+#include "mh/gpu/buffer_upload.h"
+
+namespace
+{
+    using namespace mh;
+
+    // below this many GL vertices packing stays on the calling thread
+    const size_t PACK_PARALLEL_THRESHOLD = 16384;
+
+    // FNV-1a over the bit patterns of the wedge attributes
+    uint64_t hashWedge(const Wedge * wedge, bool withTextureCoords)
+    {
+        float values[5] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+        Eigen::Vector3f normal = wedge->getNormal();
+        values[0] = normal(0);
+        values[1] = normal(1);
+        values[2] = normal(2);
+
+        if (withTextureCoords)
+        {
+            float2 textureCoords = wedge->getTextureCoords();
+            values[3] = textureCoords.x;
+            values[4] = textureCoords.y;
+        }
+
+        uint32_t bits[5];
+        std::memcpy(bits, values, sizeof(bits));
+
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t word : bits)
+        {
+            hash ^= word;
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    bool sameWedge(const Wedge * a, const Wedge * b, bool withTextureCoords)
+    {
+        if (a->getNormal() != b->getNormal()) return false;
+        if (!withTextureCoords) return true;
+
+        return a->getTextureCoords().x == b->getTextureCoords().x &&
+               a->getTextureCoords().y == b->getTextureCoords().y;
+    }
+
+    // faceData is the identity, every corner its own GL vertex
+    void buildDuplicatedLayout(const Mesh & mesh, std::vector<Eigen::Vector3i> & faceData)
+    {
+        faceData.resize(mesh.nFaces());
+
+        MH_OMP(parallel for schedule(static))
+        for (size_t i = 0; i < faceData.size(); ++i)
+        {
+            faceData[i] = {static_cast<int>(i)*3+0,
+                           static_cast<int>(i)*3+1,
+                           static_cast<int>(i)*3+2};
+        }
+    }
+
+    // Numbers the distinct wedges of every vertex in order of first
+    // appearance; corners that match an earlier corner take its number.
+    // Fills the GL vertex of every corner, the source corner of every GL
+    // vertex and the GL vertex range of every mesh vertex. Mesh vertices
+    // are numbered by position, as in buildVertexCorners: meshes loaded
+    // from binary files carry the file's Vertex::idx(), which may exceed
+    // nVerts().
+    void buildIndexedLayout(const Mesh & mesh,
+                            std::vector<Eigen::Vector3i> & faceData,
+                            std::vector<uint32_t> & glVertexCorners,
+                            std::vector<uint32_t> & vertexGLOffsets)
+    {
+        const auto & faces            = mesh.getFaces();
+        const bool   hasTextureCoords = mesh.hasTextureCoords();
+        const size_t nVerts           = mesh.nVerts();
+        const size_t nCorners         = 3 * faces.size();
+
+        VertexCorners incidence = buildVertexCorners(mesh);
+
+        std::vector<uint64_t> hashes(nCorners);
+
+        MH_OMP(parallel for schedule(static))
+        for (size_t k = 0; k < nCorners; ++k)
+        {
+            hashes[k] = hashWedge(faces[k / 3]->getWedges()[k % 3], hasTextureCoords);
+        }
+
+        std::vector<uint32_t> localIds(nCorners);
+        vertexGLOffsets.assign(nVerts + 1, 0);
+
+        MH_OMP(parallel for schedule(dynamic, 1024))
+        for (size_t v = 0; v < nVerts; ++v)
+        {
+            const uint32_t * corners = incidence.corners.data() + incidence.offsets[v];
+            const size_t     n       = incidence.offsets[v + 1] - incidence.offsets[v];
+
+            uint32_t nUnique = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint32_t k     = corners[i];
+                const Wedge *  wedge = faces[k / 3]->getWedges()[k % 3];
+
+                localIds[k] = nUnique;
+                for (size_t j = 0; j < i; ++j)
+                {
+                    const uint32_t l = corners[j];
+                    if (hashes[l] == hashes[k] && sameWedge(faces[l / 3]->getWedges()[l % 3], wedge, hasTextureCoords))
+                    {
+                        localIds[k] = localIds[l];
+                        break;
+                    }
+                }
+
+                if (localIds[k] == nUnique)
+                {
+                    ++nUnique;
+                }
+            }
+
+            vertexGLOffsets[v + 1] = nUnique;
+        }
+
+        for (size_t v = 0; v < nVerts; ++v)
+        {
+            vertexGLOffsets[v + 1] += vertexGLOffsets[v];
+        }
+
+        faceData.resize(faces.size());
+        glVertexCorners.resize(vertexGLOffsets[nVerts]);
+
+        // the first corner with a given number is the source of its GL vertex
+        MH_OMP(parallel for schedule(dynamic, 1024))
+        for (size_t v = 0; v < nVerts; ++v)
+        {
+            const uint32_t * corners = incidence.corners.data() + incidence.offsets[v];
+            const size_t     n       = incidence.offsets[v + 1] - incidence.offsets[v];
+
+            uint32_t nSeen = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint32_t k  = corners[i];
+                const uint32_t gl = vertexGLOffsets[v] + localIds[k];
+
+                faceData[k / 3](k % 3) = gl;
+
+                if (localIds[k] == nSeen)
+                {
+                    glVertexCorners[gl] = k;
+                    ++nSeen;
+                }
+            }
+        }
+    }
+
+    // interleaved GL vertices [begin, end) to dst; corners maps GL vertices
+    // to their source corner, empty for the identity
+    void packGLVertices(const Mesh & mesh, const VertexFormat & format, const std::vector<uint32_t> & corners,
+                        const VertexQuantization & quantization, size_t begin, size_t end, uint8_t * dst,
+                        const std::atomic<bool> * cancelled = nullptr)
+    {
+        const auto &   faces  = mesh.getFaces();
+        const size_t   stride = format.stride();
+
+        MH_OMP(parallel for schedule(static) if (end - begin > PACK_PARALLEL_THRESHOLD))
+        for (size_t batch = begin; batch < end; batch += PACK_BATCH_SIZE)
+        {
+            if (cancelled && *cancelled) continue;
+
+            const size_t   n = std::min(PACK_BATCH_SIZE, end - batch);
+            const Vertex * verts [PACK_BATCH_SIZE];
+            const Wedge *  wedges[PACK_BATCH_SIZE];
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                size_t       corner = corners.empty() ? batch + i : corners[batch + i];
+                const Face * face   = faces[corner / 3].get();
+
+                verts[i]  = face->getVertex(corner % 3);
+                wedges[i] = face->getWedges()[corner % 3];
+            }
+
+            packVertices(format, verts, wedges, n, dst + stride * (batch - begin), quantization);
+        }
+    }
+
+} // anonymous namespace
 
 namespace mh
 {
 
+void prepareMeshGLBuild(const Mesh & mesh, MeshGLBuild & build, const std::atomic<bool> * cancelled)
+{
+    if (build.vertexMode == GLVertexMode::INDEXED)
+    {
+        buildIndexedLayout(mesh, build.faceData, build.glVertexCorners, build.vertexGLOffsets);
+        build.nGLVertices = build.glVertexCorners.size();
+    } else {
+        buildDuplicatedLayout(mesh, build.faceData);
+        build.nGLVertices = 3 * build.nFaces;
+    }
+
+    if (cancelled && *cancelled) return;
+
+    // one pass over the GL vertices writes every attribute of a vertex
+    // next to each other
+    build.vertexData.resize(build.nGLVertices * build.format.stride());
+    packGLVertices(mesh, build.format, build.glVertexCorners, build.quantization,
+                   0, build.nGLVertices, build.vertexData.data(), cancelled);
+}
+
 MeshGLState::~MeshGLState()
 {
     deleteVBO();
@@ -32,59 +227,503 @@ MeshGLState::~MeshGLState()
 
 void MeshGLState::createVBO()
 {
-    glGenVertexArrays(1, &m_vaoID);
-    glBindVertexArray(m_vaoID);
+    std::shared_ptr<MeshGLBuild> build = beginBuild();
+    prepareMeshGLBuild(m_mesh, *build);
 
-    MeshGLData meshGLData = getMeshGLData(m_mesh);
+    GLuint vertexVboID, faceVboID;
+    std::unique_ptr<StreamBuffer> stream;
 
-    MH_GEN_ARRAY_BUF     (m_posVboID,        Eigen::Vector3f, m_mesh.nFaces() * 3, &meshGLData.vertData[0](0),      GL_FLOAT,        3, POSITION_LOCATION);
-    MH_GEN_ARRAY_BUF     (m_normalVboID,     Eigen::Vector3f, m_mesh.nFaces() * 3, &meshGLData.normalData[0](0),    GL_FLOAT,        3, NORMAL_LOCATION);
-    MH_GEN_ARRAY_BUF     (m_colorVboID,      Eigen::Vector3f, m_mesh.nFaces() * 3, &meshGLData.colorData[0](0),     GL_FLOAT,        3, COLOR_LOCATION);
-    MH_GEN_ARRAY_BUF_INT (m_indexVboID,      unsigned int,    m_mesh.nFaces() * 3, &meshGLData.indexData[0],        GL_UNSIGNED_INT, 1, INDEX_LOCATION);
+    if (build->dynamic)
+    {
+        stream.reset(new StreamBuffer(build->vertexData.size()));
+        std::memcpy(stream->map(), build->vertexData.data(), build->vertexData.size());
+        stream->unmap();
+
+        vertexVboID = stream->id();
+    } else {
+        glGenBuffers(1, &vertexVboID);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexVboID);
+        glBufferData(GL_ARRAY_BUFFER, build->vertexData.size(), build->vertexData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-    MH_GEN_ARRAY_BUF_INT (m_customIntVboID,  int,             m_mesh.nFaces() * 3, &meshGLData.customIntData[0],    GL_UNSIGNED_INT, 1, CUSTOM_INT_LOCATION);
-    MH_GEN_ARRAY_BUF     (m_customVecVboID,  Eigen::Vector3f, m_mesh.nFaces() * 3, &meshGLData.customVecData[0](0), GL_FLOAT,        3, CUSTOM_VEC_LOCATION);
+    glGenBuffers(1, &faceVboID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, faceVboID);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(Eigen::Vector3i) * build->faceData.size(), build->faceData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 
-    if (m_mesh.hasTextureCoords() && m_mesh.getMaterial()->hasTexture())
+    install(*build, vertexVboID, faceVboID);
+
+    if (stream)
     {
-        MH_GEN_ARRAY_BUF(m_textureVboID, float2, m_mesh.nFaces() * 3, &meshGLData.textureCoordsData[0][0], GL_FLOAT, 2, TEXTURE_LOCATION);
-        m_hasTexture = true;
+        m_baseVertex = static_cast<GLint>(stream->region() * m_nGLVertices);
+        m_stream     = std::move(stream);
     }
+}
 
-    MH_GEN_ELEM_ARRAY_BUF(m_faceVboID, Eigen::Vector3i, m_mesh.nFaces(), &meshGLData.faceData[0](0));
+void MeshGLState::deleteVBO()
+{
+    if (!m_vboCreated) return;
+
+    glDeleteVertexArrays(1, &m_vaoID);
+    glDeleteBuffers     (1, &m_faceVboID);
+
+    if (m_stream)
+    {
+        m_stream.reset();
+    } else {
+        glDeleteBuffers (1, &m_vertexVboID);
+    }
+
+    m_vboCreated = false;
+}
+
+std::shared_ptr<MeshGLBuild> MeshGLState::beginBuild() const
+{
+    const Mesh & mesh = m_mesh;
+
+    std::shared_ptr<MeshGLBuild> build = std::make_shared<MeshGLBuild>();
+    build->vertexMode   = m_vertexMode;
+    build->hasTexture   = mesh.hasTextureCoords() && mesh.getMaterial()->hasTexture();
+    build->format       = activeFormat(build->hasTexture);
+    // a stream region can not be empty
+    build->dynamic      = m_dynamic && mesh.nFaces() > 0;
+    build->quantization = VertexQuantization::fromBounds(mesh.getMin(), mesh.getMax());
+    build->nFaces       = mesh.nFaces();
+    build->nGLVertices  = 0;
+
+    return build;
+}
+
+void MeshGLState::install(MeshGLBuild & build, GLuint vertexVboID, GLuint faceVboID)
+{
+    deleteVBO();
+
+    glGenVertexArrays(1, &m_vaoID);
+    glBindVertexArray(m_vaoID);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexVboID);
+    build.format.apply();
+    if (m_instanceVboID != 0)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceVboID);
+        m_instanceFormat.apply(1);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceVboID);
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+    m_vertexVboID     = vertexVboID;
+    m_faceVboID       = faceVboID;
+
+    m_builtVertexMode = build.vertexMode;
+    m_format          = build.format;
+    m_quantization    = build.quantization;
+    m_hasTexture      = build.hasTexture;
+    m_nGLVertices     = build.nGLVertices;
+    m_nDrawFaces      = build.nFaces;
+    m_vertexCorners   = VertexCorners();
+    m_glVertexCorners.swap(build.glVertexCorners);
+    m_vertexGLOffsets.swap(build.vertexGLOffsets);
+    m_baseVertex      = 0;
+
+    if (build.dynamic && build.vertexMode == GLVertexMode::INDEXED)
+    {
+        m_glFaces.swap(build.faceData);
+    } else {
+        std::vector<Eigen::Vector3i>().swap(m_glFaces);
+    }
+
     m_vboCreated = true;
 }
 
-void MeshGLState::deleteVBO()
+void MeshGLState::update(const MeshChanges & changes)
 {
-    if (!m_vboCreated) return;
+    bool hasTexture = m_mesh.hasTextureCoords() && m_mesh.getMaterial()->hasTexture();
 
-    glDeleteVertexArrays(1, &m_vaoID);
-    glDeleteBuffers     (1, &m_faceVboID);
-    glDeleteBuffers     (1, &m_posVboID);
-    glDeleteBuffers     (1, &m_normalVboID);
-    glDeleteBuffers     (1, &m_colorVboID);
-    glDeleteBuffers     (1, &m_indexVboID);
-    glDeleteBuffers     (1, &m_customIntVboID);
-    glDeleteBuffers     (1, &m_customVecVboID);
+    if (m_pending)
+    {
+        if (!m_async || m_dynamic)
+        {
+            cancelPending();
+            m_deferred.clear();
+            deleteVBO();
+            createVBO();
+            return;
+        }
+
+        // the worker may have read the mesh before these changes; only a
+        // different layout is worth preparing again, attribute changes are
+        // written into the installed buffers
+        if (changes.topology || m_vertexMode != m_pending->vertexMode || hasTexture != m_pending->hasTexture ||
+            activeFormat(hasTexture) != m_pending->format)
+        {
+            startPreparation();
+        } else {
+            m_deferred.merge(changes);
+        }
 
-    if (m_hasTexture)
+        stepPending();
+        if (m_pending || !m_deferred.any()) return;
+
+        // installed, the collected changes go through the usual checks
+        MeshChanges deferred;
+        deferred.clear();
+        std::swap(deferred, m_deferred);
+        update(deferred);
+        return;
+    }
+
+    if (needsRebuild(changes, hasTexture))
     {
-        glDeleteBuffers(1, &m_textureVboID); 
+        if (m_async && !m_dynamic)
+        {
+            startPreparation();
+            stepPending();
+        } else {
+            deleteVBO();
+            createVBO();
+        }
+        return;
     }
 
-    m_vboCreated = false;
+    if (m_stream)
+    {
+        if (changes.any()) streamVertices(changes);
+        return;
+    }
+
+    uploadChanges(changes);
+}
+
+bool MeshGLState::needsRebuild(const MeshChanges & changes, bool hasTexture) const
+{
+    bool wedgesChanged = !changes[MeshAttribute::NORMAL].empty() || !changes[MeshAttribute::TEXTURE_COORDS].empty();
+    bool dynamic       = m_dynamic && m_mesh.nFaces() > 0;
+
+    if (!m_vboCreated || changes.topology || hasTexture != m_hasTexture || m_vertexMode != m_builtVertexMode ||
+        activeFormat(hasTexture) != m_format || dynamic != (m_stream != nullptr))
+    {
+        return true;
+    }
+
+    // streamed vertices are repacked as a whole with fresh quantization
+    if (m_stream)
+    {
+        return m_builtVertexMode == GLVertexMode::INDEXED && wedgesChanged && !layoutHolds(changes);
+    }
+
+    return (m_builtVertexMode == GLVertexMode::INDEXED && wedgesChanged) ||
+           !quantizationHolds(m_format, m_quantization, m_mesh, changes);
+}
+
+void MeshGLState::uploadChanges(const MeshChanges & changes)
+{
+    // a record holds all attributes, so the changes of all attributes are
+    // uploaded together
+    DirtyRanges verts;
+    for (MeshAttribute attribute : {MeshAttribute::POSITION, MeshAttribute::COLOR, MeshAttribute::CUSTOM_INT, MeshAttribute::CUSTOM_VEC})
+    {
+        for (const IndexRange & range : changes[attribute].get())
+        {
+            verts.add(range.begin, range.end);
+        }
+    }
+
+    DirtyRanges faces;
+    for (MeshAttribute attribute : {MeshAttribute::NORMAL, MeshAttribute::TEXTURE_COORDS})
+    {
+        for (const IndexRange & range : changes[attribute].get())
+        {
+            faces.add(range.begin, range.end);
+        }
+    }
+
+    std::vector<IndexRange> runs  = vertexSlots(verts);
+    std::vector<IndexRange> wedge = faceSlots(faces);
+    if (!wedge.empty())
+    {
+        runs.insert(runs.end(), wedge.begin(), wedge.end());
+        std::sort(runs.begin(), runs.end(), [](const IndexRange & a, const IndexRange & b) { return a.begin < b.begin; });
+        coalesceRuns(runs);
+    }
+
+    uploadPackedRuns(GL_ARRAY_BUFFER, m_vertexVboID, runs, m_format.stride(),
+                     [this](size_t begin, size_t end, uint8_t * dst)
+                     {
+                         packGLVertices(m_mesh, m_format, m_glVertexCorners, m_quantization, begin, end, dst);
+                     });
+}
+
+bool MeshGLState::layoutHolds(const MeshChanges & changes) const
+{
+    const Mesh & mesh             = m_mesh;
+    const auto & faces            = mesh.getFaces();
+    const bool   hasTextureCoords = mesh.hasTextureCoords();
+
+    DirtyRanges changed;
+    for (MeshAttribute attribute : {MeshAttribute::NORMAL, MeshAttribute::TEXTURE_COORDS})
+    {
+        for (const IndexRange & range : changes[attribute].get())
+        {
+            changed.add(range.begin, range.end);
+        }
+    }
+
+    // a corner may still differ from other GL vertices of its vertex, that
+    // only costs sharing; it must not differ from the corner its GL vertex
+    // was packed from
+    bool holds = true;
+    for (const IndexRange & range : changed.get())
+    {
+        MH_OMP(parallel for schedule(static) reduction(&&:holds))
+        for (size_t f = range.begin; f < range.end; ++f)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t source = m_glVertexCorners[m_glFaces[f](c)];
+                holds = holds && sameWedge(faces[f]->getWedges()[c], faces[source / 3]->getWedges()[source % 3], hasTextureCoords);
+            }
+        }
+
+        if (!holds) return false;
+    }
+
+    return true;
+}
+
+void MeshGLState::streamVertices(const MeshChanges & changes)
+{
+    if (!quantizationHolds(m_format, m_quantization, m_mesh, changes))
+    {
+        const Mesh & mesh = m_mesh;
+        m_quantization = VertexQuantization::fromBounds(mesh.getMin(), mesh.getMax());
+    }
+
+    // the region was last written nRegions updates ago, so every vertex
+    // is written, not only the changed ones
+    uint8_t * dst = m_stream->map();
+    packGLVertices(m_mesh, m_format, m_glVertexCorners, m_quantization, 0, m_nGLVertices, dst);
+    m_stream->unmap();
+
+    m_baseVertex = static_cast<GLint>(m_stream->region() * m_nGLVertices);
+}
+
+void MeshGLState::startPreparation()
+{
+    cancelPending();
+    // the worker reads the mesh as it is now
+    m_deferred.clear();
+
+    std::shared_ptr<MeshGLBuild> build = beginBuild();
+    const Mesh &                 mesh  = m_mesh;
+
+    m_pending    = build;
+    m_pendingJob = BackgroundJob([build, &mesh](const std::atomic<bool> & cancelled)
+    {
+        prepareMeshGLBuild(mesh, *build, &cancelled);
+    });
+}
+
+void MeshGLState::cancelPending()
+{
+    m_pendingJob = BackgroundJob();
+    m_pendingVertices.reset();
+    m_pendingFaces.reset();
+    m_pending.reset();
+}
+
+void MeshGLState::stepPending()
+{
+    if (m_pendingJob.valid())
+    {
+        if (!m_pendingJob.ready()) return;
+        m_pendingJob.wait();
+    }
+
+    if (!m_pendingVertices)
+    {
+        m_pendingVertices.reset(new ChunkedUpload(m_pending->vertexData.data(), m_pending->vertexData.size()));
+        m_pendingFaces.reset   (new ChunkedUpload(m_pending->faceData.data(),   sizeof(Eigen::Vector3i) * m_pending->faceData.size()));
+    }
+
+    if (!m_pendingVertices->step() || !m_pendingFaces->step()) return;
+
+    install(*m_pending, m_pendingVertices->release(), m_pendingFaces->release());
+
+    m_pendingVertices.reset();
+    m_pendingFaces.reset();
+    m_pending.reset();
+}
+
+VertexFormat MeshGLState::defaultVertexFormat(bool withTextureCoords)
+{
+    VertexFormat format;
+    format.add(VertexSemantic::POSITION,   POSITION_LOCATION,   GL_FLOAT,        3)
+          .add(VertexSemantic::NORMAL,     NORMAL_LOCATION,     GL_FLOAT,        3)
+          .add(VertexSemantic::COLOR,      COLOR_LOCATION,      GL_FLOAT,        3)
+          .add(VertexSemantic::INDEX,      INDEX_LOCATION,      GL_UNSIGNED_INT, 1, true)
+          .add(VertexSemantic::CUSTOM_INT, CUSTOM_INT_LOCATION, GL_UNSIGNED_INT, 1, true)
+          .add(VertexSemantic::CUSTOM_VEC, CUSTOM_VEC_LOCATION, GL_FLOAT,        3);
+
+    if (withTextureCoords)
+    {
+        format.add(VertexSemantic::TEXTURE_COORDS, TEXTURE_LOCATION, GL_FLOAT, 2);
+    }
+
+    return format;
+}
+
+VertexFormat MeshGLState::compactVertexFormat(bool withTextureCoords)
+{
+    VertexFormat format;
+    format.addQuantized (VertexSemantic::POSITION,   POSITION_LOCATION)
+          .addOctahedral(VertexSemantic::NORMAL,     NORMAL_LOCATION)
+          .addUnorm8    (VertexSemantic::COLOR,      COLOR_LOCATION)
+          .add          (VertexSemantic::INDEX,      INDEX_LOCATION,      GL_UNSIGNED_INT, 1, true)
+          .add          (VertexSemantic::CUSTOM_INT, CUSTOM_INT_LOCATION, GL_UNSIGNED_INT, 1, true)
+          .add          (VertexSemantic::CUSTOM_VEC, CUSTOM_VEC_LOCATION, GL_FLOAT,        3);
+
+    if (withTextureCoords)
+    {
+        format.addHalf(VertexSemantic::TEXTURE_COORDS, TEXTURE_LOCATION, 2);
+    }
+
+    return format;
+}
+
+VertexFormat MeshGLState::activeFormat(bool hasTexture) const
+{
+    return m_requestedFormat.empty() ? defaultVertexFormat(hasTexture) : m_requestedFormat;
+}
+
+std::vector<IndexRange> MeshGLState::vertexSlots(const DirtyRanges & verts)
+{
+    std::vector<IndexRange> runs;
+    if (verts.empty()) return runs;
+
+    // indexed GL vertices are grouped by vertex
+    if (m_builtVertexMode == GLVertexMode::INDEXED)
+    {
+        for (const IndexRange & range : verts.get())
+        {
+            runs.push_back({m_vertexGLOffsets[range.begin], m_vertexGLOffsets[range.end]});
+        }
+        coalesceRuns(runs);
+        return runs;
+    }
+
+    // past half the vertices, resolving corners costs more than it saves
+    if (2 * verts.count() >= m_mesh.nVerts())
+    {
+        runs.push_back({0, m_nGLVertices});
+        return runs;
+    }
+
+    if (m_vertexCorners.offsets.empty())
+    {
+        m_vertexCorners = buildVertexCorners(static_cast<const Mesh &>(m_mesh));
+    }
+
+    std::vector<uint32_t> slots;
+    for (const IndexRange & range : verts.get())
+    {
+        for (size_t v = range.begin; v < range.end; ++v)
+        {
+            slots.insert(slots.end(),
+                         m_vertexCorners.corners.begin() + m_vertexCorners.offsets[v],
+                         m_vertexCorners.corners.begin() + m_vertexCorners.offsets[v + 1]);
+        }
+    }
+    std::sort(slots.begin(), slots.end());
+
+    for (uint32_t slot : slots)
+    {
+        if (!runs.empty() && runs.back().end == slot)
+        {
+            ++runs.back().end;
+        } else {
+            runs.push_back({slot, slot + 1});
+        }
+    }
+    coalesceRuns(runs);
+
+    return runs;
+}
+
+std::vector<IndexRange> MeshGLState::faceSlots(const DirtyRanges & faces)
+{
+    std::vector<IndexRange> runs;
+    for (const IndexRange & range : faces.get())
+    {
+        runs.push_back({3 * range.begin, 3 * range.end});
+    }
+    coalesceRuns(runs);
+
+    return runs;
+}
+
+size_t MeshGLState::gpuMemoryUsage() const
+{
+    if (!m_vboCreated) return 0;
+
+    size_t vertexBytes = m_stream ? m_stream->nRegions() * m_stream->regionSize() : m_nGLVertices * m_format.stride();
+
+    return vertexBytes + m_nDrawFaces * sizeof(Eigen::Vector3i);
 }
 
 void MeshGLState::draw()
 {
+    if (!m_vboCreated) return;
+
     glBindVertexArray(m_vaoID);
-    glDrawElements(GL_TRIANGLES, 3 * m_mesh.nFaces(), GL_UNSIGNED_INT, 0);
+    if (m_stream)
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES, 3 * m_nDrawFaces, GL_UNSIGNED_INT, 0, m_baseVertex);
+        m_stream->fence();
+    } else {
+        glDrawElements(GL_TRIANGLES, 3 * m_nDrawFaces, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+}
+
+void MeshGLState::setInstanceBuffer(GLuint bufferID, const VertexFormat & format)
+{
+    if (m_vboCreated)
+    {
+        glBindVertexArray(m_vaoID);
+        if (bufferID != 0)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+            format.apply(1);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        } else {
+            for (const VertexElement & element : m_instanceFormat.elements())
+            {
+                glDisableVertexAttribArray(element.location);
+            }
+        }
+        glBindVertexArray(0);
+    }
+
+    m_instanceVboID  = bufferID;
+    m_instanceFormat = bufferID != 0 ? format : VertexFormat();
+}
+
+void MeshGLState::drawInstanced(GLsizei nInstances)
+{
+    if (!m_vboCreated || nInstances == 0) return;
+
+    glBindVertexArray(m_vaoID);
+    if (m_stream)
+    {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, 3 * m_nDrawFaces, GL_UNSIGNED_INT, 0, nInstances, m_baseVertex);
+        m_stream->fence();
+    } else {
+        glDrawElementsInstanced(GL_TRIANGLES, 3 * m_nDrawFaces, GL_UNSIGNED_INT, 0, nInstances);
+    }
     glBindVertexArray(0);
 }
 
@@ -106,38 +745,32 @@ MeshGLData getMeshGLData(const Mesh & mesh)
         meshGLData.textureCoordsData.resize(mesh.nFaces() * 3);
     }
 
-    // iterate over mesh faces, generate separate vertices for each face
-    for (size_t i = 0; i < mesh.nFaces(); ++i)
-    {
-        meshGLData.vertData[i*3+0]   = mesh.getFaces()[i]->getVertex(0)->getPosition();
-        meshGLData.vertData[i*3+1]   = mesh.getFaces()[i]->getVertex(1)->getPosition();
-        meshGLData.vertData[i*3+2]   = mesh.getFaces()[i]->getVertex(2)->getPosition();
-
-        meshGLData.normalData[i*3+0] = mesh.getFaces()[i]->getWedges()[0]->getNormal();
-        meshGLData.normalData[i*3+1] = mesh.getFaces()[i]->getWedges()[1]->getNormal();
-        meshGLData.normalData[i*3+2] = mesh.getFaces()[i]->getWedges()[2]->getNormal();
+    const bool hasTextureCoords = mesh.hasTextureCoords();
+    const auto & faces = mesh.getFaces();
 
-        meshGLData.colorData[i*3+0]  = mesh.getFaces()[i]->getVertex(0)->getColor();
-        meshGLData.colorData[i*3+1]  = mesh.getFaces()[i]->getVertex(1)->getColor();
-        meshGLData.colorData[i*3+2]  = mesh.getFaces()[i]->getVertex(2)->getColor();
-
-        meshGLData.indexData[i*3+0] = mesh.getFaces()[i]->getVertex(0)->idx();
-        meshGLData.indexData[i*3+1] = mesh.getFaces()[i]->getVertex(1)->idx();
-        meshGLData.indexData[i*3+2] = mesh.getFaces()[i]->getVertex(2)->idx();
+    // iterate over mesh faces, generate separate vertices for each face;
+    // every face writes its own slots, so faces are independent
+    MH_OMP(parallel for schedule(static))
+    for (size_t i = 0; i < faces.size(); ++i)
+    {
+        const Face * face = faces[i].get();
 
-        meshGLData.customIntData[i*3+0] = mesh.getFaces()[i]->getVertex(0)->getCustomInt();
-        meshGLData.customIntData[i*3+1] = mesh.getFaces()[i]->getVertex(1)->getCustomInt();
-        meshGLData.customIntData[i*3+2] = mesh.getFaces()[i]->getVertex(2)->getCustomInt();
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const Vertex * vert  = face->getVertices()[c];
+            const Wedge *  wedge = face->getWedges()[c];
 
-        meshGLData.customVecData[i*3+0] = mesh.getFaces()[i]->getVertex(0)->getCustomVec();
-        meshGLData.customVecData[i*3+1] = mesh.getFaces()[i]->getVertex(1)->getCustomVec();
-        meshGLData.customVecData[i*3+2] = mesh.getFaces()[i]->getVertex(2)->getCustomVec();
+            meshGLData.vertData[i*3+c]      = vert->getPosition();
+            meshGLData.normalData[i*3+c]    = wedge->getNormal();
+            meshGLData.colorData[i*3+c]     = vert->getColor();
+            meshGLData.indexData[i*3+c]     = vert->idx();
+            meshGLData.customIntData[i*3+c] = vert->getCustomInt();
+            meshGLData.customVecData[i*3+c] = vert->getCustomVec();
 
-        if (mesh.hasTextureCoords())
-        {
-            meshGLData.textureCoordsData[i*3+0] = mesh.getFaces()[i]->getWedges()[0]->getTextureCoords();
-            meshGLData.textureCoordsData[i*3+1] = mesh.getFaces()[i]->getWedges()[1]->getTextureCoords();
-            meshGLData.textureCoordsData[i*3+2] = mesh.getFaces()[i]->getWedges()[2]->getTextureCoords();
+            if (hasTextureCoords)
+            {
+                meshGLData.textureCoordsData[i*3+c] = wedge->getTextureCoords();
+            }
         }
 
         meshGLData.faceData[i] = {static_cast<int>(i)*3+0,
@@ -148,4 +781,48 @@ MeshGLData getMeshGLData(const Mesh & mesh)
     return meshGLData;
 }
 
+MeshGLData getIndexedMeshGLData(const Mesh & mesh)
+{
+    MeshGLData meshGLData;
+
+    buildIndexedLayout(mesh, meshGLData.faceData, meshGLData.glVertexCorners, meshGLData.vertexGLOffsets);
+
+    const auto & faces            = mesh.getFaces();
+    const bool   hasTextureCoords = mesh.hasTextureCoords();
+    const size_t nGLVertices      = meshGLData.glVertexCorners.size();
+
+    meshGLData.vertData.resize(nGLVertices);
+    meshGLData.normalData.resize(nGLVertices);
+    meshGLData.colorData.resize(nGLVertices);
+    meshGLData.indexData.resize(nGLVertices);
+    meshGLData.customIntData.resize(nGLVertices);
+    meshGLData.customVecData.resize(nGLVertices);
+    if (hasTextureCoords)
+    {
+        meshGLData.textureCoordsData.resize(nGLVertices);
+    }
+
+    MH_OMP(parallel for schedule(static))
+    for (size_t k = 0; k < nGLVertices; ++k)
+    {
+        const uint32_t corner = meshGLData.glVertexCorners[k];
+        const Vertex * vert   = faces[corner / 3]->getVertices()[corner % 3];
+        const Wedge *  wedge  = faces[corner / 3]->getWedges()[corner % 3];
+
+        meshGLData.vertData[k]      = vert->getPosition();
+        meshGLData.normalData[k]    = wedge->getNormal();
+        meshGLData.colorData[k]     = vert->getColor();
+        meshGLData.indexData[k]     = vert->idx();
+        meshGLData.customIntData[k] = vert->getCustomInt();
+        meshGLData.customVecData[k] = vert->getCustomVec();
+
+        if (hasTextureCoords)
+        {
+            meshGLData.textureCoordsData[k] = wedge->getTextureCoords();
+        }
+    }
+
+    return meshGLData;
+}
+
 } // namespace mh
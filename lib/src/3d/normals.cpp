@@ -0,0 +1,221 @@
+#include "mh/3d/normals.h"
+
+#include "mh/3d/compact_mesh.h"
+#include "mh/3d/mesh.h"
+
+#include "mh/base/parallel.h"
+
+#include "mh/util/radix_sort.h"
+
+namespace
+{
+    using namespace mh;
+
+    int bitsFor(uint64_t n)
+    {
+        int bits = 1;
+        while ((uint64_t(1) << bits) < n) ++bits;
+        return bits;
+    }
+
+    // cornerVertex(k) is the vertex at corner k
+    template <class TCornerVertexFunc>
+    VertexCorners buildIncidence(size_t nCorners, size_t nVerts, TCornerVertexFunc cornerVertex)
+    {
+        VertexCorners incidence;
+
+        // sort (vertex, corner) pairs packed into one word, so the sort
+        // streams through memory instead of looking keys up per corner
+        std::vector<uint64_t> pairs(nCorners);
+
+        MH_OMP(parallel for schedule(static))
+        for (size_t k = 0; k < nCorners; ++k)
+        {
+            pairs[k] = (uint64_t(cornerVertex(k)) << 32) | k;
+        }
+
+        radixSort(pairs, [](uint64_t pair) { return pair >> 32; }, bitsFor(nVerts));
+
+        incidence.corners.resize(nCorners);
+        incidence.offsets.resize(nVerts + 1);
+
+        // vertices v with vertex[i - 1] < v <= vertex[i] start at sorted position i
+        MH_OMP(parallel for schedule(static))
+        for (size_t i = 0; i <= nCorners; ++i)
+        {
+            if (i < nCorners)
+            {
+                incidence.corners[i] = static_cast<uint32_t>(pairs[i]);
+            }
+
+            size_t lo = i == 0        ? 0      : (pairs[i - 1] >> 32) + 1;
+            size_t hi = i == nCorners ? nVerts : (pairs[i] >> 32);
+            for (size_t v = lo; v <= hi; ++v)
+            {
+                incidence.offsets[v] = i;
+            }
+        }
+
+        return incidence;
+    }
+
+    float cornerAngle(const Eigen::Vector3f & p, const Eigen::Vector3f & a, const Eigen::Vector3f & b)
+    {
+        Eigen::Vector3f e_0 = a - p;
+        Eigen::Vector3f e_1 = b - p;
+
+        return std::atan2(e_0.cross(e_1).norm(), e_0.dot(e_1));
+    }
+
+    // cornerPosition(k) is the position of the vertex at corner k,
+    // writeNormal(k, n) stores the result for corner k
+    template <class TCornerPositionFunc, class TWriteNormalFunc>
+    void smoothNormals(size_t nFaces,
+                       const VertexCorners & incidence,
+                       NormalWeighting weighting,
+                       float creaseAngle,
+                       TCornerPositionFunc cornerPosition,
+                       TWriteNormalFunc writeNormal)
+    {
+        std::vector<Eigen::Vector3f> faceNormals(nFaces);
+        std::vector<Eigen::Vector3f> weighted(3 * nFaces);
+
+        MH_OMP(parallel for schedule(static))
+        for (size_t f = 0; f < nFaces; ++f)
+        {
+            const Eigen::Vector3f & p_0 = cornerPosition(3 * f + 0);
+            const Eigen::Vector3f & p_1 = cornerPosition(3 * f + 1);
+            const Eigen::Vector3f & p_2 = cornerPosition(3 * f + 2);
+
+            Eigen::Vector3f normal = (p_1 - p_0).cross(p_2 - p_0);
+            float           area   = 0.5f * normal.norm();
+            normal = area > 0.0f ? Eigen::Vector3f(normal / (2.0f * area)) : Eigen::Vector3f::Zero();
+
+            faceNormals[f] = normal;
+
+            switch (weighting)
+            {
+                case NormalWeighting::UNIFORM:
+                    weighted[3 * f + 0] = normal;
+                    weighted[3 * f + 1] = normal;
+                    weighted[3 * f + 2] = normal;
+                    break;
+                case NormalWeighting::AREA:
+                    weighted[3 * f + 0] = area * normal;
+                    weighted[3 * f + 1] = area * normal;
+                    weighted[3 * f + 2] = area * normal;
+                    break;
+                case NormalWeighting::ANGLE:
+                    weighted[3 * f + 0] = cornerAngle(p_0, p_1, p_2) * normal;
+                    weighted[3 * f + 1] = cornerAngle(p_1, p_2, p_0) * normal;
+                    weighted[3 * f + 2] = cornerAngle(p_2, p_0, p_1) * normal;
+                    break;
+            }
+        }
+
+        const size_t nVerts     = incidence.offsets.size() - 1;
+        const bool   crease     = creaseAngle < static_cast<float>(M_PI);
+        const float  cosCrease  = std::cos(creaseAngle);
+
+        // every corner belongs to exactly one vertex, so each vertex writes
+        // only its own corners
+        MH_OMP(parallel for schedule(dynamic, 1024))
+        for (size_t v = 0; v < nVerts; ++v)
+        {
+            const uint32_t * begin = incidence.corners.data() + incidence.offsets[v];
+            const uint32_t * end   = incidence.corners.data() + incidence.offsets[v + 1];
+
+            if (!crease)
+            {
+                Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+                for (const uint32_t * k = begin; k != end; ++k)
+                {
+                    sum += weighted[*k];
+                }
+
+                float length = sum.norm();
+                for (const uint32_t * k = begin; k != end; ++k)
+                {
+                    writeNormal(*k, length > 0.0f ? Eigen::Vector3f(sum / length) : faceNormals[*k / 3]);
+                }
+                continue;
+            }
+
+            for (const uint32_t * k = begin; k != end; ++k)
+            {
+                const Eigen::Vector3f & own = faceNormals[*k / 3];
+
+                Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+                for (const uint32_t * j = begin; j != end; ++j)
+                {
+                    if (own.dot(faceNormals[*j / 3]) >= cosCrease)
+                    {
+                        sum += weighted[*j];
+                    }
+                }
+
+                float length = sum.norm();
+                writeNormal(*k, length > 0.0f ? Eigen::Vector3f(sum / length) : own);
+            }
+        }
+    }
+
+} // anonymous namespace
+
+namespace mh
+{
+
+VertexCorners buildVertexCorners(const Mesh & mesh)
+{
+    // by position in getVerts(), idx() may lie outside [0, nVerts())
+    const std::vector<uint32_t> corners = meshCornerVertices(mesh);
+
+    return buildIncidence(corners.size(), mesh.nVerts(),
+                          [&corners](size_t k) { return corners[k]; });
+}
+
+VertexCorners buildVertexCorners(const CompactMesh & mesh)
+{
+    return buildIncidence(mesh.nHalfEdges(), mesh.nVerts(),
+                          [&mesh](size_t k) { return mesh.getHalfEdgeVertices()[k]; });
+}
+
+void computeSmoothNormals(Mesh & mesh, NormalWeighting weighting, float creaseAngle)
+{
+    computeSmoothNormals(mesh, buildVertexCorners(mesh), weighting, creaseAngle);
+}
+
+void computeSmoothNormals(Mesh & mesh, const VertexCorners & incidence, NormalWeighting weighting, float creaseAngle)
+{
+    const auto & faces = static_cast<const Mesh &>(mesh).getFaces();
+
+    // the wedges are written through element pointers, which an async GL
+    // rebuild may be reading
+    mesh.waitGL();
+
+    smoothNormals(faces.size(), incidence, weighting, creaseAngle,
+                  [&faces](size_t k) -> const Eigen::Vector3f & { return faces[k / 3]->getVertex(k % 3)->getPosition(); },
+                  [&faces](size_t k, const Eigen::Vector3f & n) { faces[k / 3]->getWedges()[k % 3]->setNormal(n); });
+
+    mesh.markChanged(MeshAttribute::NORMAL, 0, faces.size());
+}
+
+void computeSmoothNormals(CompactMesh & mesh, NormalWeighting weighting, float creaseAngle)
+{
+    computeSmoothNormals(mesh, buildVertexCorners(mesh), weighting, creaseAngle);
+}
+
+void computeSmoothNormals(CompactMesh & mesh, const VertexCorners & incidence, NormalWeighting weighting, float creaseAngle)
+{
+    const std::vector<Eigen::Vector3f> & positions = mesh.getPositions();
+    const std::vector<uint32_t>        & vertices  = mesh.getHalfEdgeVertices();
+          std::vector<Eigen::Vector3f> & normals   = mesh.getNormals();
+
+    normals.resize(mesh.nHalfEdges());
+
+    smoothNormals(mesh.nFaces(), incidence, weighting, creaseAngle,
+                  [&](size_t k) -> const Eigen::Vector3f & { return positions[vertices[k]]; },
+                  [&](size_t k, const Eigen::Vector3f & n) { normals[k] = n; });
+}
+
+} // namespace mh
@@ -1,23 +1,54 @@
 #include "mh/3d/pointcloudglstate.h"
 #include "mh/3d/mesh.h"
 
+#include <algorithm>
+
+#include "mh/3d/vertex_packing.h"
+
+#include "mh/base/parallel.h"
+
+#include "mh/gpu/buffer_upload.h"
 #include "mh/gpu/gpu_util.h"
+#include "mh/gpu/profiler.h"
+
+namespace
+{
+    using namespace mh;
+
+    // below this many vertices packing stays on the calling thread
+    const size_t PACK_PARALLEL_THRESHOLD = 16384;
+
+    // interleaved vertices [begin, end) to dst
+    void packPoints(const Mesh & pointcloud, const VertexFormat & format, const VertexQuantization & quantization,
+                    size_t begin, size_t end, uint8_t * dst, const std::atomic<bool> * cancelled = nullptr)
+    {
+        const auto &   verts  = pointcloud.getVerts();
+        const size_t   stride = format.stride();
+
+        MH_OMP(parallel for schedule(static) if (end - begin > PACK_PARALLEL_THRESHOLD))
+        for (size_t batch = begin; batch < end; batch += PACK_BATCH_SIZE)
+        {
+            if (cancelled && *cancelled) continue;
+
+            const size_t   n = std::min(PACK_BATCH_SIZE, end - batch);
+            const Vertex * batchVerts[PACK_BATCH_SIZE];
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                batchVerts[i] = verts[batch + i].get();
+            }
+
+            packVertices(format, batchVerts, nullptr, n, dst + stride * (batch - begin), quantization);
+        }
+    }
+
+    void prepareBuild(const Mesh & pointcloud, PointcloudGLBuild & build, const std::atomic<bool> * cancelled = nullptr)
+    {
+        build.vertexData.resize(build.nVerts * build.format.stride());
+        packPoints(pointcloud, build.format, build.quantization, 0, build.nVerts, build.vertexData.data(), cancelled);
+    }
 
-#define MH_GEN_ARRAY_BUF(ID, TYPE, SIZE, START, GLTYPE, WIDTH, LOC) \
-    glGenBuffers(1, &ID); \
-    glBindBuffer(GL_ARRAY_BUFFER, ID); \
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TYPE) * SIZE, START, GL_STATIC_DRAW); \
-    \
-    glEnableVertexAttribArray(LOC);\
-    glVertexAttribPointer(LOC, WIDTH, GLTYPE, 0, 0, 0)
-
-#define MH_GEN_ARRAY_BUF_INT(ID, TYPE, SIZE, START, GLTYPE, WIDTH, LOC) \
-    glGenBuffers(1, &ID); \
-    glBindBuffer(GL_ARRAY_BUFFER, ID); \
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TYPE) * SIZE, START, GL_STATIC_DRAW); \
-    \
-    glEnableVertexAttribArray(LOC);\
-    glVertexAttribIPointer(LOC, WIDTH, GLTYPE, 0, 0)
+} // anonymous namespace
 
 namespace mh
 {
@@ -29,22 +60,17 @@ PointcloudGLState::~PointcloudGLState()
 
 void PointcloudGLState::createVBO()
 {
-    glGenVertexArrays(1, &m_vaoID);
-    glBindVertexArray(m_vaoID);
+    std::shared_ptr<PointcloudGLBuild> build = beginBuild();
+    prepareBuild(m_pointcloud, *build);
 
-    PointcloudGLData pointcloudGLData = getPointcloudGLData(m_pointcloud);
+    GLuint vertexVboID;
 
-    MH_GEN_ARRAY_BUF(m_posVboID,        Eigen::Vector3f, m_pointcloud.nVerts(), &pointcloudGLData.vertData[0](0),   GL_FLOAT,          3, POSITION_LOCATION);
-    MH_GEN_ARRAY_BUF(m_colorVboID,      Eigen::Vector3f, m_pointcloud.nVerts(), &pointcloudGLData.colorData[0](0),  GL_FLOAT,          3, COLOR_LOCATION);
-    MH_GEN_ARRAY_BUF_INT(m_indexVboID,  unsigned int,    m_pointcloud.nVerts(), &pointcloudGLData.indexData[0],     GL_UNSIGNED_INT,   1, INDEX_LOCATION);
-
-    MH_GEN_ARRAY_BUF_INT (m_customIntVboID,  int,             m_pointcloud.nFaces() * 3, &pointcloudGLData.customIntData[0],    GL_UNSIGNED_INT, 1, CUSTOM_INT_LOCATION);
-    MH_GEN_ARRAY_BUF     (m_customVecVboID,  Eigen::Vector3f, m_pointcloud.nFaces() * 3, &pointcloudGLData.customVecData[0](0), GL_FLOAT,        3, CUSTOM_VEC_LOCATION);
-
-    glBindVertexArray(0);
+    glGenBuffers(1, &vertexVboID);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexVboID);
+    glBufferData(GL_ARRAY_BUFFER, build->vertexData.size(), build->vertexData.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    m_vboCreated = true;
+    install(*build, vertexVboID);
 }
 
 void PointcloudGLState::deleteVBO()
@@ -52,19 +78,183 @@ void PointcloudGLState::deleteVBO()
     if (!m_vboCreated) return;
 
     glDeleteVertexArrays(1, &m_vaoID);
-    glDeleteBuffers     (1, &m_posVboID);
-    glDeleteBuffers     (1, &m_colorVboID);
-    glDeleteBuffers     (1, &m_indexVboID);
-    glDeleteBuffers     (1, &m_customIntVboID);
-    glDeleteBuffers     (1, &m_customVecVboID);
+    glDeleteBuffers     (1, &m_vertexVboID);
 
     m_vboCreated = false;
 }
 
+std::shared_ptr<PointcloudGLBuild> PointcloudGLState::beginBuild() const
+{
+    const Mesh & pointcloud = m_pointcloud;
+
+    std::shared_ptr<PointcloudGLBuild> build = std::make_shared<PointcloudGLBuild>();
+    build->format       = activeFormat();
+    build->quantization = VertexQuantization::fromBounds(pointcloud.getMin(), pointcloud.getMax());
+    build->nVerts       = pointcloud.nVerts();
+
+    return build;
+}
+
+void PointcloudGLState::install(const PointcloudGLBuild & build, GLuint vertexVboID)
+{
+    deleteVBO();
+
+    glGenVertexArrays(1, &m_vaoID);
+    glBindVertexArray(m_vaoID);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexVboID);
+    build.format.apply();
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_vertexVboID  = vertexVboID;
+    m_format       = build.format;
+    m_quantization = build.quantization;
+    m_nDrawVerts   = build.nVerts;
+
+    m_vboCreated = true;
+}
+
+void PointcloudGLState::update(const MeshChanges & changes)
+{
+    if (m_pending)
+    {
+        if (!m_async)
+        {
+            cancelPending();
+            deleteVBO();
+            createVBO();
+            return;
+        }
+
+        // the worker may have read the point cloud before these changes
+        if (changes.any() || activeFormat() != m_pending->format)
+        {
+            startPreparation();
+        }
+
+        stepPending();
+        return;
+    }
+
+    if (!m_vboCreated || changes.topology || activeFormat() != m_format ||
+        !quantizationHolds(m_format, m_quantization, m_pointcloud, changes))
+    {
+        if (m_async)
+        {
+            startPreparation();
+            stepPending();
+        } else {
+            deleteVBO();
+            createVBO();
+        }
+        return;
+    }
+
+    uploadChanges(changes);
+}
+
+void PointcloudGLState::uploadChanges(const MeshChanges & changes)
+{
+    DirtyRanges verts;
+    for (MeshAttribute attribute : {MeshAttribute::POSITION, MeshAttribute::COLOR, MeshAttribute::CUSTOM_INT, MeshAttribute::CUSTOM_VEC})
+    {
+        for (const IndexRange & range : changes[attribute].get())
+        {
+            verts.add(range.begin, range.end);
+        }
+    }
+
+    std::vector<IndexRange> runs = verts.get();
+    coalesceRuns(runs);
+
+    uploadPackedRuns(GL_ARRAY_BUFFER, m_vertexVboID, runs, m_format.stride(),
+                     [this](size_t begin, size_t end, uint8_t * dst)
+                     {
+                         packPoints(m_pointcloud, m_format, m_quantization, begin, end, dst);
+                     });
+}
+
+void PointcloudGLState::startPreparation()
+{
+    cancelPending();
+
+    std::shared_ptr<PointcloudGLBuild> build      = beginBuild();
+    const Mesh &                       pointcloud = m_pointcloud;
+
+    m_pending    = build;
+    m_pendingJob = BackgroundJob([build, &pointcloud](const std::atomic<bool> & cancelled)
+    {
+        prepareBuild(pointcloud, *build, &cancelled);
+    });
+}
+
+void PointcloudGLState::cancelPending()
+{
+    m_pendingJob = BackgroundJob();
+    m_pendingVertices.reset();
+    m_pending.reset();
+}
+
+void PointcloudGLState::stepPending()
+{
+    if (m_pendingJob.valid())
+    {
+        if (!m_pendingJob.ready()) return;
+        m_pendingJob.wait();
+    }
+
+    if (!m_pendingVertices)
+    {
+        m_pendingVertices.reset(new ChunkedUpload(m_pending->vertexData.data(), m_pending->vertexData.size()));
+    }
+
+    if (!m_pendingVertices->step()) return;
+
+    install(*m_pending, m_pendingVertices->release());
+
+    m_pendingVertices.reset();
+    m_pending.reset();
+}
+
+VertexFormat PointcloudGLState::defaultVertexFormat()
+{
+    VertexFormat format;
+    format.add(VertexSemantic::POSITION,   POSITION_LOCATION,   GL_FLOAT,        3)
+          .add(VertexSemantic::COLOR,      COLOR_LOCATION,      GL_FLOAT,        3)
+          .add(VertexSemantic::INDEX,      INDEX_LOCATION,      GL_UNSIGNED_INT, 1, true)
+          .add(VertexSemantic::CUSTOM_INT, CUSTOM_INT_LOCATION, GL_UNSIGNED_INT, 1, true)
+          .add(VertexSemantic::CUSTOM_VEC, CUSTOM_VEC_LOCATION, GL_FLOAT,        3);
+
+    return format;
+}
+
+VertexFormat PointcloudGLState::compactVertexFormat()
+{
+    VertexFormat format;
+    format.addQuantized(VertexSemantic::POSITION,   POSITION_LOCATION)
+          .addUnorm8   (VertexSemantic::COLOR,      COLOR_LOCATION)
+          .add         (VertexSemantic::INDEX,      INDEX_LOCATION,      GL_UNSIGNED_INT, 1, true)
+          .add         (VertexSemantic::CUSTOM_INT, CUSTOM_INT_LOCATION, GL_UNSIGNED_INT, 1, true)
+          .add         (VertexSemantic::CUSTOM_VEC, CUSTOM_VEC_LOCATION, GL_FLOAT,        3);
+
+    return format;
+}
+
+const VertexFormat & PointcloudGLState::activeFormat() const
+{
+    return m_requestedFormat.empty() ? m_defaultFormat : m_requestedFormat;
+}
+
 void PointcloudGLState::draw()
 {
+    if (!m_vboCreated) return;
+
+    ProfileScope profile("point clouds");
+
     glBindVertexArray(m_vaoID);
-    glDrawArrays(GL_POINTS, 0, m_pointcloud.nVerts());
+    glDrawArrays(GL_POINTS, 0, m_nDrawVerts);
     glBindVertexArray(0);
 }
 
@@ -75,8 +265,8 @@ PointcloudGLData getPointcloudGLData(const Mesh & pointcloud)
     pointcloudGLData.vertData.resize(pointcloud.nVerts());
     pointcloudGLData.colorData.resize(pointcloud.nVerts());
     pointcloudGLData.indexData.resize(pointcloud.nVerts());
-    pointcloudGLData.customIntData.resize(pointcloud.nFaces() * 3);
-    pointcloudGLData.customVecData.resize(pointcloud.nFaces() * 3);
+    pointcloudGLData.customIntData.resize(pointcloud.nVerts());
+    pointcloudGLData.customVecData.resize(pointcloud.nVerts());
 
     for (size_t i = 0; i < pointcloud.nVerts(); ++i)
     {
@@ -0,0 +1,37 @@
+#include "mh/3d/render_queue.h"
+
+#include <algorithm>
+
+#include "mh/util/radix_sort.h"
+
+namespace mh
+{
+
+namespace
+{
+    uint64_t field(uint32_t value, int bits)
+    {
+        const uint64_t maxValue = (uint64_t(1) << bits) - 1;
+        return std::min<uint64_t>(value, maxValue);
+    }
+} // anonymous namespace
+
+uint64_t RenderQueue::makeKey(uint32_t program, uint32_t texture, uint32_t material, float depth)
+{
+    const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+    const float    clamped  = std::min(std::max(depth, 0.0f), 1.0f);
+
+    uint64_t key = field(program, PROGRAM_BITS);
+    key = (key << TEXTURE_BITS)  | field(texture,  TEXTURE_BITS);
+    key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+    key = (key << DEPTH_BITS)    | static_cast<uint32_t>(clamped * maxDepth);
+
+    return key;
+}
+
+void RenderQueue::sort(void)
+{
+    radixSort(m_items, [](const Item & item) { return item.key; }, PROGRAM_BITS + TEXTURE_BITS + MATERIAL_BITS + DEPTH_BITS);
+}
+
+} // namespace mh
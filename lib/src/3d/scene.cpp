@@ -1,26 +1,69 @@
 #include "mh/3d/scene.h"
 
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "mh/3d/bounds.h"
 #include "mh/3d/camera.h"
 
+#include "mh/gpu/profiler.h"
+#include "mh/gpu/upload_scheduler.h"
+
 namespace mh
 {
 
+const char * const SCENE_BLOCKS_GLSL = R"GLSL(
+layout(std140) uniform MhCamera
+{
+    mat4 worldToCamera;
+    mat4 cameraToClip;
+};
+
+layout(std140) uniform MhModel
+{
+    mat4  modelToWorld;
+    vec3  diffuse;
+    float shininess;
+    vec3  specular;
+};
+)GLSL";
+
+static_assert(sizeof(Scene::CameraBlock) == 128, "CameraBlock does not match the std140 layout of MhCamera");
+static_assert(sizeof(Scene::ModelBlock)  == 96,  "ModelBlock does not match the std140 layout of MhModel");
+
+constexpr GLuint Scene::CAMERA_BINDING;
+constexpr GLuint Scene::MODEL_BINDING;
+
 Scene::Scene(void)
+    : m_batching(false)
+    , m_culling(true)
+    , m_sorting(true)
 {}
 
 Scene::Scene(const std::vector<std::shared_ptr<Mesh> > & meshes)
     : m_meshes(meshes)
+    , m_batching(false)
+    , m_culling(true)
+    , m_sorting(true)
 {}
 
 void Scene::addMesh(std::shared_ptr<Mesh> mesh)
 {
     m_meshes.push_back(mesh);
+    clearCullingHierarchy();
+}
+
+void Scene::addInstancedMesh(std::shared_ptr<InstancedMesh> mesh)
+{
+    m_instancedMeshes.push_back(mesh);
 }
 
 void Scene::addMeshes(const std::vector<std::shared_ptr<Mesh> > & meshes)
 {
     m_meshes.reserve(m_meshes.size() + meshes.size());
     m_meshes.insert(m_meshes.end(), meshes.begin(), meshes.end());
+    clearCullingHierarchy();
 }
 
 Eigen::Vector3f Scene::getCenter(void)
@@ -28,53 +71,207 @@ Eigen::Vector3f Scene::getCenter(void)
     return m_center;
 }
 
-Eigen::Vector3f Scene::getMin(void) const
+void Scene::getBounds(Eigen::Vector3f & min, Eigen::Vector3f & max) const
 {
-    Eigen::Vector3f min(0.0f, 0.0f, 0.0f);
-    if (m_meshes.size())
+    if (m_meshes.empty() && m_instancedMeshes.empty())
     {
-        min = m_meshes[0]->getMin();
+        min = Eigen::Vector3f::Zero();
+        max = Eigen::Vector3f::Zero();
+        return;
+    }
 
-        for (size_t i = 1; i < m_meshes.size(); ++i)
-        {
-            min = min.array().min(m_meshes[i]->getMin().array()).matrix();
-        }
+    // meshes keep their boxes cached, so this only rescans meshes that changed
+    setEmptyBounds(min, max);
+    for (size_t i = 0; i < m_meshes.size(); ++i)
+    {
+        mergeBounds(m_meshes[i]->getMin(), m_meshes[i]->getMax(), min, max);
     }
 
+    for (size_t i = 0; i < m_instancedMeshes.size(); ++i)
+    {
+        Eigen::Vector3f instancesMin, instancesMax;
+        m_instancedMeshes[i]->getBounds(instancesMin, instancesMax);
+        mergeBounds(instancesMin, instancesMax, min, max);
+    }
+}
+
+Eigen::Vector3f Scene::getMin(void) const
+{
+    Eigen::Vector3f min, max;
+    getBounds(min, max);
+
     return min;
 }
 
 Eigen::Vector3f Scene::getMax(void) const
 {
-    Eigen::Vector3f max(0.0f, 0.0f, 0.0f);
-    if (m_meshes.size())
-    {
-        max = m_meshes[0]->getMax();
-
-        for (size_t i = 1; i < m_meshes.size(); ++i)
-        {
-            max = max.array().max(m_meshes[i]->getMax().array()).matrix();
-        }
-    }
+    Eigen::Vector3f min, max;
+    getBounds(min, max);
 
     return max;
 }
 
 void Scene::draw(std::shared_ptr<Shader> shader, std::shared_ptr<Camera> camera)
 {
+    ProfileScope profile("scene draw");
+
+    UploadScheduler::get_instance().beginFrame();
+
     shader->use();
-    shader->setUniform("worldToCamera", camera->getWorldToCamera());
-    shader->setUniform("cameraToClip",  camera->getCameraToClip());
 
-    for (size_t i = 0; i < m_meshes.size(); ++i)
+    if (shader->bindUniformBlock("MhCamera", CAMERA_BINDING))
+    {
+        if (!m_cameraBlock) m_cameraBlock.reset(new UniformBuffer(sizeof(CameraBlock)));
+
+        CameraBlock & block = m_cameraBlock->block<CameraBlock>(0);
+        block.worldToCamera = camera->getWorldToCamera().matrix();
+        block.cameraToClip  = camera->getCameraToClip();
+
+        m_cameraBlock->upload();
+        m_cameraBlock->bind(CAMERA_BINDING, 0);
+    } else {
+        shader->setUniform("worldToCamera", camera->getWorldToCamera());
+        shader->setUniform("cameraToClip",  camera->getCameraToClip());
+    }
+
+    const Frustum frustum = Frustum::fromCamera(*camera);
+    cull(frustum);
+
+    const bool   batching = isBatching();
+    const size_t nModels  = (batching ? 0 : m_meshes.size()) + m_instancedMeshes.size();
+
+    // model i is mesh i, followed by the instanced meshes, whose instances
+    // carry their own transforms
+    auto modelToWorldOf = [this, batching](size_t i)
+    {
+        size_t nMeshes = batching ? 0 : m_meshes.size();
+        return i < nMeshes ? transform_to_mtw(m_meshes[i]->getTransform()) : Eigen::Affine3f::Identity();
+    };
+    auto materialOf = [this, batching](size_t i)
+    {
+        size_t nMeshes = batching ? 0 : m_meshes.size();
+        return i < nMeshes ? m_meshes[i]->getMaterial() : m_instancedMeshes[i - nMeshes]->getMesh()->getMaterial();
+    };
+
+    const bool modelBlocks = shader->bindUniformBlock("MhModel", MODEL_BINDING) && nModels > 0;
+    if (modelBlocks)
     {
-        shader->setUniform("modelToWorld", transform_to_mtw(m_meshes[i]->getTransform()));
+        if (!m_modelBlocks) m_modelBlocks.reset(new UniformBuffer(sizeof(ModelBlock), nModels));
+        if (m_modelBlocks->nBlocks() != nModels) m_modelBlocks->resize(nModels);
 
-        shader->setUniform("diffuse", m_meshes[i]->getMaterial()->getDiffuse());
-        shader->setUniform("specular", m_meshes[i]->getMaterial()->getSpecular());
-        shader->setUniform("shininess", m_meshes[i]->getMaterial()->getShininess());
+        for (size_t i = 0; i < nModels; ++i)
+        {
+            std::shared_ptr<Material> material = materialOf(i);
+
+            ModelBlock & block = m_modelBlocks->block<ModelBlock>(i);
+            block.modelToWorld = modelToWorldOf(i).matrix();
+            block.diffuse      = material->getDiffuse();
+            block.shininess    = material->getShininess();
+            block.specular     = material->getSpecular();
+        }
+
+        m_modelBlocks->upload();
+    }
+
+    // resolved once instead of per mesh
+    const UniformHandle<Eigen::Affine3f> modelToWorld = shader->uniform<Eigen::Affine3f>("modelToWorld");
+    const UniformHandle<Eigen::Vector3f> diffuse      = shader->uniform<Eigen::Vector3f>("diffuse");
+    const UniformHandle<Eigen::Vector3f> specular     = shader->uniform<Eigen::Vector3f>("specular");
+    const UniformHandle<float>           shininess    = shader->uniform<float>("shininess");
+    const UniformHandle<int>             instanced    = shader->uniform<int>("mhInstanced");
+
+    const UniformHandle<int>             diffuseTexture = shader->uniform<int>("diffuseTexture");
+
+    m_renderStats = RenderStats();
+    m_renderStats.programChanges = 1;
+
+    if (diffuseTexture.valid())
+    {
+        shader->setUniform(diffuseTexture, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // state of the previous draw, uniforms and textures are only set when
+    // it changes
+    const Material * boundMaterial = nullptr;
+    const Texture *  boundTexture  = nullptr;
+    bool             bound         = false;
+
+    auto setModel = [&](size_t i)
+    {
+        std::shared_ptr<Material> material = materialOf(i);
+        const Texture *           texture  = material->getDiffuseTexture().get();
+
+        const bool materialChanged = !bound || material.get() != boundMaterial;
+        const bool textureChanged  = !bound || texture != boundTexture;
+
+        if (textureChanged)
+        {
+            ++m_renderStats.textureChanges;
+            if (diffuseTexture.valid()) glBindTexture(GL_TEXTURE_2D, texture ? texture->getTextureID() : 0);
+        }
+        if (materialChanged) ++m_renderStats.materialChanges;
+
+        boundMaterial = material.get();
+        boundTexture  = texture;
+        bound         = true;
+        ++m_renderStats.draws;
+
+        if (modelBlocks)
+        {
+            m_modelBlocks->bind(MODEL_BINDING, i);
+            return;
+        }
+
+        shader->setUniform(modelToWorld, modelToWorldOf(i));
+        if (materialChanged)
+        {
+            shader->setUniform(diffuse,   material->getDiffuse());
+            shader->setUniform(specular,  material->getSpecular());
+            shader->setUniform(shininess, material->getShininess());
+        }
+    };
+
+    if (batching)
+    {
+        if (!m_batchRenderer) m_batchRenderer.reset(new BatchRenderer());
+        m_batchRenderer->draw(m_meshes, &m_visible);
 
-        m_meshes[i]->draw();
+        // one draw per batch, textures are bound per batch
+        m_renderStats.draws          += m_batchRenderer->nDrawnBatches();
+        m_renderStats.textureChanges += m_batchRenderer->nTextureChanges();
+        if (m_batchRenderer->nDrawnBatches() > 0)
+        {
+            boundTexture = m_batchRenderer->boundTexture();
+            bound        = true;
+        }
+    } else {
+        shader->setUniform(instanced, 0);
+
+        queueMeshes(camera->getWorldToCamera());
+        for (const RenderQueue::Item & item : m_renderQueue.items())
+        {
+            setModel(item.index);
+            m_meshes[item.index]->draw();
+        }
+    }
+
+    if (!m_instancedMeshes.empty())
+    {
+        const size_t first = nModels - m_instancedMeshes.size();
+
+        shader->setUniform(instanced, 1);
+
+        for (size_t i = 0; i < m_instancedMeshes.size(); ++i)
+        {
+            setModel(first + i);
+            m_instancedMeshes[i]->draw(m_culling ? frustum : Frustum());
+
+            m_cullingStats.instancesDrawn  += m_instancedMeshes[i]->nVisible();
+            m_cullingStats.instancesCulled += m_instancedMeshes[i]->nInstances() - m_instancedMeshes[i]->nVisible();
+        }
+
+        shader->setUniform(instanced, 0);
     }
 
     glUseProgram(0);
@@ -95,7 +292,219 @@ void Scene::centerToCenterOfMass(void)
 void Scene::reset(void)
 {
     m_meshes.clear();
+    m_instancedMeshes.clear();
+    m_batchRenderer.reset();
+    m_renderQueue.clear();
+    clearCullingHierarchy();
     m_center = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
 }
 
+void Scene::buildCullingHierarchy(void)
+{
+    clearCullingHierarchy();
+
+    m_cullingMin.resize(m_meshes.size());
+    m_cullingMax.resize(m_meshes.size());
+
+    for (size_t i = 0; i < m_meshes.size(); ++i)
+    {
+        transformBounds(transform_to_mtw(m_meshes[i]->getTransform()), m_meshes[i]->getMin(), m_meshes[i]->getMax(),
+                        m_cullingMin[i], m_cullingMax[i]);
+
+        // empty meshes are never drawn
+        if ((m_cullingMin[i].array() <= m_cullingMax[i].array()).all())
+        {
+            m_cullingOrder.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    if (m_cullingOrder.empty())
+    {
+        // a lone empty leaf, so the hierarchy counts as built
+        m_cullingNodes.push_back({Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), 0, 0, 0});
+        return;
+    }
+
+    m_cullingNodes.reserve(2 * m_cullingOrder.size());
+    buildCullingNode(0, static_cast<uint32_t>(m_cullingOrder.size()));
+}
+
+uint32_t Scene::buildCullingNode(uint32_t first, uint32_t count)
+{
+    Eigen::Vector3f min, max, centerMin, centerMax;
+    setEmptyBounds(min, max);
+    setEmptyBounds(centerMin, centerMax);
+
+    for (uint32_t k = first; k < first + count; ++k)
+    {
+        const uint32_t        mesh   = m_cullingOrder[k];
+        const Eigen::Vector3f center = (m_cullingMin[mesh] + m_cullingMax[mesh]) / 2.0f;
+
+        mergeBounds(m_cullingMin[mesh], m_cullingMax[mesh], min, max);
+        mergeBounds(center, center, centerMin, centerMax);
+    }
+
+    // the node goes in before its children, right is filled in after them
+    const uint32_t index = static_cast<uint32_t>(m_cullingNodes.size());
+    m_cullingNodes.push_back({min, max, first, count, 0});
+
+    if (count > CULLING_LEAF_SIZE)
+    {
+        // median split along the widest spread of box centers
+        int axis;
+        (centerMax - centerMin).maxCoeff(&axis);
+
+        auto begin  = m_cullingOrder.begin() + first;
+        auto middle = begin + count / 2;
+        std::nth_element(begin, middle, begin + count, [this, axis](uint32_t a, uint32_t b)
+        {
+            return m_cullingMin[a](axis) + m_cullingMax[a](axis) < m_cullingMin[b](axis) + m_cullingMax[b](axis);
+        });
+
+        buildCullingNode(first, count / 2);
+        const uint32_t right = buildCullingNode(first + count / 2, count - count / 2);
+        m_cullingNodes[index].right = right;
+    }
+
+    return index;
+}
+
+void Scene::clearCullingHierarchy(void)
+{
+    m_cullingNodes.clear();
+    m_cullingOrder.clear();
+    m_cullingMin.clear();
+    m_cullingMax.clear();
+}
+
+bool Scene::hasCullingHierarchy(void) const
+{
+    // getMeshes() hands out the list, so a changed count also drops it
+    return !m_cullingNodes.empty() && m_cullingMin.size() == m_meshes.size();
+}
+
+void Scene::cull(const Frustum & frustum)
+{
+    m_cullingStats = CullingStats();
+
+    if (!m_culling)
+    {
+        m_visible.assign(m_meshes.size(), 1);
+        m_cullingStats.drawn = m_meshes.size();
+        return;
+    }
+
+    m_visible.assign(m_meshes.size(), 0);
+
+    if (hasCullingHierarchy())
+    {
+        std::vector<uint32_t> stack(1, 0);
+        while (!stack.empty())
+        {
+            const CullingNode & node = m_cullingNodes[stack.back()];
+            stack.pop_back();
+
+            if (node.count == 0) continue;
+
+            ++m_cullingStats.boxTests;
+            FrustumTest test = frustum.classifyBox(node.min, node.max);
+
+            if (test == FrustumTest::OUTSIDE) continue;
+
+            if (test == FrustumTest::INSIDE)
+            {
+                for (uint32_t k = node.first; k < node.first + node.count; ++k)
+                {
+                    m_visible[m_cullingOrder[k]] = 1;
+                }
+            } else if (node.right == 0) {
+                for (uint32_t k = node.first; k < node.first + node.count; ++k)
+                {
+                    const uint32_t mesh = m_cullingOrder[k];
+
+                    ++m_cullingStats.boxTests;
+                    m_visible[mesh] = frustum.intersectsBox(m_cullingMin[mesh], m_cullingMax[mesh]);
+                }
+            } else {
+                const uint32_t index = static_cast<uint32_t>(&node - m_cullingNodes.data());
+                stack.push_back(node.right);
+                stack.push_back(index + 1);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < m_meshes.size(); ++i)
+        {
+            Eigen::Vector3f min, max;
+            transformBounds(transform_to_mtw(m_meshes[i]->getTransform()), m_meshes[i]->getMin(), m_meshes[i]->getMax(), min, max);
+
+            if (!(min.array() <= max.array()).all()) continue;
+
+            ++m_cullingStats.boxTests;
+            m_visible[i] = frustum.intersectsBox(min, max);
+        }
+    }
+
+    for (uint8_t visible : m_visible)
+    {
+        m_cullingStats.drawn += visible;
+    }
+    m_cullingStats.culled = m_meshes.size() - m_cullingStats.drawn;
+}
+
+void Scene::queueMeshes(const Eigen::Affine3f & worldToCamera)
+{
+    m_renderQueue.clear();
+    m_renderQueue.reserve(m_meshes.size());
+
+    if (!m_sorting)
+    {
+        for (size_t i = 0; i < m_meshes.size(); ++i)
+        {
+            if (m_visible[i]) m_renderQueue.push(0, static_cast<uint32_t>(i));
+        }
+        return;
+    }
+
+    // ids in order of first appearance, no texture is 0
+    std::unordered_map<const Material *, uint32_t> materialIds;
+    std::unordered_map<const Texture *,  uint32_t> textureIds;
+    textureIds[nullptr] = 0;
+
+    // distance of the box centers along the view direction, bucketed over
+    // the range the visible meshes span
+    std::vector<float> depths(m_meshes.size(), 0.0f);
+    float minDepth = std::numeric_limits<float>::max();
+    float maxDepth = std::numeric_limits<float>::lowest();
+
+    for (size_t i = 0; i < m_meshes.size(); ++i)
+    {
+        if (!m_visible[i]) continue;
+
+        const Eigen::Vector3f center = transform_to_mtw(m_meshes[i]->getTransform()) * m_meshes[i]->getCenter();
+
+        depths[i] = -(worldToCamera * center).z();
+        minDepth  = std::min(minDepth, depths[i]);
+        maxDepth  = std::max(maxDepth, depths[i]);
+    }
+
+    const float depthScale = maxDepth > minDepth ? 1.0f / (maxDepth - minDepth) : 0.0f;
+
+    for (size_t i = 0; i < m_meshes.size(); ++i)
+    {
+        if (!m_visible[i]) continue;
+
+        const Material * material = m_meshes[i]->getMaterial().get();
+        const Texture *  texture  = material->getDiffuseTexture().get();
+
+        const uint32_t materialId = materialIds.emplace(material, static_cast<uint32_t>(materialIds.size())).first->second;
+        const uint32_t textureId  = textureIds.emplace(texture, static_cast<uint32_t>(textureIds.size())).first->second;
+
+        // one program per draw(), the queue sorts on the rest
+        m_renderQueue.push(RenderQueue::makeKey(0, textureId, materialId, (depths[i] - minDepth) * depthScale),
+                           static_cast<uint32_t>(i));
+    }
+
+    m_renderQueue.sort();
+}
+
 } // namespace mh
@@ -0,0 +1,182 @@
+#include "mh/3d/topology.h"
+
+#include <algorithm>
+
+#include "mh/3d/compact_mesh.h"
+#include "mh/3d/mesh.h"
+
+#include "mh/base/parallel.h"
+
+#include "mh/util/radix_sort.h"
+
+namespace
+{
+    using namespace mh;
+
+    const uint32_t NO_TWIN = 0xffffffffu;
+
+    struct EdgeEntry
+    {
+        uint64_t key;
+        uint32_t he;
+    };
+
+    int bitsFor(uint64_t n)
+    {
+        int bits = 1;
+        while ((uint64_t(1) << bits) < n) ++bits;
+        return bits;
+    }
+
+    // src/dst hold the start and end vertex of every halfedge; fills twin with
+    // the index of the opposite halfedge (or NO_TWIN) and flags with
+    // HalfEdge::Flags
+    TopologyStats pairHalfEdges(const std::vector<uint32_t> & src,
+                                const std::vector<uint32_t> & dst,
+                                uint64_t nVerts,
+                                std::vector<uint32_t> & twin,
+                                std::vector<uint8_t> & flags)
+    {
+        const size_t nHalfEdges = src.size();
+        const int    vertBits   = bitsFor(nVerts);
+
+        std::vector<EdgeEntry> entries(nHalfEdges);
+
+        MH_OMP(parallel for schedule(static))
+        for (size_t i = 0; i < nHalfEdges; ++i)
+        {
+            uint64_t a = std::min(src[i], dst[i]);
+            uint64_t b = std::max(src[i], dst[i]);
+            entries[i].key = (a << vertBits) | b;
+            entries[i].he  = i;
+        }
+
+        radixSort(entries, [](const EdgeEntry & e) { return e.key; }, 2 * vertBits);
+
+        twin.assign(nHalfEdges, NO_TWIN);
+        flags.assign(nHalfEdges, 0);
+
+        size_t nEdges            = 0;
+        size_t nBoundaryEdges    = 0;
+        size_t nNonManifoldEdges = 0;
+
+        // every run of equal keys is one edge, handled by the thread that owns its first entry
+        MH_OMP(parallel for schedule(static) reduction(+:nEdges,nBoundaryEdges,nNonManifoldEdges))
+        for (size_t i = 0; i < nHalfEdges; ++i)
+        {
+            if (i > 0 && entries[i].key == entries[i - 1].key)
+            {
+                continue;
+            }
+
+            size_t end = i + 1;
+            while (end < nHalfEdges && entries[end].key == entries[i].key) ++end;
+
+            ++nEdges;
+
+            uint32_t he_0 = entries[i].he;
+            bool degenerate = src[he_0] == dst[he_0];
+
+            if (!degenerate && end - i == 1)
+            {
+                flags[he_0] = HalfEdge::BOUNDARY;
+                ++nBoundaryEdges;
+            } else if (!degenerate && end - i == 2 && src[he_0] == dst[entries[i + 1].he]) {
+                uint32_t he_1 = entries[i + 1].he;
+                twin[he_0] = he_1;
+                twin[he_1] = he_0;
+            } else {
+                for (size_t j = i; j < end; ++j)
+                {
+                    flags[entries[j].he] = HalfEdge::NON_MANIFOLD;
+                }
+                ++nNonManifoldEdges;
+            }
+        }
+
+        TopologyStats stats;
+        stats.nEdges            = nEdges;
+        stats.nBoundaryEdges    = nBoundaryEdges;
+        stats.nNonManifoldEdges = nNonManifoldEdges;
+
+        return stats;
+    }
+
+} // anonymous namespace
+
+namespace mh
+{
+
+TopologyStats finalizeTopology(Mesh & mesh)
+{
+    // only links change, so go through the const accessors and leave the
+    // GL and bounding box caches alone
+    const auto & halfedges = static_cast<const Mesh &>(mesh).getHalfEdges();
+    const size_t nHalfEdges = halfedges.size();
+
+    std::vector<uint32_t> src(nHalfEdges);
+    std::vector<uint32_t> dst(nHalfEdges);
+    uint32_t maxIdx = 0;
+
+    MH_OMP(parallel for schedule(static) reduction(max:maxIdx))
+    for (size_t i = 0; i < nHalfEdges; ++i)
+    {
+        const HalfEdge * he = halfedges[i].get();
+        dst[i] = he->getVertex()->idx();
+        src[i] = he->getNext()->getNext()->getVertex()->idx();
+        maxIdx = std::max(maxIdx, dst[i]);
+    }
+
+    std::vector<uint32_t> twin;
+    std::vector<uint8_t>  flags;
+    TopologyStats stats = pairHalfEdges(src, dst, uint64_t(maxIdx) + 1, twin, flags);
+
+    MH_OMP(parallel for schedule(static))
+    for (size_t i = 0; i < nHalfEdges; ++i)
+    {
+        halfedges[i]->setTwin(twin[i] != NO_TWIN ? halfedges[twin[i]].get() : nullptr);
+        halfedges[i]->setFlags(flags[i]);
+    }
+
+    // a halfedge without twin ends the fan of its target vertex, and the
+    // halfedge following it is where that fan starts
+    for (size_t i = 0; i < nHalfEdges; ++i)
+    {
+        if (twin[i] == NO_TWIN)
+        {
+            HalfEdge * he = halfedges[i].get();
+            he->getVertex()->setHalfEdge(he->getNext());
+        }
+    }
+
+    return stats;
+}
+
+TopologyStats finalizeTopology(CompactMesh & mesh)
+{
+    const size_t nHalfEdges = mesh.nHalfEdges();
+
+    std::vector<uint32_t> src(nHalfEdges);
+    const std::vector<uint32_t> & dst = mesh.getHalfEdgeVertices();
+
+    MH_OMP(parallel for schedule(static))
+    for (size_t i = 0; i < nHalfEdges; ++i)
+    {
+        src[i] = mesh.heSource(i);
+    }
+
+    TopologyStats stats = pairHalfEdges(src, dst, mesh.nVerts(), mesh.getHalfEdgeTwins(), mesh.getHalfEdgeFlags());
+
+    const std::vector<uint32_t> & twin = mesh.getHalfEdgeTwins();
+    for (size_t i = 0; i < nHalfEdges; ++i)
+    {
+        if (twin[i] == NO_TWIN)
+        {
+            mesh.getVertexHalfEdges()[dst[i]] = CompactMesh::heNext(i);
+        }
+    }
+
+    return stats;
+}
+
+} // namespace mh
@@ -0,0 +1,221 @@
+#include "mh/3d/vertex_packing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mh/3d/mesh.h"
+#include "mh/3d/mesh_changes.h"
+
+namespace
+{
+    using namespace mh;
+
+    // round to nearest even, overflow to infinity, NaN stays NaN
+    uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        const uint16_t sign = (bits >> 16) & 0x8000;
+        const uint32_t abs  = bits & 0x7fffffff;
+
+        if (abs >= 0x7f800000) return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+        if (abs >= 0x477ff000) return sign | 0x7c00;
+
+        // below the smallest normal half the value is a multiple of 2^-24
+        if (abs < 0x38800000)
+        {
+            float magnitude;
+            std::memcpy(&magnitude, &abs, sizeof(magnitude));
+            return sign | static_cast<uint16_t>(std::nearbyint(magnitude * 16777216.0f));
+        }
+
+        uint32_t half      = (abs - 0x38000000) >> 13;
+        uint32_t remainder = abs & 0x1fff;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        {
+            ++half;
+        }
+
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    // unit vector onto the octahedron, unfolded into [-1, 1]^2
+    void octahedralEncode(const Eigen::Vector3f & n, float * out)
+    {
+        float l1 = std::abs(n(0)) + std::abs(n(1)) + std::abs(n(2));
+        if (l1 == 0.0f)
+        {
+            out[0] = out[1] = 0.0f;
+            return;
+        }
+
+        float x = n(0) / l1;
+        float y = n(1) / l1;
+
+        if (n(2) < 0.0f)
+        {
+            float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = folded_x;
+            y = folded_y;
+        }
+
+        out[0] = x;
+        out[1] = y;
+    }
+
+    // converters from a float component to the storage type of an element
+    struct StoreFloat   { float    operator()(float v) const { return v; } };
+    struct StoreHalf    { uint16_t operator()(float v) const { return floatToHalf(v); } };
+    struct StoreUnorm8  { uint8_t  operator()(float v) const { return static_cast<uint8_t> (std::min(std::max(v, 0.0f), 1.0f) * 255.0f   + 0.5f); } };
+    struct StoreUnorm16 { uint16_t operator()(float v) const { return static_cast<uint16_t>(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f + 0.5f); } };
+    struct StoreSnorm16 { int16_t  operator()(float v) const { return static_cast<int16_t> (std::nearbyint(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f)); } };
+
+    // Writes one element for n vertices; get(i, values) fills the up to four
+    // float components of vertex i. The switch on the element runs once per
+    // call, not per vertex.
+    template <class TStore, class TGetFunc>
+    void packElement(const VertexElement & element, size_t stride, size_t n, uint8_t * dst, TGetFunc get)
+    {
+        TStore store;
+
+        uint8_t * out = dst + element.offset;
+        for (size_t i = 0; i < n; ++i, out += stride)
+        {
+            float values[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+            get(i, values);
+
+            for (GLint c = 0; c < element.components; ++c)
+            {
+                auto stored = store(values[c]);
+                std::memcpy(out + sizeof(stored) * c, &stored, sizeof(stored));
+            }
+        }
+    }
+
+    template <class TGetFunc>
+    void packFloatElement(const VertexElement & element, size_t stride, size_t n, uint8_t * dst, TGetFunc get)
+    {
+        switch (element.type)
+        {
+            case GL_FLOAT:          packElement<StoreFloat>  (element, stride, n, dst, get); break;
+            case GL_HALF_FLOAT:     packElement<StoreHalf>   (element, stride, n, dst, get); break;
+            case GL_UNSIGNED_BYTE:  packElement<StoreUnorm8> (element, stride, n, dst, get); break;
+            case GL_UNSIGNED_SHORT: packElement<StoreUnorm16>(element, stride, n, dst, get); break;
+            case GL_SHORT:          packElement<StoreSnorm16>(element, stride, n, dst, get); break;
+            default:                MH_ASSERT(false);                                        break;
+        }
+
+        MH_ASSERT(element.type == GL_FLOAT || element.type == GL_HALF_FLOAT || element.normalized);
+    }
+
+    template <class TGetFunc>
+    void packIntElement(const VertexElement & element, size_t stride, size_t n, uint8_t * dst, TGetFunc get)
+    {
+        MH_ASSERT((element.type == GL_INT || element.type == GL_UNSIGNED_INT) && element.components == 1);
+
+        uint8_t * out = dst + element.offset;
+        for (size_t i = 0; i < n; ++i, out += stride)
+        {
+            int32_t value = get(i);
+            std::memcpy(out, &value, sizeof(value));
+        }
+    }
+
+    void copy3(const Eigen::Vector3f & v, float * out)
+    {
+        out[0] = v(0);
+        out[1] = v(1);
+        out[2] = v(2);
+    }
+
+} // anonymous namespace
+
+namespace mh
+{
+
+void packVertices(const VertexFormat & format, const Vertex * const * verts, const Wedge * const * wedges, size_t n, uint8_t * dst,
+                  const VertexQuantization & quantization)
+{
+    const size_t stride = format.stride();
+
+    for (const VertexElement & element : format.elements())
+    {
+        switch (element.semantic)
+        {
+            case VertexSemantic::POSITION:
+                if (element.normalized)
+                {
+                    const Eigen::Vector3f offset   = quantization.offset;
+                    const Eigen::Vector3f invScale = quantization.scale.cwiseInverse();
+                    packFloatElement(element, stride, n, dst, [verts, &offset, &invScale](size_t i, float * out)
+                    {
+                        copy3((verts[i]->getPosition() - offset).cwiseProduct(invScale), out);
+                    });
+                } else {
+                    packFloatElement(element, stride, n, dst, [verts](size_t i, float * out) { copy3(verts[i]->getPosition(), out); });
+                }
+                break;
+            case VertexSemantic::COLOR:
+                packFloatElement(element, stride, n, dst, [verts](size_t i, float * out) { copy3(verts[i]->getColor(), out); });
+                break;
+            case VertexSemantic::CUSTOM_VEC:
+                packFloatElement(element, stride, n, dst, [verts](size_t i, float * out) { copy3(verts[i]->getCustomVec(), out); });
+                break;
+            case VertexSemantic::INDEX:
+                packIntElement(element, stride, n, dst, [verts](size_t i) { return static_cast<int32_t>(verts[i]->idx()); });
+                break;
+            case VertexSemantic::CUSTOM_INT:
+                packIntElement(element, stride, n, dst, [verts](size_t i) { return static_cast<int32_t>(verts[i]->getCustomInt()); });
+                break;
+            case VertexSemantic::NORMAL:
+                if (!wedges)
+                {
+                    packFloatElement(element, stride, n, dst, [](size_t, float *) {});
+                } else if (element.components == 2)
+                {
+                    packFloatElement(element, stride, n, dst, [wedges](size_t i, float * out) { octahedralEncode(wedges[i]->getNormal(), out); });
+                } else {
+                    packFloatElement(element, stride, n, dst, [wedges](size_t i, float * out) { copy3(wedges[i]->getNormal(), out); });
+                }
+                break;
+            case VertexSemantic::TEXTURE_COORDS:
+                if (!wedges)
+                {
+                    packFloatElement(element, stride, n, dst, [](size_t, float *) {});
+                    break;
+                }
+                packFloatElement(element, stride, n, dst, [wedges](size_t i, float * out)
+                {
+                    float2 textureCoords = wedges[i]->getTextureCoords();
+                    out[0] = textureCoords.x;
+                    out[1] = textureCoords.y;
+                });
+                break;
+            // not vertex data
+            case VertexSemantic::INSTANCE_TRANSFORM_ROW_0:
+            case VertexSemantic::INSTANCE_TRANSFORM_ROW_1:
+            case VertexSemantic::INSTANCE_TRANSFORM_ROW_2:
+            case VertexSemantic::INSTANCE_COLOR:
+            case VertexSemantic::COUNT:
+                MH_ASSERT(false);
+                break;
+        }
+    }
+}
+
+bool quantizationHolds(const VertexFormat & format, const VertexQuantization & quantization,
+                       const Mesh & mesh, const MeshChanges & changes)
+{
+    const VertexElement * position = format.find(VertexSemantic::POSITION);
+    if (!position || !position->normalized || changes[MeshAttribute::POSITION].empty())
+    {
+        return true;
+    }
+
+    return quantization.contains(mesh.getMin(), mesh.getMax());
+}
+
+} // namespace mh
@@ -0,0 +1,39 @@
+#include "mh/gpu/buffer_upload.h"
+
+#include <algorithm>
+
+namespace
+{
+    // elements between two runs that are uploaded anyway to save a call
+    const size_t MAX_RUN_GAP  = 64;
+    const size_t MAX_RUNS     = 256;
+
+} // anonymous namespace
+
+namespace mh
+{
+
+void coalesceRuns(std::vector<IndexRange> & runs)
+{
+    if (runs.empty()) return;
+
+    size_t n = 0;
+    for (size_t i = 1; i < runs.size(); ++i)
+    {
+        if (runs[i].begin <= runs[n].end + MAX_RUN_GAP)
+        {
+            runs[n].end = std::max(runs[n].end, runs[i].end);
+        } else {
+            runs[++n] = runs[i];
+        }
+    }
+    runs.resize(n + 1);
+
+    if (runs.size() > MAX_RUNS)
+    {
+        runs.front().end = runs.back().end;
+        runs.resize(1);
+    }
+}
+
+} // namespace mh
@@ -0,0 +1,253 @@
+#include "mh/gpu/profiler.h"
+
+#include <fstream>
+#include <ostream>
+
+namespace mh
+{
+
+namespace
+{
+    void writeJsonString(std::ostream & out, const std::string & s)
+    {
+        out << '"';
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                out << ' ';
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    void writeCsvString(std::ostream & out, const std::string & s)
+    {
+        if (s.find_first_of(",\"\n") == std::string::npos)
+        {
+            out << s;
+            return;
+        }
+
+        out << '"';
+        for (char c : s)
+        {
+            if (c == '"') out << '"';
+            out << c;
+        }
+        out << '"';
+    }
+} // anonymous namespace
+
+Profiler::Profiler()
+    : m_enabled(true)
+    , m_historySize(240)
+    , m_epoch(std::chrono::steady_clock::now())
+    , m_current(0)
+    , m_frameIndex(0)
+    , m_gpuSample(NO_SAMPLE)
+    , m_dropped(0)
+{}
+
+Profiler::~Profiler()
+{
+    // the context may be gone by now; the queries die with it
+}
+
+double Profiler::now() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+void Profiler::beginFrame()
+{
+    InFlightFrame & previous = m_slots[m_current];
+    if (previous.active)
+    {
+        // scopes left open end with the frame
+        while (!m_open.empty()) end(m_open.back());
+
+        previous.frame.cpuTime = now() - previous.frame.cpuStart;
+        m_current = (m_current + 1) % FRAMES_IN_FLIGHT;
+    }
+
+    InFlightFrame & slot = m_slots[m_current];
+    if (slot.active)
+    {
+        collect(slot);
+    }
+
+    if (!m_enabled)
+    {
+        slot.active = false;
+        return;
+    }
+
+    slot.active         = true;
+    slot.nQueries       = 0;
+    slot.querySamples.clear();
+    slot.frame.index    = m_frameIndex++;
+    slot.frame.cpuStart = now();
+    slot.frame.cpuTime  = 0.0;
+    slot.frame.samples.clear();
+}
+
+void Profiler::collect(InFlightFrame & slot)
+{
+    slot.active = false;
+
+    // queries finish in order, so the last one being ready means all are
+    if (slot.nQueries > 0)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[slot.nQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            ++m_dropped;
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < slot.nQueries; ++i)
+    {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &nanoseconds);
+        slot.frame.samples[slot.querySamples[i]].gpuTime = nanoseconds / 1.0e6;
+    }
+
+    m_history.push_back(slot.frame);
+    while (m_history.size() > m_historySize) m_history.pop_front();
+}
+
+void Profiler::setHistorySize(size_t size)
+{
+    m_historySize = size;
+    while (m_history.size() > m_historySize) m_history.pop_front();
+}
+
+void Profiler::clear()
+{
+    m_history.clear();
+    m_dropped = 0;
+}
+
+size_t Profiler::begin(const char * name, bool gpu)
+{
+    InFlightFrame & slot = m_slots[m_current];
+    if (!m_enabled || !slot.active) return NO_SAMPLE;
+
+    ProfileSample sample;
+    sample.name     = name;
+    sample.depth    = static_cast<int>(m_open.size());
+    sample.cpuStart = now();
+    sample.cpuTime  = 0.0;
+    sample.gpuTime  = -1.0;
+
+    const size_t index = slot.frame.samples.size();
+    slot.frame.samples.push_back(sample);
+    m_open.push_back(index);
+
+    if (gpu && m_gpuSample == NO_SAMPLE)
+    {
+        if (slot.nQueries == slot.queries.size())
+        {
+            GLuint query;
+            glGenQueries(1, &query);
+            slot.queries.push_back(query);
+        }
+
+        glBeginQuery(GL_TIME_ELAPSED, slot.queries[slot.nQueries++]);
+        slot.querySamples.push_back(index);
+        m_gpuSample = index;
+    }
+
+    return index;
+}
+
+void Profiler::end(size_t sample)
+{
+    if (sample == NO_SAMPLE || m_open.empty() || m_open.back() != sample) return;
+
+    InFlightFrame & slot = m_slots[m_current];
+    slot.frame.samples[sample].cpuTime = now() - slot.frame.samples[sample].cpuStart;
+    m_open.pop_back();
+
+    if (m_gpuSample == sample)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_gpuSample = NO_SAMPLE;
+    }
+}
+
+void Profiler::exportCsv(std::ostream & out) const
+{
+    out << "frame,frame_cpu_ms,name,depth,cpu_start_ms,cpu_ms,gpu_ms\n";
+
+    for (const ProfileFrame & frame : m_history)
+    {
+        for (const ProfileSample & sample : frame.samples)
+        {
+            out << frame.index << ',' << frame.cpuTime << ',';
+            writeCsvString(out, sample.name);
+            out << ',' << sample.depth << ',' << sample.cpuStart << ',' << sample.cpuTime << ',';
+            if (sample.gpuTime >= 0.0) out << sample.gpuTime;
+            out << '\n';
+        }
+    }
+}
+
+bool Profiler::exportCsv(const std::string & filename) const
+{
+    std::ofstream out(filename);
+    if (!out) return false;
+
+    exportCsv(out);
+    return static_cast<bool>(out);
+}
+
+void Profiler::exportChromeTrace(std::ostream & out) const
+{
+    // microseconds, the unit of the format
+    auto event = [&out](const std::string & name, const char * category, double start, double duration, int thread, bool & first)
+    {
+        out << (first ? "\n" : ",\n") << "{\"name\":";
+        writeJsonString(out, name);
+        out << ",\"cat\":\"" << category << "\",\"ph\":\"X\",\"ts\":" << start * 1000.0
+            << ",\"dur\":" << duration * 1000.0 << ",\"pid\":0,\"tid\":" << thread << '}';
+        first = false;
+    };
+
+    bool first = true;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (const ProfileFrame & frame : m_history)
+    {
+        event("frame " + std::to_string(frame.index), "frame", frame.cpuStart, frame.cpuTime, 0, first);
+
+        for (const ProfileSample & sample : frame.samples)
+        {
+            event(sample.name, "cpu", sample.cpuStart, sample.cpuTime, 0, first);
+            if (sample.gpuTime >= 0.0)
+            {
+                event(sample.name, "gpu", sample.cpuStart, sample.gpuTime, 1, first);
+            }
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+bool Profiler::exportChromeTrace(const std::string & filename) const
+{
+    std::ofstream out(filename);
+    if (!out) return false;
+
+    exportChromeTrace(out);
+    return static_cast<bool>(out);
+}
+
+} // namespace mh
@@ -1,5 +1,7 @@
 #include "mh/gpu/shader.h"
 
+#include <algorithm>
+
 // Functions from http://www.antongerdelan.net/opengl/shaders.html
 // and https://www.opengl.org/wiki/Example_Code
 namespace
@@ -90,7 +92,88 @@ bool Shader::link(void)
         return false;
     }
 
+    reflect();
+
+    return true;
+}
+
+GLint Shader::uniformLocation(const std::string & name) const
+{
+    auto it = m_uniforms.find(name);
+    if (it != m_uniforms.end()) return it->second;
+
+    // reflection lists arrays by their first element only, other elements
+    // and struct members are asked for once; misses are cached as -1 too
+    GLint location = glGetUniformLocation(m_program, name.c_str());
+    m_uniforms[name] = location;
+
+    return location;
+}
+
+bool Shader::bindUniformBlock(const std::string & name, GLuint binding)
+{
+    auto it = m_uniformBlocks.find(name);
+    if (it == m_uniformBlocks.end()) return false;
+
+    GLuint & current = m_blockBindings[it->second];
+    if (current != binding)
+    {
+        glUniformBlockBinding(m_program, it->second, binding);
+        current = binding;
+    }
+
     return true;
 }
 
+void Shader::reflect(void)
+{
+    m_uniforms.clear();
+    m_uniformBlocks.clear();
+
+    GLint nUniforms = 0, maxLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS,           &nUniforms);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> buffer(std::max(maxLength, 1));
+    for (GLint i = 0; i < nUniforms; ++i)
+    {
+        GLsizei length = 0;
+        GLint   size;
+        GLenum  type;
+        glGetActiveUniform(m_program, i, buffer.size(), &length, &size, &type, buffer.data());
+
+        std::string name(buffer.data(), length);
+
+        // members of uniform blocks have no location
+        GLint location = glGetUniformLocation(m_program, name.c_str());
+        if (location < 0) continue;
+
+        m_uniforms[name] = location;
+
+        const std::string arraySuffix = "[0]";
+        if (name.size() > arraySuffix.size() && name.compare(name.size() - arraySuffix.size(), arraySuffix.size(), arraySuffix) == 0)
+        {
+            m_uniforms[name.substr(0, name.size() - arraySuffix.size())] = location;
+        }
+    }
+
+    GLint nBlocks = 0, maxBlockLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS,                &nBlocks);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockLength);
+
+    buffer.resize(std::max(maxBlockLength, 1));
+    m_blockBindings.assign(nBlocks, 0);
+    for (GLint i = 0; i < nBlocks; ++i)
+    {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(m_program, i, buffer.size(), &length, buffer.data());
+
+        m_uniformBlocks[std::string(buffer.data(), length)] = i;
+
+        GLint binding = 0;
+        glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+        m_blockBindings[i] = binding;
+    }
+}
+
 } // namespace mh
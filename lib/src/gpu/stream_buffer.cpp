@@ -0,0 +1,159 @@
+#include "mh/gpu/stream_buffer.h"
+
+#include <cstring>
+
+namespace
+{
+    // GL 4.4 / ARB_buffer_storage, newer than the gl3w headers
+    typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const void * data, GLbitfield flags);
+
+    const GLbitfield MAP_PERSISTENT_BIT = 0x0040;
+    const GLbitfield MAP_COHERENT_BIT   = 0x0080;
+
+    // a frame is long over by then, waiting more means the GPU hangs
+    const GLuint64   FENCE_TIMEOUT      = 1000000000ull;
+
+    bool hasExtension(const char * name)
+    {
+        GLint nExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+
+        for (GLint i = 0; i < nExtensions; ++i)
+        {
+            const char * extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && std::strcmp(extension, name) == 0) return true;
+        }
+
+        return false;
+    }
+
+    // nullptr where unsupported; GLX resolves any name, so the version
+    // decides, not the pointer
+    PFNGLBUFFERSTORAGEPROC bufferStorage()
+    {
+        static PFNGLBUFFERSTORAGEPROC proc =
+            gl3wIsSupported(4, 4) || hasExtension("GL_ARB_buffer_storage")
+                ? reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(gl3wGetProcAddress("glBufferStorage"))
+                : nullptr;
+        return proc;
+    }
+
+} // anonymous namespace
+
+namespace mh
+{
+
+StreamBuffer::StreamBuffer(size_t regionSize, size_t nRegions)
+    : m_regionSize(regionSize)
+    , m_region(nRegions - 1)
+    , m_mapped(false)
+    , m_persistent(nullptr)
+    , m_fences(nRegions, nullptr)
+    , m_nStalls(0)
+{
+    MH_ASSERT(regionSize > 0 && nRegions > 0);
+
+    const size_t size = regionSize * nRegions;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+
+    if (persistentMappingSupported())
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | MAP_PERSISTENT_BIT | MAP_COHERENT_BIT;
+
+        bufferStorage()(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        m_persistent = static_cast<uint8_t *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (GLsync fence : m_fences)
+    {
+        if (fence) glDeleteSync(fence);
+    }
+
+    if (m_persistent || m_mapped)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    glDeleteBuffers(1, &m_buffer);
+}
+
+uint8_t * StreamBuffer::map()
+{
+    MH_ASSERT(!m_mapped);
+
+    m_region = (m_region + 1) % m_fences.size();
+    waitForRegion(m_region);
+
+    m_mapped = true;
+
+    if (m_persistent)
+    {
+        return m_persistent + regionOffset();
+    }
+
+    // the fence already guarantees the GPU is done with the region
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    void * memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, regionOffset(), m_regionSize,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return static_cast<uint8_t *>(memory);
+}
+
+void StreamBuffer::unmap()
+{
+    MH_ASSERT(m_mapped);
+
+    // coherent persistent memory is visible to commands issued from now on
+    if (!m_persistent)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    m_mapped = false;
+}
+
+void StreamBuffer::fence()
+{
+    GLsync & fence = m_fences[m_region];
+    if (fence) glDeleteSync(fence);
+
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::waitForRegion(size_t region)
+{
+    GLsync & fence = m_fences[region];
+    if (!fence) return;
+
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        ++m_nStalls;
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    }
+    MH_ASSERT(status != GL_WAIT_FAILED);
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+bool StreamBuffer::persistentMappingSupported()
+{
+    return bufferStorage() != nullptr;
+}
+
+} // namespace mh
@@ -0,0 +1,61 @@
+#include "mh/gpu/uniform_buffer.h"
+
+namespace
+{
+    size_t offsetAlignment()
+    {
+        static GLint alignment = 0;
+        if (alignment <= 0)
+        {
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            // the largest value the spec allows
+            if (alignment <= 0) alignment = 256;
+        }
+
+        return static_cast<size_t>(alignment);
+    }
+
+} // anonymous namespace
+
+namespace mh
+{
+
+UniformBuffer::UniformBuffer(size_t blockSize, size_t nBlocks)
+    : m_blockSize(blockSize)
+    , m_nBlocks(0)
+{
+    MH_ASSERT(blockSize > 0);
+
+    const size_t alignment = offsetAlignment();
+    m_stride = (blockSize + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &m_buffer);
+    resize(nBlocks);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    glDeleteBuffers(1, &m_buffer);
+}
+
+void UniformBuffer::resize(size_t nBlocks)
+{
+    m_nBlocks = nBlocks;
+    m_data.assign(m_nBlocks * m_stride, 0);
+}
+
+void UniformBuffer::upload()
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, m_data.size(), m_data.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::bind(GLuint binding, size_t i) const
+{
+    MH_ASSERT(i < m_nBlocks);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, i * m_stride, m_blockSize);
+}
+
+} // namespace mh
@@ -0,0 +1,71 @@
+#include "mh/gpu/upload_scheduler.h"
+
+#include <algorithm>
+
+namespace mh
+{
+
+void UploadScheduler::beginFrame()
+{
+    m_frameStart     = std::chrono::steady_clock::now();
+    m_bytesThisFrame = 0;
+}
+
+bool UploadScheduler::mayUpload() const
+{
+    if (m_bytesThisFrame == 0) return true;
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_frameStart;
+    return elapsed.count() < m_budget;
+}
+
+ChunkedUpload::ChunkedUpload(const void * data, size_t size)
+    : m_data(static_cast<const uint8_t *>(data)), m_size(size), m_offset(0)
+{
+    // the copy target binds any kind of buffer without touching the
+    // element binding of a vertex array
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, m_size, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+ChunkedUpload::~ChunkedUpload()
+{
+    if (m_buffer != 0)
+    {
+        glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+bool ChunkedUpload::step()
+{
+    UploadScheduler & scheduler = UploadScheduler::get_instance();
+
+    if (done() || !scheduler.mayUpload()) return done();
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    while (!done() && scheduler.mayUpload())
+    {
+        size_t chunk = std::min(CHUNK_SIZE, m_size - m_offset);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, m_offset, chunk, m_data + m_offset);
+
+        m_offset += chunk;
+        scheduler.uploaded(chunk);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return done();
+}
+
+GLuint ChunkedUpload::release()
+{
+    MH_ASSERT(done());
+
+    GLuint buffer = m_buffer;
+    m_buffer = 0;
+
+    return buffer;
+}
+
+} // namespace mh
@@ -0,0 +1,49 @@
+#include "mh/gpu/vertex_decode.h"
+
+namespace mh
+{
+
+const char * const VERTEX_DECODE_GLSL = R"GLSL(
+uniform vec3 mhPositionOffset;
+uniform vec3 mhPositionScale;
+
+vec3 mhDecodePosition(vec3 quantized)
+{
+    return mhPositionOffset + mhPositionScale * quantized;
+}
+
+vec3 mhDecodeNormal(vec2 octahedral)
+{
+    vec3  n = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+)GLSL";
+
+std::string withVertexDecoding(const std::string & code)
+{
+    // #version has to stay the first statement
+    size_t version = code.find("#version");
+    if (version == std::string::npos)
+    {
+        return std::string(VERTEX_DECODE_GLSL) + code;
+    }
+
+    size_t lineEnd = code.find('\n', version);
+    if (lineEnd == std::string::npos)
+    {
+        return code + "\n" + VERTEX_DECODE_GLSL;
+    }
+
+    return code.substr(0, lineEnd + 1) + VERTEX_DECODE_GLSL + code.substr(lineEnd + 1);
+}
+
+void setVertexDecodeUniforms(Shader & shader, const VertexQuantization & quantization)
+{
+    shader.setUniform("mhPositionOffset", quantization.offset);
+    shader.setUniform("mhPositionScale",  quantization.scale);
+}
+
+} // namespace mh
@@ -0,0 +1,138 @@
+#include "mh/gpu/vertex_format.h"
+
+namespace mh
+{
+
+VertexFormat & VertexFormat::add(VertexSemantic semantic, GLuint location, GLenum type, GLint components,
+                                bool integer, bool normalized)
+{
+    MH_ASSERT(find(semantic) == nullptr);
+    MH_ASSERT(components >= 1 && components <= 4);
+    MH_ASSERT(!(integer && normalized));
+
+    VertexElement element;
+    element.semantic   = semantic;
+    element.location   = location;
+    element.type       = type;
+    element.components = components;
+    element.integer    = integer;
+    element.normalized = normalized;
+    element.offset     = m_stride;
+
+    m_elements.push_back(element);
+
+    // keep every element 4 byte aligned, GL wants that for all types
+    m_stride += (typeSize(type) * components + 3) & ~size_t(3);
+
+    return *this;
+}
+
+VertexFormat & VertexFormat::addQuantized(VertexSemantic semantic, GLuint location)
+{
+    return add(semantic, location, GL_UNSIGNED_SHORT, 3, false, true);
+}
+
+VertexFormat & VertexFormat::addOctahedral(VertexSemantic semantic, GLuint location)
+{
+    return add(semantic, location, GL_SHORT, 2, false, true);
+}
+
+VertexFormat & VertexFormat::addUnorm8(VertexSemantic semantic, GLuint location)
+{
+    return add(semantic, location, GL_UNSIGNED_BYTE, 4, false, true);
+}
+
+VertexFormat & VertexFormat::addHalf(VertexSemantic semantic, GLuint location, GLint components)
+{
+    return add(semantic, location, GL_HALF_FLOAT, components);
+}
+
+const VertexElement * VertexFormat::find(VertexSemantic semantic) const
+{
+    for (const VertexElement & element : m_elements)
+    {
+        if (element.semantic == semantic) return &element;
+    }
+
+    return nullptr;
+}
+
+void VertexFormat::apply(GLuint divisor) const
+{
+    const GLsizei stride = static_cast<GLsizei>(m_stride);
+
+    for (const VertexElement & element : m_elements)
+    {
+        const GLvoid * offset = reinterpret_cast<const GLvoid *>(element.offset);
+
+        glEnableVertexAttribArray(element.location);
+        if (element.integer)
+        {
+            glVertexAttribIPointer(element.location, element.components, element.type, stride, offset);
+        } else {
+            glVertexAttribPointer(element.location, element.components, element.type,
+                                  element.normalized ? GL_TRUE : GL_FALSE, stride, offset);
+        }
+        glVertexAttribDivisor(element.location, divisor);
+    }
+}
+
+bool VertexFormat::operator==(const VertexFormat & rhs) const
+{
+    if (m_stride != rhs.m_stride || m_elements.size() != rhs.m_elements.size()) return false;
+
+    for (size_t i = 0; i < m_elements.size(); ++i)
+    {
+        const VertexElement & a = m_elements[i];
+        const VertexElement & b = rhs.m_elements[i];
+
+        if (a.semantic   != b.semantic   || a.location   != b.location || a.type   != b.type ||
+            a.components != b.components || a.integer    != b.integer  || a.offset != b.offset ||
+            a.normalized != b.normalized)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+VertexQuantization VertexQuantization::fromBounds(const Eigen::Vector3f & min, const Eigen::Vector3f & max)
+{
+    VertexQuantization quantization;
+    quantization.offset = min;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        float extent = max(i) - min(i);
+        quantization.scale(i) = extent > 0.0f ? extent : 1.0f;
+    }
+
+    return quantization;
+}
+
+bool VertexQuantization::contains(const Eigen::Vector3f & min, const Eigen::Vector3f & max) const
+{
+    return (min.array() >= offset.array()).all() && (max.array() <= (offset + scale).array()).all();
+}
+
+size_t VertexFormat::typeSize(GLenum type)
+{
+    switch (type)
+    {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:     return 2;
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:          return 4;
+        case GL_DOUBLE:         return 8;
+    }
+
+    MH_ASSERT(false);
+    return 0;
+}
+
+} // namespace mh
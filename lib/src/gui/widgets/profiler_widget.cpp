@@ -0,0 +1,119 @@
+#include "mh/gui/widgets/profiler_widget.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "mh/ext/imgui/imgui.h"
+
+#include "mh/gpu/profiler.h"
+
+namespace mh
+{
+
+namespace
+{
+    struct ScopeAverage
+    {
+        std::string name;
+        int         depth;
+        double      cpuTime;
+        double      gpuTime;
+        size_t      nGpu;
+    }; // struct ScopeAverage
+} // anonymous namespace
+
+void ProfilerWidget::drawContent(void)
+{
+    Profiler & profiler = Profiler::get_instance();
+
+    bool enabled = profiler.isEnabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+    {
+        profiler.setEnabled(enabled);
+    }
+
+    const std::deque<ProfileFrame> & history = profiler.getHistory();
+    if (history.empty())
+    {
+        ImGui::Text("No frames recorded");
+        return;
+    }
+
+    std::vector<float> frameTimes;
+    frameTimes.reserve(history.size());
+    for (const ProfileFrame & frame : history)
+    {
+        frameTimes.push_back(static_cast<float>(frame.cpuTime));
+    }
+
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.2f ms", frameTimes.back());
+    ImGui::PlotLines("Frame", frameTimes.data(), static_cast<int>(frameTimes.size()), 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 60));
+
+    // scopes summed per frame by name, in order of first appearance
+    const size_t nFrames = std::min(m_averageFrames, history.size());
+
+    std::vector<ScopeAverage> scopes;
+    for (size_t f = history.size() - nFrames; f < history.size(); ++f)
+    {
+        for (const ProfileSample & sample : history[f].samples)
+        {
+            auto it = std::find_if(scopes.begin(), scopes.end(), [&sample](const ScopeAverage & scope)
+            {
+                return scope.name == sample.name && scope.depth == sample.depth;
+            });
+            if (it == scopes.end())
+            {
+                scopes.push_back(ScopeAverage{sample.name, sample.depth, 0.0, 0.0, 0});
+                it = scopes.end() - 1;
+            }
+
+            it->cpuTime += sample.cpuTime;
+            if (sample.gpuTime >= 0.0)
+            {
+                it->gpuTime += sample.gpuTime;
+                ++it->nGpu;
+            }
+        }
+    }
+
+    ImGui::Text("Average of %d frames, %d dropped", static_cast<int>(nFrames), static_cast<int>(profiler.nDropped()));
+
+    ImGui::Columns(3, "profiler_scopes");
+    ImGui::Text("Scope");  ImGui::NextColumn();
+    ImGui::Text("CPU ms"); ImGui::NextColumn();
+    ImGui::Text("GPU ms"); ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (const ScopeAverage & scope : scopes)
+    {
+        ImGui::Text("%*s%s", 2 * scope.depth, "", scope.name.c_str()); ImGui::NextColumn();
+        ImGui::Text("%.3f", scope.cpuTime / nFrames);                   ImGui::NextColumn();
+        if (scope.nGpu > 0)
+        {
+            ImGui::Text("%.3f", scope.gpuTime / nFrames);
+        } else {
+            ImGui::Text("-");
+        }
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    if (ImGui::Button("Export CSV"))
+    {
+        m_status = profiler.exportCsv("profile.csv") ? "Wrote profile.csv" : "Could not write profile.csv";
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export trace"))
+    {
+        m_status = profiler.exportChromeTrace("profile.json") ? "Wrote profile.json" : "Could not write profile.json";
+    }
+    if (!m_status.empty())
+    {
+        ImGui::Text("%s", m_status.c_str());
+    }
+}
+
+} // namespace mh
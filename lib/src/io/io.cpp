@@ -3,20 +3,21 @@
 #include <fstream>
 #include <unordered_map>
 
+#include "mh/3d/topology.h"
+
 #include "mh/gpu/texture_manager.h"
 
 #define TRANSFER_TOBJ_VERT(IDX) \
-    std::shared_ptr<Vertex> vert_##IDX; \
-    auto vert_##IDX##_it = vert_idx_map.find(vert_##IDX##_idx.vertex_index); \
-    if (vert_##IDX##_it != vert_idx_map.end()) \
+    Vertex * vert_##IDX; \
+    if (vert_idx_map[vert_##IDX##_idx.vertex_index] >= 0) \
     { \
-        vert_##IDX = mesh->getVerts()[vert_##IDX##_it->second]; \
+        vert_##IDX = mesh->getVerts()[vert_idx_map[vert_##IDX##_idx.vertex_index]].get(); \
     } else { \
-        mesh->getVerts().push_back(std::make_shared<Vertex>(Eigen::Vector3f(attrib.vertices[3 * vert_##IDX##_idx.vertex_index + 0], \
-                                                                           attrib.vertices[3 * vert_##IDX##_idx.vertex_index + 1], \
-                                                                           attrib.vertices[3 * vert_##IDX##_idx.vertex_index + 2]), mesh->getVerts().size())); \
-        vert_##IDX = mesh->getVerts().back(); \
+        vert_##IDX = mesh->addVertex(Eigen::Vector3f(attrib.vertices[3 * vert_##IDX##_idx.vertex_index + 0], \
+                                                     attrib.vertices[3 * vert_##IDX##_idx.vertex_index + 1], \
+                                                     attrib.vertices[3 * vert_##IDX##_idx.vertex_index + 2]), mesh->getVerts().size()); \
         vert_idx_map[vert_##IDX##_idx.vertex_index] = mesh->getVerts().size() - 1; \
+        used_vert_indices.push_back(vert_##IDX##_idx.vertex_index); \
     }
 
 namespace mh
@@ -83,6 +84,12 @@ std::vector<std::shared_ptr<Mesh> > loadMeshesFromOBJ(const std::string & path)
         return std::vector<std::shared_ptr<Mesh> >();
     }
 
+    // maps tinyobj vertex indices to indices in the mesh being built; only the
+    // entries touched by a mesh are reset afterwards, so the table is shared
+    // by all parts without clearing it in full
+    std::vector<int>    vert_idx_map(attrib.vertices.size() / 3, -1);
+    std::vector<size_t> used_vert_indices;
+
     std::vector<std::shared_ptr<Mesh> > meshes;
     for (size_t shape_idx = 0; shape_idx < shapes.size(); ++shape_idx)
     {
@@ -98,9 +105,9 @@ std::vector<std::shared_ptr<Mesh> > loadMeshesFromOBJ(const std::string & path)
         {
             std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
             mesh->setName(shapes[shape_idx].name);
+            mesh->reserve(std::min(vert_idx_map.size(), 3 * mat_facelist_pair.second.size()), mat_facelist_pair.second.size());
 
             // loop over triangles
-            std::map<size_t, size_t> vert_idx_map;
             for (auto face_idx : mat_facelist_pair.second) {
                 tinyobj::index_t vert_0_idx = shapes[shape_idx].mesh.indices[face_idx * 3 + 0];
                 tinyobj::index_t vert_1_idx = shapes[shape_idx].mesh.indices[face_idx * 3 + 1];
@@ -110,45 +117,7 @@ std::vector<std::shared_ptr<Mesh> > loadMeshesFromOBJ(const std::string & path)
                 TRANSFER_TOBJ_VERT(1);
                 TRANSFER_TOBJ_VERT(2);
 
-                auto face = std::make_shared<Face>(face_idx);
-                mesh->getFaces().push_back(face);
-
-                auto he_0 = std::make_shared<HalfEdge>();
-                auto he_1 = std::make_shared<HalfEdge>();
-                auto he_2 = std::make_shared<HalfEdge>();
-                mesh->getHalfEdges().push_back(he_0);
-                mesh->getHalfEdges().push_back(he_1);
-                mesh->getHalfEdges().push_back(he_2);
-
-                he_0->setVertex(vert_0.get());
-                he_1->setVertex(vert_1.get());
-                he_2->setVertex(vert_2.get());
-
-                he_0->setFace(face.get());
-                he_1->setFace(face.get());
-                he_2->setFace(face.get());
-
-                he_0->setNext(he_1.get());
-                he_1->setNext(he_2.get());
-                he_2->setNext(he_0.get());
-
-                vert_2->setHalfEdge(he_0.get());
-                vert_0->setHalfEdge(he_1.get());
-                vert_1->setHalfEdge(he_2.get());
-
-                face->setHalfEdge(he_0.get());
-
-                face->getWedges().resize(3);
-
-                auto wedge_0 = std::make_shared<Wedge>(vert_0.get(), face.get());
-                auto wedge_1 = std::make_shared<Wedge>(vert_1.get(), face.get());
-                auto wedge_2 = std::make_shared<Wedge>(vert_2.get(), face.get());
-                face->getWedges()[0] = wedge_0.get();
-                face->getWedges()[1] = wedge_1.get();
-                face->getWedges()[2] = wedge_2.get();
-                mesh->getWedges().push_back(wedge_0);
-                mesh->getWedges().push_back(wedge_1);
-                mesh->getWedges().push_back(wedge_2);
+                Face * face = mesh->addFace(vert_0, vert_1, vert_2, face_idx);
 
                 if (vert_0_idx.texcoord_index >= 0)
                 {
@@ -186,6 +155,14 @@ std::vector<std::shared_ptr<Mesh> > loadMeshesFromOBJ(const std::string & path)
                 }
             }
 
+            for (size_t vert_idx : used_vert_indices)
+            {
+                vert_idx_map[vert_idx] = -1;
+            }
+            used_vert_indices.clear();
+
+            finalizeTopology(*mesh);
+
             // convert material
             if (mat_facelist_pair.first >= 0)
             {
@@ -217,8 +194,9 @@ std::vector<std::shared_ptr<Mesh>> loadMeshesFromBin(const std::string & path)
 
         int n_verts;
         in_file.read(reinterpret_cast<char*>(&n_verts), sizeof(int));
-        mesh->getVerts().resize(n_verts);
+        mesh->reserve(n_verts, 0);
         std::unordered_map<size_t, size_t> vert_idx_map;
+        vert_idx_map.reserve(n_verts);
         for (int vert_idx = 0; vert_idx < n_verts; ++vert_idx)
         {
             int idx;
@@ -227,15 +205,14 @@ std::vector<std::shared_ptr<Mesh>> loadMeshesFromBin(const std::string & path)
             in_file.read(reinterpret_cast<char*>(&pos(0)), sizeof(float));
             in_file.read(reinterpret_cast<char*>(&pos(1)), sizeof(float));
             in_file.read(reinterpret_cast<char*>(&pos(2)), sizeof(float));
-            auto vert = std::make_shared<Vertex>(pos, idx);
-    
-            mesh->getVerts()[vert_idx] = vert;
+
+            mesh->addVertex(pos, idx);
             vert_idx_map[idx] = vert_idx;
         }
 
         int n_faces;
         in_file.read(reinterpret_cast<char*>(&n_faces), sizeof(int));
-        mesh->getFaces().resize(n_faces);
+        mesh->reserve(0, n_faces);
         for (int face_idx = 0; face_idx < n_faces; ++face_idx)
         {
             int idx;
@@ -247,52 +224,15 @@ std::vector<std::shared_ptr<Mesh>> loadMeshesFromBin(const std::string & path)
             in_file.read(reinterpret_cast<char*>(&vert_1_idx), sizeof(int));
             in_file.read(reinterpret_cast<char*>(&vert_2_idx), sizeof(int));
 
-            auto face = std::make_shared<Face>(idx);
-            mesh->getFaces()[face_idx] = face;
-
-            auto vert_0 = mesh->getVerts()[vert_idx_map[vert_0_idx]];
-            auto vert_1 = mesh->getVerts()[vert_idx_map[vert_1_idx]];
-            auto vert_2 = mesh->getVerts()[vert_idx_map[vert_2_idx]];
-
-            auto he_0 = std::make_shared<HalfEdge>();
-            auto he_1 = std::make_shared<HalfEdge>();
-            auto he_2 = std::make_shared<HalfEdge>();
-            mesh->getHalfEdges().push_back(he_0);
-            mesh->getHalfEdges().push_back(he_1);
-            mesh->getHalfEdges().push_back(he_2);
-
-            he_0->setVertex(vert_0.get());
-            he_1->setVertex(vert_1.get());
-            he_2->setVertex(vert_2.get());
-
-            he_0->setFace(face.get());
-            he_1->setFace(face.get());
-            he_2->setFace(face.get());
-
-            he_0->setNext(he_1.get());
-            he_1->setNext(he_2.get());
-            he_2->setNext(he_0.get());
-
-            vert_2->setHalfEdge(he_0.get());
-            vert_0->setHalfEdge(he_1.get());
-            vert_1->setHalfEdge(he_2.get());
-
-            face->setHalfEdge(he_0.get());
-
-            face->getWedges().resize(3);
-
-            auto wedge_0 = std::make_shared<Wedge>(vert_0.get(), face.get());
-            auto wedge_1 = std::make_shared<Wedge>(vert_1.get(), face.get());
-            auto wedge_2 = std::make_shared<Wedge>(vert_2.get(), face.get());
-            face->getWedges()[0] = wedge_0.get();
-            face->getWedges()[1] = wedge_1.get();
-            face->getWedges()[2] = wedge_2.get();
-            mesh->getWedges().push_back(wedge_0);
-            mesh->getWedges().push_back(wedge_1);
-            mesh->getWedges().push_back(wedge_2);
+            Vertex * vert_0 = mesh->getVerts()[vert_idx_map[vert_0_idx]].get();
+            Vertex * vert_1 = mesh->getVerts()[vert_idx_map[vert_1_idx]].get();
+            Vertex * vert_2 = mesh->getVerts()[vert_idx_map[vert_2_idx]].get();
 
+            mesh->addFace(vert_0, vert_1, vert_2, idx);
         }
 
+        finalizeTopology(*mesh);
+
         mesh->setMaterial(std::make_shared<Material>());
         meshes[mesh_idx] = mesh;
     }
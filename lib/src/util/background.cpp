@@ -1,5 +1,6 @@
 #include "mh/util/background.h"
 
+#include "mh/gpu/profiler.h"
 #include "mh/gpu/shader.h"
 
 namespace
@@ -78,6 +79,8 @@ Background::Background(const std::string & filename)
 
 void Background::draw()
 {
+    ProfileScope profile("background");
+
     m_shader->use();
 
     glEnable(GL_TEXTURE_2D);
@@ -180,13 +180,13 @@ bool aabbIntersect(const BVH & a, const BVH & b, const Eigen::Matrix4f & a_trans
 
 bool intersect_face(const Face * a, const Face * b, const Eigen::Affine3f & a_transform, const Eigen::Affine3f & b_transform)
 {
-    Eigen::Vector3f a_0 = a_transform * a->getVertex(0)->getPosition();
-    Eigen::Vector3f a_1 = a_transform * a->getVertex(1)->getPosition();
-    Eigen::Vector3f a_2 = a_transform * a->getVertex(2)->getPosition();
+    Eigen::Vector3f a_0 = a_transform * a->getVertex<0>()->getPosition();
+    Eigen::Vector3f a_1 = a_transform * a->getVertex<1>()->getPosition();
+    Eigen::Vector3f a_2 = a_transform * a->getVertex<2>()->getPosition();
 
-    Eigen::Vector3f b_0 = b_transform * b->getVertex(0)->getPosition();
-    Eigen::Vector3f b_1 = b_transform * b->getVertex(1)->getPosition();
-    Eigen::Vector3f b_2 = b_transform * b->getVertex(2)->getPosition();
+    Eigen::Vector3f b_0 = b_transform * b->getVertex<0>()->getPosition();
+    Eigen::Vector3f b_1 = b_transform * b->getVertex<1>()->getPosition();
+    Eigen::Vector3f b_2 = b_transform * b->getVertex<2>()->getPosition();
 
     bool face_intersection = NoDivTriTriIsect(a_0.data(),
                                               a_1.data(),
@@ -200,13 +200,13 @@ bool intersect_face(const Face * a, const Face * b, const Eigen::Affine3f & a_tr
 
 bool intersect_face(const Face * a, const Face * b, const Eigen::Matrix4f & a_transform, const Eigen::Matrix4f & b_transform)
 {
-    Eigen::Vector3f a_0 = (a_transform * a->getVertex(0)->getPosition().homogeneous()).eval().hnormalized();
-    Eigen::Vector3f a_1 = (a_transform * a->getVertex(1)->getPosition().homogeneous()).eval().hnormalized();
-    Eigen::Vector3f a_2 = (a_transform * a->getVertex(2)->getPosition().homogeneous()).eval().hnormalized();
+    Eigen::Vector3f a_0 = (a_transform * a->getVertex<0>()->getPosition().homogeneous()).eval().hnormalized();
+    Eigen::Vector3f a_1 = (a_transform * a->getVertex<1>()->getPosition().homogeneous()).eval().hnormalized();
+    Eigen::Vector3f a_2 = (a_transform * a->getVertex<2>()->getPosition().homogeneous()).eval().hnormalized();
 
-    Eigen::Vector3f b_0 = (b_transform * b->getVertex(0)->getPosition().homogeneous()).eval().hnormalized();
-    Eigen::Vector3f b_1 = (b_transform * b->getVertex(1)->getPosition().homogeneous()).eval().hnormalized();
-    Eigen::Vector3f b_2 = (b_transform * b->getVertex(2)->getPosition().homogeneous()).eval().hnormalized();
+    Eigen::Vector3f b_0 = (b_transform * b->getVertex<0>()->getPosition().homogeneous()).eval().hnormalized();
+    Eigen::Vector3f b_1 = (b_transform * b->getVertex<1>()->getPosition().homogeneous()).eval().hnormalized();
+    Eigen::Vector3f b_2 = (b_transform * b->getVertex<2>()->getPosition().homogeneous()).eval().hnormalized();
 
     bool face_intersection = NoDivTriTriIsect(a_0.data(),
                                               a_1.data(),
@@ -0,0 +1,58 @@
+#include "mh/util/dirty_ranges.h"
+
+#include <algorithm>
+
+namespace mh
+{
+
+void DirtyRanges::add(size_t begin, size_t end)
+{
+    if (begin >= end) return;
+
+    // consecutive single-element updates are the common case, extend in place
+    if (!m_ranges.empty() && m_ranges.back().end == begin)
+    {
+        m_ranges.back().end = end;
+        return;
+    }
+
+    m_merged = m_merged && (m_ranges.empty() || m_ranges.back().end < begin);
+    m_ranges.push_back({begin, end});
+}
+
+const std::vector<IndexRange> & DirtyRanges::get() const
+{
+    if (m_merged) return m_ranges;
+
+    std::sort(m_ranges.begin(), m_ranges.end(),
+              [](const IndexRange & a, const IndexRange & b) { return a.begin < b.begin; });
+
+    size_t n = 0;
+    for (size_t i = 1; i < m_ranges.size(); ++i)
+    {
+        if (m_ranges[i].begin <= m_ranges[n].end)
+        {
+            m_ranges[n].end = std::max(m_ranges[n].end, m_ranges[i].end);
+        } else {
+            m_ranges[++n] = m_ranges[i];
+        }
+    }
+    m_ranges.resize(n + 1);
+
+    m_merged = true;
+
+    return m_ranges;
+}
+
+size_t DirtyRanges::count() const
+{
+    size_t n = 0;
+    for (const IndexRange & range : get())
+    {
+        n += range.end - range.begin;
+    }
+
+    return n;
+}
+
+} // namespace mh
@@ -0,0 +1,1445 @@
+#include "mh/util/flat_bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+
+#include "mh/3d/bounds.h"
+#include "mh/3d/face.h"
+#include "mh/3d/mesh.h"
+#include "mh/3d/transform.h"
+
+#include "mh/base/parallel.h"
+
+#include "mh/util/radix_sort.h"
+
+#include "mh/ext/tritri.h"
+
+namespace mh
+{
+
+namespace
+{
+    struct BuildPrimitive
+    {
+        Eigen::Vector3f min;
+        Eigen::Vector3f max;
+        Eigen::Vector3f center;
+        uint32_t        index;
+    }; // struct BuildPrimitive
+
+    void setNodeBounds(FlatBVHNode & node, const Eigen::Vector3f & min, const Eigen::Vector3f & max)
+    {
+        Eigen::Map<Eigen::Vector3f>(node.min) = min;
+        Eigen::Map<Eigen::Vector3f>(node.max) = max;
+    }
+
+    struct BuildContext
+    {
+        std::vector<BuildPrimitive> & primitives;
+        // as large as primitives when they partition in chunks
+        std::vector<BuildPrimitive> & scratch;
+        uint32_t                      leafSize;
+        BVHBuildMethod                method;
+        BVHCostModel                  cost;
+    }; // struct BuildContext
+
+    // Sweeps over more than PARALLEL_CHUNK primitives run in chunks, one
+    // OpenMP task each, and subtrees over at least PARALLEL_SUBTREE
+    // primitives build their second child in a task. Chunks depend on the
+    // range alone, so the tree is the same for any number of threads.
+    const uint32_t PARALLEL_CHUNK   = 16384;
+    const uint32_t PARALLEL_SUBTREE = 4096;
+    const uint32_t MAX_CHUNKS       = 64;
+
+    uint32_t chunkCount(uint32_t count)
+    {
+        return std::min(MAX_CHUNKS, std::max(1u, count / PARALLEL_CHUNK));
+    }
+
+    uint32_t chunkBegin(uint32_t first, uint32_t count, uint32_t nChunks, uint32_t chunk)
+    {
+        return first + static_cast<uint32_t>(static_cast<uint64_t>(count) * chunk / nChunks);
+    }
+
+    // func(chunk, begin, end) for every chunk of [first, first + count),
+    // returns once all of them are done
+    template <class TFunc>
+    void forChunks(uint32_t first, uint32_t count, const TFunc & func)
+    {
+        const uint32_t nChunks = chunkCount(count);
+        if (nChunks == 1)
+        {
+            func(0, first, first + count);
+            return;
+        }
+
+        for (uint32_t c = 0; c < nChunks; ++c)
+        {
+            const uint32_t begin = chunkBegin(first, count, nChunks, c);
+            const uint32_t end   = chunkBegin(first, count, nChunks, c + 1);
+
+            MH_OMP(task shared(func) firstprivate(c, begin, end))
+            func(c, begin, end);
+        }
+        MH_OMP(taskwait)
+    }
+
+    // func() on a team of threads that picks up the tasks it spawns: the
+    // enclosing team inside a parallel region, a new one otherwise
+    template <class TFunc>
+    void runTasks(const TFunc & func)
+    {
+        if (inParallel())
+        {
+            func();
+            return;
+        }
+
+        MH_OMP(parallel)
+        {
+            MH_OMP(single)
+            func();
+        }
+    }
+
+    struct RangeBounds
+    {
+        Eigen::Vector3f min;
+        Eigen::Vector3f max;
+        Eigen::Vector3f centerMin;
+        Eigen::Vector3f centerMax;
+
+        void clear(void)
+        {
+            setEmptyBounds(min, max);
+            setEmptyBounds(centerMin, centerMax);
+        }
+
+        void merge(const RangeBounds & other)
+        {
+            mergeBounds(other.min, other.max, min, max);
+            mergeBounds(other.centerMin, other.centerMax, centerMin, centerMax);
+        }
+    }; // struct RangeBounds
+
+    RangeBounds rangeBounds(const BuildContext & context, uint32_t first, uint32_t count)
+    {
+        auto sweep = [&context](uint32_t begin, uint32_t end, RangeBounds & bounds)
+        {
+            bounds.clear();
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const BuildPrimitive & primitive = context.primitives[i];
+
+                mergeBounds(primitive.min, primitive.max, bounds.min, bounds.max);
+                mergeBounds(primitive.center, primitive.center, bounds.centerMin, bounds.centerMax);
+            }
+        };
+
+        RangeBounds bounds;
+        if (chunkCount(count) == 1)
+        {
+            sweep(first, first + count, bounds);
+            return bounds;
+        }
+
+        std::vector<RangeBounds> chunks(chunkCount(count));
+        forChunks(first, count, [&](uint32_t c, uint32_t begin, uint32_t end)
+        {
+            sweep(begin, end, chunks[c]);
+        });
+
+        bounds.clear();
+        for (const RangeBounds & chunk : chunks) bounds.merge(chunk);
+
+        return bounds;
+    }
+
+    // Moves the primitives of [first, first + count) that go left to the
+    // front, returns how many there are. Chunked ranges go through the
+    // scratch array, which keeps the order on both sides.
+    template <class TPredicate>
+    uint32_t partitionRange(BuildContext & context, uint32_t first, uint32_t count, const TPredicate & goesLeft)
+    {
+        std::vector<BuildPrimitive> & primitives = context.primitives;
+        std::vector<BuildPrimitive> & scratch    = context.scratch;
+
+        const uint32_t nChunks = chunkCount(count);
+        if (nChunks == 1)
+        {
+            auto begin = primitives.begin() + first;
+            return static_cast<uint32_t>(std::partition(begin, begin + count, goesLeft) - begin);
+        }
+
+        std::vector<uint32_t> nLeft(nChunks);
+        forChunks(first, count, [&](uint32_t c, uint32_t begin, uint32_t end)
+        {
+            nLeft[c] = static_cast<uint32_t>(std::count_if(primitives.begin() + begin, primitives.begin() + end, goesLeft));
+        });
+
+        // where each chunk puts its left and right primitives
+        std::vector<uint32_t> leftStart(nChunks), rightStart(nChunks);
+        uint32_t totalLeft = 0;
+        for (uint32_t c = 0; c < nChunks; ++c)
+        {
+            leftStart[c] = first + totalLeft;
+            totalLeft += nLeft[c];
+        }
+
+        uint32_t right = first + totalLeft;
+        for (uint32_t c = 0; c < nChunks; ++c)
+        {
+            rightStart[c] = right;
+            right += chunkBegin(first, count, nChunks, c + 1) - chunkBegin(first, count, nChunks, c) - nLeft[c];
+        }
+
+        forChunks(first, count, [&](uint32_t c, uint32_t begin, uint32_t end)
+        {
+            uint32_t l = leftStart[c];
+            uint32_t r = rightStart[c];
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                if (goesLeft(primitives[i])) scratch[l++] = primitives[i];
+                else                         scratch[r++] = primitives[i];
+            }
+        });
+
+        forChunks(first, count, [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            std::copy(scratch.begin() + begin, scratch.begin() + end, primitives.begin() + begin);
+        });
+
+        return totalLeft;
+    }
+
+    float surfaceArea(const Eigen::Vector3f & min, const Eigen::Vector3f & max)
+    {
+        const Eigen::Vector3f d = (max - min).cwiseMax(0.0f);
+        return 2.0f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+
+    struct Bin
+    {
+        Eigen::Vector3f min;
+        Eigen::Vector3f max;
+        uint32_t        count;
+    }; // struct Bin
+
+    // the bins of all three axes, filled in one sweep
+    struct BinGrid
+    {
+        Bin bins[3][FlatBVH::SAH_BINS];
+
+        void clear(void)
+        {
+            for (auto & axis : bins)
+            {
+                for (Bin & bin : axis)
+                {
+                    setEmptyBounds(bin.min, bin.max);
+                    bin.count = 0;
+                }
+            }
+        }
+
+        void merge(const BinGrid & other)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                for (uint32_t b = 0; b < FlatBVH::SAH_BINS; ++b)
+                {
+                    mergeBounds(other.bins[axis][b].min, other.bins[axis][b].max, bins[axis][b].min, bins[axis][b].max);
+                    bins[axis][b].count += other.bins[axis][b].count;
+                }
+            }
+        }
+    }; // struct BinGrid
+
+    uint32_t binIndex(float center, float centerMin, float scale)
+    {
+        return std::min(FlatBVH::SAH_BINS - 1, static_cast<uint32_t>((center - centerMin) * scale));
+    }
+
+    // Binned SAH over primitives [first, first + count): the number of
+    // primitives going left at the cheapest bin boundary, reordered so they
+    // come first; 0 if keeping a leaf is cheaper or nothing separates them.
+    uint32_t splitSAH(BuildContext & context, uint32_t first, uint32_t count, float area,
+                      const Eigen::Vector3f & centerMin, const Eigen::Vector3f & centerMax)
+    {
+        const uint32_t NB = FlatBVH::SAH_BINS;
+
+        const Eigen::Vector3f extent = centerMax - centerMin;
+
+        // 0 on axes without spread, which then have no bins to split at
+        Eigen::Vector3f scale;
+        for (int axis = 0; axis < 3; ++axis) scale(axis) = extent(axis) > 0.0f ? NB / extent(axis) : 0.0f;
+
+        auto sweep = [&](uint32_t begin, uint32_t end, BinGrid & grid)
+        {
+            grid.clear();
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const BuildPrimitive & primitive = context.primitives[i];
+
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    if (scale(axis) == 0.0f) continue;
+
+                    Bin & bin = grid.bins[axis][binIndex(primitive.center(axis), centerMin(axis), scale(axis))];
+                    mergeBounds(primitive.min, primitive.max, bin.min, bin.max);
+                    ++bin.count;
+                }
+            }
+        };
+
+        BinGrid grid;
+        if (chunkCount(count) == 1)
+        {
+            sweep(first, first + count, grid);
+        } else {
+            std::vector<BinGrid> chunks(chunkCount(count));
+            forChunks(first, count, [&](uint32_t c, uint32_t begin, uint32_t end)
+            {
+                sweep(begin, end, chunks[c]);
+            });
+
+            grid.clear();
+            for (const BinGrid & chunk : chunks) grid.merge(chunk);
+        }
+
+        float bestCost  = std::numeric_limits<float>::max();
+        int   bestAxis  = -1;
+        int   bestSplit = 0;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (scale(axis) == 0.0f) continue;
+
+            const Bin * bins = grid.bins[axis];
+
+            // areas and counts right of every boundary, swept from the right
+            float    rightArea [NB];
+            uint32_t rightCount[NB];
+
+            Eigen::Vector3f min, max;
+            setEmptyBounds(min, max);
+            uint32_t n = 0;
+            for (int b = NB - 1; b > 0; --b)
+            {
+                mergeBounds(bins[b].min, bins[b].max, min, max);
+                n += bins[b].count;
+
+                rightArea [b] = n > 0 ? surfaceArea(min, max) : 0.0f;
+                rightCount[b] = n;
+            }
+
+            setEmptyBounds(min, max);
+            n = 0;
+            for (uint32_t b = 1; b < NB; ++b)
+            {
+                mergeBounds(bins[b - 1].min, bins[b - 1].max, min, max);
+                n += bins[b - 1].count;
+
+                if (n == 0 || rightCount[b] == 0) continue;
+
+                const float cost = context.cost.traversal +
+                    context.cost.intersection * (surfaceArea(min, max) * n + rightArea[b] * rightCount[b]) / area;
+
+                if (cost < bestCost)
+                {
+                    bestCost  = cost;
+                    bestAxis  = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        const float leafCost = context.cost.intersection * count;
+        if (bestAxis < 0 || (count <= context.leafSize && leafCost <= bestCost)) return 0;
+
+        const float axisMin   = centerMin(bestAxis);
+        const float axisScale = scale(bestAxis);
+        return partitionRange(context, first, count, [=](const BuildPrimitive & primitive)
+        {
+            return static_cast<int>(binIndex(primitive.center(bestAxis), axisMin, axisScale)) < bestSplit;
+        });
+    }
+
+    // appends the subtree over primitives [first, first + count) to nodes
+    // in depth first order
+    void buildNode(BuildContext & context, std::vector<FlatBVHNode> & nodes, uint32_t first, uint32_t count)
+    {
+        std::vector<BuildPrimitive> & primitives = context.primitives;
+
+        const uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(FlatBVHNode());
+
+        const RangeBounds bounds = rangeBounds(context, first, count);
+        setNodeBounds(nodes[index], bounds.min, bounds.max);
+
+        int   axis;
+        float extent = (bounds.centerMax - bounds.centerMin).maxCoeff(&axis);
+
+        // coincident centers cannot be told apart by splitting
+        uint32_t half = 0;
+        if (extent > 0.0f)
+        {
+            if (context.method == BVHBuildMethod::SAH)
+            {
+                half = splitSAH(context, first, count, surfaceArea(bounds.min, bounds.max), bounds.centerMin, bounds.centerMax);
+            }
+
+            // the median also takes over when SAH finds no useful boundary
+            // for too many primitives
+            if (half == 0 && count > context.leafSize)
+            {
+                half = count / 2;
+
+                // object median along the widest spread of centers
+                auto begin = primitives.begin() + first;
+                std::nth_element(begin, begin + half, begin + count, [axis](const BuildPrimitive & a, const BuildPrimitive & b)
+                {
+                    return a.center(axis) < b.center(axis);
+                });
+            }
+        }
+
+        if (half == 0)
+        {
+            nodes[index].offset = first;
+            nodes[index].count  = count;
+            return;
+        }
+
+        nodes[index].count = 0;
+
+        if (count < PARALLEL_SUBTREE)
+        {
+            buildNode(context, nodes, first, half);
+            nodes[index].offset = static_cast<uint32_t>(nodes.size());
+            buildNode(context, nodes, first + half, count - half);
+            return;
+        }
+
+        // the first child follows its parent while the second one grows in
+        // an array of its own, appended once both are done
+        std::vector<FlatBVHNode> second;
+
+        MH_OMP(task shared(context, second) firstprivate(first, half, count))
+        buildNode(context, second, first + half, count - half);
+
+        buildNode(context, nodes, first, half);
+
+        MH_OMP(taskwait)
+        const uint32_t offset = static_cast<uint32_t>(nodes.size());
+        nodes[index].offset = offset;
+        for (FlatBVHNode node : second)
+        {
+            if (!node.isLeaf()) node.offset += offset;
+            nodes.push_back(node);
+        }
+    }
+
+    struct MortonPrimitive
+    {
+        uint64_t code;
+        uint32_t index;
+    }; // struct MortonPrimitive
+
+    // spreads the lowest 21 bits of x so two zero bits follow each
+    uint64_t spreadBits(uint64_t x)
+    {
+        x &= 0x1fffff;
+        x = (x | x << 32) & 0x001f00000000ffffull;
+        x = (x | x << 16) & 0x001f0000ff0000ffull;
+        x = (x | x <<  8) & 0x100f00f00f00f00full;
+        x = (x | x <<  4) & 0x10c30c30c30c30c3ull;
+        x = (x | x <<  2) & 0x1249249249249249ull;
+        return x;
+    }
+
+    int leadingZeros(uint64_t x)
+    {
+        if (x == 0) return 64;
+
+#if defined(__GNUC__)
+        return __builtin_clzll(x);
+#else
+        int n = 0;
+        if (x <= 0x00000000ffffffffull) { n += 32; x <<= 32; }
+        if (x <= 0x0000ffffffffffffull) { n += 16; x <<= 16; }
+        if (x <= 0x00ffffffffffffffull) { n +=  8; x <<=  8; }
+        if (x <= 0x0fffffffffffffffull) { n +=  4; x <<=  4; }
+        if (x <= 0x3fffffffffffffffull) { n +=  2; x <<=  2; }
+        if (x <= 0x7fffffffffffffffull) { n +=  1; }
+        return n;
+#endif
+    }
+
+    // Node of the binary radix tree over the sorted primitives, before it
+    // is flattened: the n - 1 interior nodes come first, then one leaf per
+    // primitive in Morton order.
+    struct LinearNode
+    {
+        Eigen::Vector3f min;
+        Eigen::Vector3f max;
+        uint32_t        left;
+        uint32_t        right;
+        uint32_t        count;
+        // nodes of the flattened subtree
+        uint32_t        flatSize;
+        // surface area heuristic, not divided by the root area
+        float           cost;
+        // becomes one leaf of the flat tree
+        bool            leaf;
+    }; // struct LinearNode
+
+    struct LinearTree
+    {
+        const BuildContext &         context;
+        std::vector<MortonPrimitive> sorted;
+        std::vector<LinearNode>      nodes;
+        std::vector<uint32_t>        parents;
+        uint32_t                     nInterior;
+    }; // struct LinearTree
+
+    const uint32_t NO_PARENT       = std::numeric_limits<uint32_t>::max();
+    const int      TREELET_LEAVES  = 7;
+    // smaller subtrees keep their topology; restructuring them costs more
+    // build time than it saves in queries
+    const uint32_t TREELET_MIN     = 32;
+
+    // length of the common prefix of the codes at i and j, -1 outside
+    int commonPrefix(const std::vector<MortonPrimitive> & sorted, int64_t i, int64_t j)
+    {
+        if (j < 0 || j >= static_cast<int64_t>(sorted.size())) return -1;
+
+        // equal codes are told apart by their position
+        const uint64_t a = sorted[i].code;
+        const uint64_t b = sorted[j].code;
+        if (a == b) return 32 + leadingZeros(static_cast<uint64_t>(i ^ j));
+
+        return leadingZeros(a ^ b);
+    }
+
+    // children of interior node i, which splits the range of sorted codes
+    // starting or ending at i where they first differ (Karras 2012)
+    void linkInterior(LinearTree & tree, int64_t i)
+    {
+        const std::vector<MortonPrimitive> & sorted = tree.sorted;
+
+        // the direction the range extends in, and a bound on its length
+        const int64_t d      = commonPrefix(sorted, i, i + 1) > commonPrefix(sorted, i, i - 1) ? 1 : -1;
+        const int     minimum = commonPrefix(sorted, i, i - d);
+
+        int64_t maxLength = 2;
+        while (commonPrefix(sorted, i, i + maxLength * d) > minimum) maxLength *= 2;
+
+        int64_t length = 0;
+        for (int64_t t = maxLength / 2; t > 0; t /= 2)
+        {
+            if (commonPrefix(sorted, i, i + (length + t) * d) > minimum) length += t;
+        }
+
+        const int64_t j      = i + length * d;
+        const int     prefix = commonPrefix(sorted, i, j);
+
+        // the last position sharing more than the prefix with i
+        int64_t split = 0;
+        int64_t t     = length;
+        do
+        {
+            t = (t + 1) / 2;
+            if (commonPrefix(sorted, i, i + (split + t) * d) > prefix) split += t;
+        } while (t > 1);
+
+        const int64_t  gamma = i + split * d + std::min<int64_t>(d, 0);
+        const uint32_t left  = static_cast<uint32_t>(std::min(i, j) == gamma     ? tree.nInterior + gamma     : gamma);
+        const uint32_t right = static_cast<uint32_t>(std::max(i, j) == gamma + 1 ? tree.nInterior + gamma + 1 : gamma + 1);
+
+        tree.nodes[i].left  = left;
+        tree.nodes[i].right = right;
+        tree.parents[left]  = static_cast<uint32_t>(i);
+        tree.parents[right] = static_cast<uint32_t>(i);
+    }
+
+    void setLinearLeaf(LinearTree & tree, uint32_t i)
+    {
+        const BuildPrimitive & primitive = tree.context.primitives[tree.sorted[i].index];
+        LinearNode &           node      = tree.nodes[tree.nInterior + i];
+
+        node.min      = primitive.min;
+        node.max      = primitive.max;
+        node.count    = 1;
+        node.flatSize = 1;
+        node.cost     = tree.context.cost.intersection * surfaceArea(node.min, node.max);
+        node.leaf     = true;
+    }
+
+    // bounds, cost and flat size of an interior node from its children;
+    // it becomes a leaf where testing all its triangles is cheaper
+    void updateLinearNode(LinearTree & tree, uint32_t i)
+    {
+        LinearNode &       node  = tree.nodes[i];
+        const LinearNode & left  = tree.nodes[node.left];
+        const LinearNode & right = tree.nodes[node.right];
+
+        node.min   = left.min.cwiseMin(right.min);
+        node.max   = left.max.cwiseMax(right.max);
+        node.count = left.count + right.count;
+
+        const float area      = surfaceArea(node.min, node.max);
+        const float leafCost  = tree.context.cost.intersection * area * node.count;
+        const float splitCost = tree.context.cost.traversal * area + left.cost + right.cost;
+
+        node.leaf     = node.count <= tree.context.leafSize && leafCost <= splitCost;
+        node.cost     = node.leaf ? leafCost : splitCost;
+        node.flatSize = node.leaf ? 1 : 1 + left.flatSize + right.flatSize;
+    }
+
+    struct Treelet
+    {
+        uint32_t leaves   [TREELET_LEAVES];
+        uint32_t interiors[TREELET_LEAVES - 1];
+        // best first subset to split each subset of leaves into
+        uint32_t split    [1 << TREELET_LEAVES];
+        int      nLeaves;
+        int      nUsed;
+    }; // struct Treelet
+
+    int lowestBit(uint32_t x)
+    {
+        int bit = 0;
+        while (!(x & 1u << bit)) ++bit;
+        return bit;
+    }
+
+    // rebuilds node i over the leaves of subset s, taking interior nodes
+    // of the treelet as they are needed
+    void assignTreelet(LinearTree & tree, Treelet & treelet, uint32_t i, uint32_t s)
+    {
+        const uint32_t subsets[2] = { treelet.split[s], s ^ treelet.split[s] };
+        uint32_t       children[2];
+
+        for (int c = 0; c < 2; ++c)
+        {
+            if ((subsets[c] & (subsets[c] - 1)) == 0)
+            {
+                children[c] = treelet.leaves[lowestBit(subsets[c])];
+            } else {
+                children[c] = treelet.interiors[treelet.nUsed++];
+                assignTreelet(tree, treelet, children[c], subsets[c]);
+            }
+        }
+
+        tree.nodes[i].left  = children[0];
+        tree.nodes[i].right = children[1];
+        updateLinearNode(tree, i);
+    }
+
+    // Treelet restructuring (Karras and Aila 2013): opens the subtree under
+    // node i into its up to seven largest subtrees and rebuilds the nodes
+    // above them in the topology of least cost, found by dynamic
+    // programming over all subsets of them.
+    void restructureTreelet(LinearTree & tree, uint32_t i)
+    {
+        Treelet treelet;
+        treelet.leaves[0] = tree.nodes[i].left;
+        treelet.leaves[1] = tree.nodes[i].right;
+        treelet.nLeaves   = 2;
+        treelet.nUsed     = 0;
+
+        int nInteriors = 0;
+        while (treelet.nLeaves < TREELET_LEAVES)
+        {
+            int   largest = -1;
+            float area    = -1.0f;
+            for (int k = 0; k < treelet.nLeaves; ++k)
+            {
+                if (treelet.leaves[k] >= tree.nInterior) continue;
+
+                const LinearNode & node = tree.nodes[treelet.leaves[k]];
+                const float        a    = surfaceArea(node.min, node.max);
+                if (a > area)
+                {
+                    area    = a;
+                    largest = k;
+                }
+            }
+            if (largest < 0) break;
+
+            const LinearNode & opened = tree.nodes[treelet.leaves[largest]];
+            treelet.interiors[nInteriors++]   = treelet.leaves[largest];
+            treelet.leaves[largest]           = opened.left;
+            treelet.leaves[treelet.nLeaves++] = opened.right;
+        }
+        if (treelet.nLeaves < 3) return;
+
+        const uint32_t  nSubsets = 1u << treelet.nLeaves;
+        Eigen::Vector3f min  [1 << TREELET_LEAVES];
+        Eigen::Vector3f max  [1 << TREELET_LEAVES];
+        uint32_t        count[1 << TREELET_LEAVES];
+        float           cost [1 << TREELET_LEAVES];
+
+        for (uint32_t s = 1; s < nSubsets; ++s)
+        {
+            const uint32_t low = s & (~s + 1);
+
+            if (s == low)
+            {
+                const LinearNode & node = tree.nodes[treelet.leaves[lowestBit(s)]];
+                min  [s] = node.min;
+                max  [s] = node.max;
+                count[s] = node.count;
+                cost [s] = node.cost;
+                continue;
+            }
+
+            min  [s] = min[s ^ low].cwiseMin(min[low]);
+            max  [s] = max[s ^ low].cwiseMax(max[low]);
+            count[s] = count[s ^ low] + count[low];
+
+            // each split once, with the lowest leaf on the first side
+            float best = std::numeric_limits<float>::max();
+            for (uint32_t p = (s - 1) & s; p != 0; p = (p - 1) & s)
+            {
+                if (!(p & low)) continue;
+
+                const float c = cost[p] + cost[s ^ p];
+                if (c < best)
+                {
+                    best             = c;
+                    treelet.split[s] = p;
+                }
+            }
+
+            const float area = surfaceArea(min[s], max[s]);
+            cost[s] = tree.context.cost.traversal * area + best;
+            if (count[s] <= tree.context.leafSize)
+            {
+                cost[s] = std::min(cost[s], tree.context.cost.intersection * area * count[s]);
+            }
+        }
+
+        if (cost[nSubsets - 1] >= tree.nodes[i].cost) return;
+
+        assignTreelet(tree, treelet, i, nSubsets - 1);
+    }
+
+    // the primitives under node i in leaf order
+    void collectPrimitives(const LinearTree & tree, uint32_t i, BuildPrimitive *& out)
+    {
+        if (i >= tree.nInterior)
+        {
+            *out++ = tree.context.primitives[tree.sorted[i - tree.nInterior].index];
+            return;
+        }
+
+        collectPrimitives(tree, tree.nodes[i].left,  out);
+        collectPrimitives(tree, tree.nodes[i].right, out);
+    }
+
+    // writes the subtree under node i in depth first order from flat node
+    // index and primitive first on; sizes are known, so subtrees write in
+    // parallel
+    void flattenLinear(const LinearTree & tree, std::vector<FlatBVHNode> & nodes, std::vector<BuildPrimitive> & ordered,
+                       uint32_t i, uint32_t index, uint32_t first)
+    {
+        const LinearNode & node = tree.nodes[i];
+        setNodeBounds(nodes[index], node.min, node.max);
+
+        if (node.leaf)
+        {
+            nodes[index].offset = first;
+            nodes[index].count  = node.count;
+
+            BuildPrimitive * out = &ordered[first];
+            collectPrimitives(tree, i, out);
+            return;
+        }
+
+        const LinearNode & left   = tree.nodes[node.left];
+        const uint32_t     second = index + 1 + left.flatSize;
+
+        nodes[index].offset = second;
+        nodes[index].count  = 0;
+
+        if (node.count < PARALLEL_SUBTREE)
+        {
+            flattenLinear(tree, nodes, ordered, node.left,  index + 1, first);
+            flattenLinear(tree, nodes, ordered, node.right, second,    first + left.count);
+            return;
+        }
+
+        const uint32_t right       = node.right;
+        const uint32_t secondFirst = first + left.count;
+
+        MH_OMP(task shared(tree, nodes, ordered) firstprivate(right, second, secondFirst))
+        flattenLinear(tree, nodes, ordered, right, second, secondFirst);
+
+        flattenLinear(tree, nodes, ordered, node.left, index + 1, first);
+
+        MH_OMP(taskwait)
+    }
+
+    // Linear BVH: Morton codes of the triangle centers are radix sorted and
+    // every interior node of the radix tree over them is found on its own,
+    // then bounds and costs go up the tree with the last child to finish
+    // carrying on, as do treelet restructuring and the choice of leaves.
+    // Primitives come out in leaf order through the scratch array.
+    void buildLinear(BuildContext & context, std::vector<FlatBVHNode> & nodes, bool treelets)
+    {
+        const uint32_t n = static_cast<uint32_t>(context.primitives.size());
+
+        RangeBounds bounds;
+        runTasks([&]
+        {
+            bounds = rangeBounds(context, 0, n);
+        });
+
+        // 30 bits sort in four passes and are plenty for small meshes; 63
+        // keep the dense parts of large scans apart
+        const int             bitsPerAxis = n <= (1u << 16) ? 10 : 21;
+        const float           cells       = static_cast<float>((1u << bitsPerAxis) - 1);
+        const Eigen::Vector3f extent      = (bounds.centerMax - bounds.centerMin).cwiseMax(std::numeric_limits<float>::min());
+
+        LinearTree tree = { context, std::vector<MortonPrimitive>(n), std::vector<LinearNode>(2 * n - 1),
+                            std::vector<uint32_t>(2 * n - 1, NO_PARENT), n - 1 };
+
+        runTasks([&]
+        {
+            forChunks(0, n, [&](uint32_t, uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    const Eigen::Vector3f q = ((context.primitives[i].center - bounds.centerMin).cwiseQuotient(extent) * cells)
+                                                  .cwiseMax(0.0f).cwiseMin(cells);
+
+                    tree.sorted[i].code  = spreadBits(static_cast<uint64_t>(q.x())) << 2
+                                         | spreadBits(static_cast<uint64_t>(q.y())) << 1
+                                         | spreadBits(static_cast<uint64_t>(q.z()));
+                    tree.sorted[i].index = i;
+                }
+            });
+        });
+
+        // outside the task team, so the sort runs a parallel region of its own
+        radixSort(tree.sorted, [](const MortonPrimitive & primitive) { return primitive.code; }, 3 * bitsPerAxis);
+
+        std::unique_ptr<std::atomic<uint32_t>[]> visits(new std::atomic<uint32_t>[tree.nInterior]);
+
+        runTasks([&]
+        {
+            forChunks(0, tree.nInterior, [&](uint32_t, uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    linkInterior(tree, i);
+                    visits[i].store(0, std::memory_order_relaxed);
+                }
+            });
+
+            // the first child to arrive at a node stops, the second one
+            // finds the whole subtree done
+            forChunks(0, n, [&](uint32_t, uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    setLinearLeaf(tree, i);
+
+                    uint32_t parent = tree.parents[tree.nInterior + i];
+                    while (parent != NO_PARENT && visits[parent].fetch_add(1, std::memory_order_acq_rel) == 1)
+                    {
+                        updateLinearNode(tree, parent);
+                        if (treelets && tree.nodes[parent].count >= TREELET_MIN) restructureTreelet(tree, parent);
+
+                        parent = tree.parents[parent];
+                    }
+                }
+            });
+
+            nodes.resize(tree.nodes[0].flatSize);
+            flattenLinear(tree, nodes, context.scratch, 0, 0, 0);
+        });
+
+        context.primitives.swap(context.scratch);
+    }
+
+    // Ray with what the tests derive from its direction: for boxes the
+    // inverse direction and which face of each slab it enters through, for
+    // the watertight triangle test the axis it runs most along, which
+    // becomes z, and the shear that makes the ray run straight along z.
+    struct RayData
+    {
+        Eigen::Vector3f origin;
+        Eigen::Vector3f invDirection;
+        // offsets from FlatBVHNode::min to the near and far face of each slab
+        int             nearFace[3];
+        int             farFace[3];
+        int             kx;
+        int             ky;
+        int             kz;
+        float           sx;
+        float           sy;
+        float           sz;
+    }; // struct RayData
+
+    RayData prepareRay(const Ray & ray)
+    {
+        const Eigen::Vector3f direction = ray.getDirection();
+        // max follows min, past the offset
+        const int MAX = offsetof(FlatBVHNode, max) / sizeof(float);
+
+        RayData r;
+        r.origin       = ray.getPosition();
+        r.invDirection = direction.cwiseInverse();
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const bool negative = r.invDirection(axis) < 0.0f;
+            r.nearFace[axis] = negative ? MAX + axis : axis;
+            r.farFace [axis] = negative ? axis : MAX + axis;
+        }
+
+        direction.cwiseAbs().maxCoeff(&r.kz);
+        r.kx = (r.kz + 1) % 3;
+        r.ky = (r.kx + 1) % 3;
+        // keeps the winding, so triangles are hit from both sides alike
+        if (direction(r.kz) < 0.0f) std::swap(r.kx, r.ky);
+
+        r.sx = direction(r.kx) / direction(r.kz);
+        r.sy = direction(r.ky) / direction(r.kz);
+        r.sz = 1.0f / direction(r.kz);
+        return r;
+    }
+
+    // Slab test, setting the distance the ray enters the box at. The far
+    // distances grow by their worst rounding error (Ize 2013), so no ray
+    // misses a box around a triangle it hits.
+    bool rayBox(const RayData & r, const FlatBVHNode & node, float maxT, float & tNear)
+    {
+        const float ROUNDING = 1.0f + 2.0f * 3.0f * std::numeric_limits<float>::epsilon();
+
+        const float * faces = node.min;
+
+        float t0 = 0.0f;
+        float t1 = maxT;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float a = (faces[r.nearFace[axis]] - r.origin(axis)) * r.invDirection(axis);
+            const float b = (faces[r.farFace [axis]] - r.origin(axis)) * r.invDirection(axis) * ROUNDING;
+
+            // NaN, for rays in the plane of a slab face, fails both and
+            // leaves the interval alone
+            t0 = a > t0 ? a : t0;
+            t1 = b < t1 ? b : t1;
+        }
+
+        tNear = t0;
+        return t0 <= t1;
+    }
+
+    // Watertight ray triangle test (Woop, Benthin and Wald 2013), on the
+    // corners sheared into the space of the ray. Edge functions that come
+    // out exactly zero are redone in double, so a ray through an edge or
+    // corner hits the triangles sharing it and never slips between them.
+    bool rayTriangle(const RayData & r, const Eigen::Vector3f * corners, float maxT, float & t, Eigen::Vector3f & barycentrics)
+    {
+        const Eigen::Vector3f a = corners[0] - r.origin;
+        const Eigen::Vector3f b = corners[1] - r.origin;
+        const Eigen::Vector3f c = corners[2] - r.origin;
+
+        const float ax = a(r.kx) - r.sx * a(r.kz);
+        const float ay = a(r.ky) - r.sy * a(r.kz);
+        const float bx = b(r.kx) - r.sx * b(r.kz);
+        const float by = b(r.ky) - r.sy * b(r.kz);
+        const float cx = c(r.kx) - r.sx * c(r.kz);
+        const float cy = c(r.ky) - r.sy * c(r.kz);
+
+        float u = cx * by - cy * bx;
+        float v = ax * cy - ay * cx;
+        float w = bx * ay - by * ax;
+
+        if (u == 0.0f || v == 0.0f || w == 0.0f)
+        {
+            u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+            v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+            w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+        }
+
+        if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) return false;
+
+        const float det = u + v + w;
+        if (det == 0.0f) return false;
+
+        // the distance times det, checked against (0, maxT) before dividing
+        const float scaledT = r.sz * (u * a(r.kz) + v * b(r.kz) + w * c(r.kz));
+        if (det > 0.0f ? (scaledT <= 0.0f || scaledT >= maxT * det)
+                       : (scaledT >= 0.0f || scaledT <= maxT * det)) return false;
+
+        const float invDet = 1.0f / det;
+        t            = scaledT * invDet;
+        barycentrics = Eigen::Vector3f(u, v, w) * invDet;
+        return true;
+    }
+
+    // deeper hierarchies get a stack on the heap
+    const uint32_t RAY_STACK_SIZE = 64;
+
+    struct RayStackEntry
+    {
+        uint32_t node;
+        float    tNear;
+    }; // struct RayStackEntry
+
+    // Walks the nodes the ray enters, the nearer child first while the
+    // farther one waits on the stack, and drops waiting nodes the ray
+    // enters beyond the closest hit so far. anyHit returns at the first
+    // hit; otherwise the closest one ends up in t, triangle (in leaf
+    // order) and barycentrics.
+    bool traverseRay(const FlatBVH & bvh, const Ray & ray, float maxT, bool anyHit,
+                     float & t, uint32_t & triangle, Eigen::Vector3f & barycentrics)
+    {
+        const std::vector<FlatBVHNode> & nodes = bvh.getNodes();
+        if (nodes.empty()) return false;
+
+        const RayData r = prepareRay(ray);
+
+        float tNear;
+        if (!rayBox(r, nodes[0], maxT, tNear)) return false;
+
+        RayStackEntry              fixedStack[RAY_STACK_SIZE];
+        std::vector<RayStackEntry> deepStack;
+        RayStackEntry *            stack = fixedStack;
+        if (bvh.getDepth() > RAY_STACK_SIZE)
+        {
+            deepStack.resize(bvh.getDepth());
+            stack = deepStack.data();
+        }
+
+        bool     hit   = false;
+        uint32_t index = 0;
+        uint32_t size  = 0;
+
+        for (;;)
+        {
+            const FlatBVHNode & node = nodes[index];
+
+            if (!node.isLeaf())
+            {
+                float      tFirst, tSecond;
+                const bool first  = rayBox(r, nodes[index + 1],  maxT, tFirst);
+                const bool second = rayBox(r, nodes[node.offset], maxT, tSecond);
+
+                if (first && second)
+                {
+                    if (tSecond < tFirst)
+                    {
+                        stack[size++] = { index + 1, tFirst };
+                        index = node.offset;
+                    } else {
+                        stack[size++] = { node.offset, tSecond };
+                        index = index + 1;
+                    }
+                    continue;
+                }
+                if (first)  { index = index + 1;  continue; }
+                if (second) { index = node.offset; continue; }
+            } else {
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+                {
+                    float           tTriangle;
+                    Eigen::Vector3f weights;
+                    if (!rayTriangle(r, bvh.getTriangle(i), maxT, tTriangle, weights)) continue;
+
+                    hit          = true;
+                    maxT         = tTriangle;
+                    t            = tTriangle;
+                    triangle     = i;
+                    barycentrics = weights;
+                    if (anyHit) return true;
+                }
+            }
+
+            do
+            {
+                if (size == 0) return hit;
+                --size;
+            } while (stack[size].tNear > maxT);
+
+            index = stack[size].node;
+        }
+    }
+
+    bool boxesOverlap(const Eigen::Vector3f & aMin, const Eigen::Vector3f & aMax,
+                      const Eigen::Vector3f & bMin, const Eigen::Vector3f & bMax)
+    {
+        // touching boxes do not overlap, like aabbIntersect
+        return !((aMax.array() <= bMin.array()).any() || (bMax.array() <= aMin.array()).any());
+    }
+} // anonymous namespace
+
+void FlatBVH::build(const Mesh & mesh, const Eigen::Affine3f & transform)
+{
+    const Eigen::Affine3f modelTransform = transform * transform_to_mtw(mesh.getTransform());
+    const uint32_t        nFaces         = static_cast<uint32_t>(mesh.getFaces().size());
+
+    m_corners.resize(3 * nFaces);
+    m_faces.resize(nFaces);
+
+    runTasks([&]
+    {
+        forChunks(0, nFaces, [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            for (uint32_t f = begin; f < end; ++f)
+            {
+                const Face * face = mesh.getFaces()[f].get();
+
+                m_faces[f] = face;
+                for (int c = 0; c < 3; ++c)
+                {
+                    m_corners[3 * f + c] = modelTransform * face->getVertex(c)->getPosition();
+                }
+            }
+        });
+    });
+
+    build();
+}
+
+void FlatBVH::build(const std::vector<Eigen::Vector3f> & corners)
+{
+    m_corners = corners;
+    m_corners.resize(corners.size() / 3 * 3);
+    m_faces.clear();
+
+    build();
+}
+
+void FlatBVH::build(void)
+{
+    const uint32_t nTriangles = static_cast<uint32_t>(m_corners.size() / 3);
+
+    m_nodes.clear();
+    m_primitives.clear();
+    m_depth = 0;
+    if (nTriangles == 0) return;
+
+    std::vector<BuildPrimitive>  primitives(nTriangles);
+    std::vector<BuildPrimitive>  scratch(m_buildMethod == BVHBuildMethod::LBVH || chunkCount(nTriangles) > 1 ? nTriangles : 0);
+    std::vector<Eigen::Vector3f> corners(m_corners.size());
+    m_primitives.resize(nTriangles);
+
+    runTasks([&]
+    {
+        forChunks(0, nTriangles, [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const Eigen::Vector3f * t = &m_corners[3 * i];
+
+                primitives[i].min    = t[0].cwiseMin(t[1]).cwiseMin(t[2]);
+                primitives[i].max    = t[0].cwiseMax(t[1]).cwiseMax(t[2]);
+                primitives[i].center = (primitives[i].min + primitives[i].max) / 2.0f;
+                primitives[i].index  = i;
+            }
+        });
+    });
+
+    BuildContext context = { primitives, scratch, m_leafSize, m_buildMethod, m_costModel };
+    if (m_buildMethod == BVHBuildMethod::LBVH)
+    {
+        buildLinear(context, m_nodes, m_treelets);
+    } else {
+        runTasks([&]
+        {
+            // a binary tree with at least one primitive per leaf
+            m_nodes.reserve(2 * nTriangles);
+            buildNode(context, m_nodes, 0, nTriangles);
+        });
+    }
+
+    // corners follow the leaves
+    runTasks([&]
+    {
+        forChunks(0, nTriangles, [&](uint32_t, uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const uint32_t source = primitives[i].index;
+
+                m_primitives[i] = source;
+                for (int c = 0; c < 3; ++c) corners[3 * i + c] = m_corners[3 * source + c];
+            }
+        });
+    });
+
+    m_nodes.shrink_to_fit();
+    m_corners.swap(corners);
+
+    // parents come before their children
+    std::vector<uint32_t> depths(m_nodes.size());
+    depths[0] = m_depth = 1;
+    for (size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        if (m_nodes[i].isLeaf()) continue;
+
+        depths[i + 1] = depths[m_nodes[i].offset] = depths[i] + 1;
+        m_depth = std::max(m_depth, depths[i] + 1);
+    }
+}
+
+void FlatBVH::clear(void)
+{
+    m_nodes.clear();
+    m_corners.clear();
+    m_primitives.clear();
+    m_faces.clear();
+    m_depth = 0;
+}
+
+size_t FlatBVH::memoryUsage(void) const
+{
+    return m_nodes.capacity()      * sizeof(FlatBVHNode)
+         + m_corners.capacity()    * sizeof(Eigen::Vector3f)
+         + m_primitives.capacity() * sizeof(uint32_t)
+         + m_faces.capacity()      * sizeof(const Face *);
+}
+
+float FlatBVH::sahCost(void) const
+{
+    if (m_nodes.empty()) return 0.0f;
+
+    const float rootArea = surfaceArea(m_nodes[0].getMin(), m_nodes[0].getMax());
+    if (rootArea <= 0.0f) return m_costModel.intersection * m_primitives.size();
+
+    float cost = 0.0f;
+    for (const FlatBVHNode & node : m_nodes)
+    {
+        const float area = surfaceArea(node.getMin(), node.getMax()) / rootArea;
+        cost += node.isLeaf() ? area * m_costModel.intersection * node.count : area * m_costModel.traversal;
+    }
+
+    return cost;
+}
+
+std::vector<FlatBVH> buildFlatBVHs(const std::vector<std::shared_ptr<Mesh> > & meshes, const FlatBVH & settings)
+{
+    std::vector<FlatBVH> bvhs(meshes.size());
+    for (FlatBVH & bvh : bvhs)
+    {
+        bvh.setLeafSize(settings.getLeafSize());
+        bvh.setBuildMethod(settings.getBuildMethod());
+        bvh.setCostModel(settings.getCostModel());
+        bvh.setTreelets(settings.getTreelets());
+    }
+
+    // largest first, so no big mesh starts last and leaves threads idle
+    std::vector<size_t> order(meshes.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&meshes](size_t a, size_t b)
+    {
+        return meshes[a]->getFaces().size() > meshes[b]->getFaces().size();
+    });
+
+    // captured names default to firstprivate in tasks inside the lambda,
+    // which would copy whole vectors; pointers are cheap to copy
+    FlatBVH *                     targets = bvhs.data();
+    const std::shared_ptr<Mesh> * sources = meshes.data();
+
+    runTasks([&]
+    {
+        for (size_t i : order)
+        {
+            MH_OMP(task firstprivate(i, targets, sources))
+            targets[i].build(*sources[i]);
+        }
+        MH_OMP(taskwait)
+    });
+
+    return bvhs;
+}
+
+bool intersect_bvh(const FlatBVH & a, const FlatBVH & b, const Eigen::Affine3f & a_transform, const Eigen::Affine3f & b_transform)
+{
+    if (a.empty() || b.empty()) return false;
+
+    // everything happens in the space of a
+    const Eigen::Affine3f toA = a_transform.inverse() * b_transform;
+    // the common case, boxes then only move
+    const bool translationOnly = toA.linear() == Eigen::Matrix3f::Identity();
+
+    const std::vector<FlatBVHNode> & aNodes = a.getNodes();
+    const std::vector<FlatBVHNode> & bNodes = b.getNodes();
+
+    auto boundsOfB = [&](uint32_t ib, Eigen::Vector3f & min, Eigen::Vector3f & max)
+    {
+        if (translationOnly)
+        {
+            min = bNodes[ib].getMin() + toA.translation();
+            max = bNodes[ib].getMax() + toA.translation();
+        } else {
+            transformBounds(toA, bNodes[ib].getMin(), bNodes[ib].getMax(), min, max);
+        }
+    };
+
+    // pairs known to overlap, with the box of the node of b in the space
+    // of a so descending into a does not transform it again
+    struct Pair
+    {
+        uint32_t        a;
+        uint32_t        b;
+        Eigen::Vector3f bMin;
+        Eigen::Vector3f bMax;
+    }; // struct Pair
+
+    Pair root;
+    root.a = 0;
+    root.b = 0;
+    boundsOfB(0, root.bMin, root.bMax);
+    if (!boxesOverlap(aNodes[0].getMin(), aNodes[0].getMax(), root.bMin, root.bMax)) return false;
+
+    std::vector<Pair> stack;
+    stack.reserve(128);
+    stack.push_back(root);
+
+    while (!stack.empty())
+    {
+        const Pair pair = stack.back();
+        stack.pop_back();
+
+        const FlatBVHNode & na = aNodes[pair.a];
+        const FlatBVHNode & nb = bNodes[pair.b];
+
+        if (na.isLeaf() && nb.isLeaf())
+        {
+            // triangles of b in the space of a, with their boxes, in chunks
+            // of a few so the boxes of a are computed once per chunk
+            const uint32_t  CHUNK = 16;
+            Eigen::Vector3f bCorners[CHUNK][3];
+            Eigen::Vector3f bMins[CHUNK];
+            Eigen::Vector3f bMaxs[CHUNK];
+
+            for (uint32_t chunk = nb.offset; chunk < nb.offset + nb.count; chunk += CHUNK)
+            {
+                uint32_t nCandidates = 0;
+                for (uint32_t j = chunk; j < std::min(chunk + CHUNK, nb.offset + nb.count); ++j)
+                {
+                    const Eigen::Vector3f * tb = b.getTriangle(j);
+                    Eigen::Vector3f *       tc = bCorners[nCandidates];
+
+                    for (int c = 0; c < 3; ++c) tc[c] = toA * tb[c];
+
+                    bMins[nCandidates] = tc[0].cwiseMin(tc[1]).cwiseMin(tc[2]);
+                    bMaxs[nCandidates] = tc[0].cwiseMax(tc[1]).cwiseMax(tc[2]);
+
+                    if (boxesOverlap(na.getMin(), na.getMax(), bMins[nCandidates], bMaxs[nCandidates])) ++nCandidates;
+                }
+
+                if (nCandidates == 0) continue;
+
+                for (uint32_t i = na.offset; i < na.offset + na.count; ++i)
+                {
+                    const Eigen::Vector3f * ta   = a.getTriangle(i);
+                    const Eigen::Vector3f   aMin = ta[0].cwiseMin(ta[1]).cwiseMin(ta[2]);
+                    const Eigen::Vector3f   aMax = ta[0].cwiseMax(ta[1]).cwiseMax(ta[2]);
+
+                    if (!boxesOverlap(aMin, aMax, pair.bMin, pair.bMax)) continue;
+
+                    // most triangle pairs of overlapping leaves are apart
+                    for (uint32_t k = 0; k < nCandidates; ++k)
+                    {
+                        if (boxesOverlap(aMin, aMax, bMins[k], bMaxs[k]) &&
+                            NoDivTriTriIsect(ta[0].data(), ta[1].data(), ta[2].data(),
+                                             bCorners[k][0].data(), bCorners[k][1].data(), bCorners[k][2].data()))
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+            continue;
+        }
+
+        // descend into both interior nodes at once, keeping the child pairs
+        // that overlap; boxes of b are transformed once per node
+        uint32_t        aChildren[2] = { pair.a, pair.a };
+        uint32_t        bChildren[2] = { pair.b, pair.b };
+        Eigen::Vector3f bMins[2]     = { pair.bMin, pair.bMin };
+        Eigen::Vector3f bMaxs[2]     = { pair.bMax, pair.bMax };
+        const int       nA           = na.isLeaf() ? 1 : 2;
+        const int       nB           = nb.isLeaf() ? 1 : 2;
+
+        if (nA == 2)
+        {
+            aChildren[0] = pair.a + 1;
+            aChildren[1] = na.offset;
+        }
+        if (nB == 2)
+        {
+            bChildren[0] = pair.b + 1;
+            bChildren[1] = nb.offset;
+            boundsOfB(bChildren[0], bMins[0], bMaxs[0]);
+            boundsOfB(bChildren[1], bMins[1], bMaxs[1]);
+        }
+
+        for (int i = 0; i < nA; ++i)
+        {
+            const FlatBVHNode & child = aNodes[aChildren[i]];
+            for (int j = 0; j < nB; ++j)
+            {
+                if (boxesOverlap(child.getMin(), child.getMax(), bMins[j], bMaxs[j]))
+                {
+                    stack.push_back(Pair{aChildren[i], bChildren[j], bMins[j], bMaxs[j]});
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+Intersection<const Face> closestHit(const FlatBVH & bvh, const Ray & ray, float maxT)
+{
+    float           t;
+    uint32_t        triangle;
+    Eigen::Vector3f barycentrics;
+    if (!traverseRay(bvh, ray, maxT, false, t, triangle, barycentrics)) return Intersection<const Face>();
+
+    return Intersection<const Face>(true, t, bvh.getFace(triangle), barycentrics);
+}
+
+bool anyHit(const FlatBVH & bvh, const Ray & ray, float maxT)
+{
+    float           t;
+    uint32_t        triangle;
+    Eigen::Vector3f barycentrics;
+    return traverseRay(bvh, ray, maxT, true, t, triangle, barycentrics);
+}
+
+void closestHit(const FlatBVH & bvh, const std::vector<Ray> & rays, std::vector<Intersection<const Face> > & hits, float maxT)
+{
+    hits.resize(rays.size());
+
+    MH_OMP(parallel for schedule(dynamic, 256))
+    for (int64_t i = 0; i < static_cast<int64_t>(rays.size()); ++i)
+    {
+        hits[i] = closestHit(bvh, rays[i], maxT);
+    }
+}
+
+void anyHit(const FlatBVH & bvh, const std::vector<Ray> & rays, std::vector<uint8_t> & hits, float maxT)
+{
+    hits.resize(rays.size());
+
+    MH_OMP(parallel for schedule(dynamic, 256))
+    for (int64_t i = 0; i < static_cast<int64_t>(rays.size()); ++i)
+    {
+        hits[i] = anyHit(bvh, rays[i], maxT);
+    }
+}
+
+} // namespace mh
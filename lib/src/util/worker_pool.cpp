@@ -0,0 +1,114 @@
+#include "mh/util/worker_pool.h"
+
+namespace mh
+{
+
+WorkerPool & WorkerPool::get_instance()
+{
+    static const unsigned hardware = std::thread::hardware_concurrency();
+    static WorkerPool instance(hardware > 1 ? hardware - 1 : 1);
+    return instance;
+}
+
+WorkerPool::WorkerPool(size_t nThreads) : m_stop(false)
+{
+    MH_ASSERT(nThreads > 0);
+
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        m_threads.emplace_back([this]() { run(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+
+    for (std::thread & thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+std::future<void> WorkerPool::submit(std::function<void()> job)
+{
+    std::packaged_task<void()> task(std::move(job));
+    std::future<void> future = task.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(task));
+    }
+    m_wakeup.notify_one();
+
+    return future;
+}
+
+void WorkerPool::run()
+{
+    for (;;)
+    {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+
+            // queued jobs still run on shutdown, someone may wait for them
+            if (m_jobs.empty()) return;
+
+            task = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        task();
+    }
+}
+
+BackgroundJob::BackgroundJob(Job job)
+    : m_cancelled(std::make_shared<std::atomic<bool> >(false))
+{
+    std::shared_ptr<std::atomic<bool> > cancelled = m_cancelled;
+    m_future = WorkerPool::get_instance().submit([job, cancelled]() { job(*cancelled); });
+}
+
+BackgroundJob & BackgroundJob::operator=(BackgroundJob && rhs)
+{
+    if (this != &rhs)
+    {
+        cancel();
+        wait();
+
+        m_cancelled = std::move(rhs.m_cancelled);
+        m_future    = std::move(rhs.m_future);
+    }
+
+    return *this;
+}
+
+bool BackgroundJob::ready() const
+{
+    return m_future.valid() && m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void BackgroundJob::cancel()
+{
+    if (m_cancelled)
+    {
+        *m_cancelled = true;
+    }
+}
+
+void BackgroundJob::wait()
+{
+    if (m_future.valid())
+    {
+        m_future.get();
+    }
+}
+
+} // namespace mh